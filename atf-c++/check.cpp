@@ -25,7 +25,9 @@
 
 #include "atf-c++/check.hpp"
 
+#include <cerrno>
 #include <cstring>
+#include <new>
 
 extern "C" {
 #include "atf-c/build.h"
@@ -95,6 +97,138 @@ impl::check_result::stderr_path(void) const
     return atf_check_result_stderr(&m_result);
 }
 
+// ------------------------------------------------------------------------
+// The "batch" class.
+// ------------------------------------------------------------------------
+
+impl::batch_observer::~batch_observer(void)
+{
+}
+
+struct impl::batch_impl {
+    std::vector< atf::process::argv_array > m_commands;
+    std::vector< int > m_exitcodes;
+    std::vector< std::unique_ptr< check_result > > m_results;
+
+    // State only valid while run() is in progress.
+    std::size_t m_first;
+    batch_observer* m_observer;
+    std::string m_error;
+};
+
+impl::batch::batch(void) :
+    m_pimpl(new batch_impl)
+{
+}
+
+impl::batch::~batch(void)
+{
+}
+
+std::size_t
+impl::batch::add(atf::process::argv_array argv, const int exitcode)
+{
+    m_pimpl->m_commands.push_back(std::move(argv));
+    m_pimpl->m_exitcodes.push_back(exitcode);
+    m_pimpl->m_results.push_back(std::unique_ptr< check_result >());
+    return m_pimpl->m_commands.size() - 1;
+}
+
+std::size_t
+impl::batch::size(void)
+    const
+{
+    return m_pimpl->m_commands.size();
+}
+
+atf_error_t
+impl::batch::done(const std::size_t index, const atf_check_result_t* result,
+                  void* data)
+{
+    batch_impl* pimpl = static_cast< batch_impl* >(data);
+    const std::size_t pos = pimpl->m_first + index;
+    std::unique_ptr< check_result >& slot = pimpl->m_results[pos];
+
+    // Exceptions must not cross the C library, so convert them into
+    // errors here.
+    try {
+        // The C library hands over ownership of the result along with
+        // the notification; take it right away so that it is released
+        // even if the observer throws.
+        slot.reset(new check_result(result));
+
+        if (pimpl->m_observer != NULL) {
+            const check_result& r = *slot;
+            pimpl->m_observer->completed(
+                pos, r.exited() && r.exitcode() == pimpl->m_exitcodes[pos],
+                r);
+        }
+        return atf_no_error();
+    } catch (const std::bad_alloc&) {
+        if (slot.get() == NULL) {
+            atf_check_result_t orphan = *result;
+            atf_check_result_fini(&orphan);
+        }
+        return atf_no_memory_error();
+    } catch (const std::exception& e) {
+        pimpl->m_error = e.what();
+        return atf_libc_error(ECANCELED, "%s", pimpl->m_error.c_str());
+    }
+}
+
+void
+impl::batch::run(const std::size_t max_jobs, batch_observer* observer)
+{
+    std::size_t first = 0;
+    while (first < m_pimpl->m_results.size() &&
+           m_pimpl->m_results[first].get() != NULL)
+        first++;
+    const std::size_t count = m_pimpl->m_commands.size() - first;
+    if (count == 0)
+        return;
+
+    std::vector< const char* const* > argvs;
+    argvs.reserve(count);
+    for (std::size_t i = first; i < m_pimpl->m_commands.size(); i++)
+        argvs.push_back(m_pimpl->m_commands[i].exec_argv());
+    std::vector< atf_check_result_t > results(count);
+
+    m_pimpl->m_first = first;
+    m_pimpl->m_observer = observer;
+    atf_error_t err = atf_check_exec_arrays(&argvs[0], count, max_jobs,
+                                            &results[0], done,
+                                            m_pimpl.get());
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
+
+const impl::check_result&
+impl::batch::result(const std::size_t index)
+    const
+{
+    PRE(index < m_pimpl->m_results.size());
+    PRE(m_pimpl->m_results[index].get() != NULL);
+    return *m_pimpl->m_results[index];
+}
+
+bool
+impl::batch::succeeded(const std::size_t index)
+    const
+{
+    const check_result& r = result(index);
+    return r.exited() && r.exitcode() == m_pimpl->m_exitcodes[index];
+}
+
+bool
+impl::batch::all_succeeded(void)
+    const
+{
+    for (std::size_t i = 0; i < m_pimpl->m_results.size(); i++)
+        if (m_pimpl->m_results[i].get() == NULL || !succeeded(i))
+            return false;
+    return true;
+}
+
 // ------------------------------------------------------------------------
 // Free functions.
 // ------------------------------------------------------------------------
@@ -141,7 +275,7 @@ impl::build_cxx_o(const std::string& sfile, const std::string& ofile,
     return success;
 }
 
-std::auto_ptr< impl::check_result >
+std::unique_ptr< impl::check_result >
 impl::exec(const atf::process::argv_array& argva)
 {
     atf_check_result_t result;
@@ -150,5 +284,6 @@ impl::exec(const atf::process::argv_array& argva)
     if (atf_is_error(err))
         throw_atf_error(err);
 
-    return std::auto_ptr< impl::check_result >(new impl::check_result(&result));
+    return std::unique_ptr< impl::check_result >(
+        new impl::check_result(&result));
 }
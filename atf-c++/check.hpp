@@ -70,8 +70,10 @@ class check_result {
     //!
     check_result(const atf_check_result_t* result);
 
+    friend class batch;
     friend check_result test_constructor(const char* const*);
-    friend std::auto_ptr< check_result > exec(const atf::process::argv_array&);
+    friend std::unique_ptr< check_result > exec(
+        const atf::process::argv_array&);
 
 public:
     //!
@@ -110,6 +112,65 @@ public:
     const std::string stderr_path(void) const;
 };
 
+// ------------------------------------------------------------------------
+// The "batch" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief Interface to be notified of commands as they complete.
+//!
+class batch_observer {
+public:
+    virtual ~batch_observer(void);
+
+    //!
+    //! \brief Called once per command, in completion order.
+    //!
+    //! The second argument tells whether the command exited with the code
+    //! it was expected to.  Throwing aborts the batch.
+    //!
+    virtual void completed(const std::size_t, const bool,
+                           const check_result&) = 0;
+};
+
+struct batch_impl;
+
+//!
+//! \brief A set of commands to be run concurrently.
+//!
+//! Commands are added with the exit code they are expected to terminate
+//! with and run() executes them with at most a given number of them in
+//! flight at once.
+//!
+class batch {
+    // Non-copyable.
+    batch(const batch&);
+    batch& operator=(const batch&);
+
+    std::unique_ptr< batch_impl > m_pimpl;
+
+    static atf_error_t done(const std::size_t, const atf_check_result_t*,
+                            void*);
+
+public:
+    batch(void);
+    ~batch(void);
+
+    std::size_t add(atf::process::argv_array, const int = 0);
+    std::size_t size(void) const;
+
+    //!
+    //! \brief Runs all the commands that have not been run yet.
+    //!
+    //! A max_jobs of 0 means one job per online CPU.
+    //!
+    void run(const std::size_t = 0, batch_observer* = NULL);
+
+    const check_result& result(const std::size_t) const;
+    bool succeeded(const std::size_t) const;
+    bool all_succeeded(void) const;
+};
+
 // ------------------------------------------------------------------------
 // Free functions.
 // ------------------------------------------------------------------------
@@ -120,7 +181,7 @@ bool build_cpp(const std::string&, const std::string&,
                const atf::process::argv_array&);
 bool build_cxx_o(const std::string&, const std::string&,
                  const atf::process::argv_array&);
-std::auto_ptr< check_result > exec(const atf::process::argv_array&);
+std::unique_ptr< check_result > exec(const atf::process::argv_array&);
 
 // Useful for testing only.
 check_result test_constructor(void);
@@ -52,7 +52,7 @@ extern "C" {
 // ------------------------------------------------------------------------
 
 static
-std::auto_ptr< atf::check::check_result >
+std::unique_ptr< atf::check::check_result >
 do_exec(const atf::tests::tc* tc, const char* helper_name)
 {
     std::vector< std::string > argv;
@@ -65,7 +65,7 @@ do_exec(const atf::tests::tc* tc, const char* helper_name)
 }
 
 static
-std::auto_ptr< atf::check::check_result >
+std::unique_ptr< atf::check::check_result >
 do_exec(const atf::tests::tc* tc, const char* helper_name, const char *carg2)
 {
     std::vector< std::string > argv;
@@ -248,11 +248,11 @@ ATF_TEST_CASE_HEAD(exec_cleanup)
 }
 ATF_TEST_CASE_BODY(exec_cleanup)
 {
-    std::auto_ptr< atf::fs::path > out;
-    std::auto_ptr< atf::fs::path > err;
+    std::unique_ptr< atf::fs::path > out;
+    std::unique_ptr< atf::fs::path > err;
 
     {
-        std::auto_ptr< atf::check::check_result > r =
+        std::unique_ptr< atf::check::check_result > r =
             do_exec(this, "exit-success");
         out.reset(new atf::fs::path(r->stdout_path()));
         err.reset(new atf::fs::path(r->stderr_path()));
@@ -272,7 +272,7 @@ ATF_TEST_CASE_HEAD(exec_exitstatus)
 ATF_TEST_CASE_BODY(exec_exitstatus)
 {
     {
-        std::auto_ptr< atf::check::check_result > r =
+        std::unique_ptr< atf::check::check_result > r =
             do_exec(this, "exit-success");
         ATF_REQUIRE(r->exited());
         ATF_REQUIRE(!r->signaled());
@@ -280,7 +280,7 @@ ATF_TEST_CASE_BODY(exec_exitstatus)
     }
 
     {
-        std::auto_ptr< atf::check::check_result > r =
+        std::unique_ptr< atf::check::check_result > r =
             do_exec(this, "exit-failure");
         ATF_REQUIRE(r->exited());
         ATF_REQUIRE(!r->signaled());
@@ -288,7 +288,7 @@ ATF_TEST_CASE_BODY(exec_exitstatus)
     }
 
     {
-        std::auto_ptr< atf::check::check_result > r =
+        std::unique_ptr< atf::check::check_result > r =
             do_exec(this, "exit-signal");
         ATF_REQUIRE(!r->exited());
         ATF_REQUIRE(r->signaled());
@@ -321,12 +321,12 @@ ATF_TEST_CASE_HEAD(exec_stdout_stderr)
 }
 ATF_TEST_CASE_BODY(exec_stdout_stderr)
 {
-    std::auto_ptr< atf::check::check_result > r1 =
+    std::unique_ptr< atf::check::check_result > r1 =
         do_exec(this, "stdout-stderr", "result1");
     ATF_REQUIRE(r1->exited());
     ATF_REQUIRE_EQ(r1->exitcode(), EXIT_SUCCESS);
 
-    std::auto_ptr< atf::check::check_result > r2 =
+    std::unique_ptr< atf::check::check_result > r2 =
         do_exec(this, "stdout-stderr", "result2");
     ATF_REQUIRE(r2->exited());
     ATF_REQUIRE_EQ(r2->exitcode(), EXIT_SUCCESS);
@@ -372,11 +372,63 @@ ATF_TEST_CASE_BODY(exec_unknown)
     argv.push_back("/foo/bar/non-existent");
 
     atf::process::argv_array argva(argv);
-    std::auto_ptr< atf::check::check_result > r = atf::check::exec(argva);
+    std::unique_ptr< atf::check::check_result > r = atf::check::exec(argva);
     ATF_REQUIRE(r->exited());
     ATF_REQUIRE_EQ(r->exitcode(), 127);
 }
 
+class order_observer : public atf::check::batch_observer {
+public:
+    std::vector< std::size_t > m_order;
+    std::vector< bool > m_succeeded;
+
+    void
+    completed(const std::size_t index, const bool succeeded,
+              const atf::check::check_result&)
+    {
+        m_order.push_back(index);
+        m_succeeded.push_back(succeeded);
+    }
+};
+
+ATF_TEST_CASE(exec_batch);
+ATF_TEST_CASE_HEAD(exec_batch)
+{
+    set_md_var("descr", "Tests that a batch runs all of its commands and "
+               "validates their exit codes");
+}
+ATF_TEST_CASE_BODY(exec_batch)
+{
+    const std::string helpers = get_process_helpers_path(*this, false).str();
+
+    atf::check::batch b;
+    ATF_REQUIRE_EQ(b.add(atf::process::argv_array(helpers.c_str(),
+                                                  "exit-success", NULL)), 0);
+    ATF_REQUIRE_EQ(b.add(atf::process::argv_array(helpers.c_str(),
+                                                  "exit-failure", NULL),
+                         EXIT_FAILURE), 1);
+    ATF_REQUIRE_EQ(b.add(atf::process::argv_array(helpers.c_str(), "echo",
+                                                  "hello", NULL)), 2);
+    ATF_REQUIRE_EQ(b.size(), 3);
+
+    order_observer observer;
+    b.run(2, &observer);
+    ATF_REQUIRE_EQ(observer.m_order.size(), 3);
+    for (std::size_t i = 0; i < 3; i++)
+        ATF_REQUIRE(observer.m_succeeded[i]);
+    ATF_REQUIRE(b.all_succeeded());
+    ATF_REQUIRE_EQ(b.result(1).exitcode(), EXIT_FAILURE);
+    ATF_REQUIRE(atf::utils::grep_file("^hello$", b.result(2).stdout_path()));
+
+    // Only the newly-added commands run on a second call.
+    b.add(atf::process::argv_array(helpers.c_str(), "exit-failure", NULL));
+    b.run(0, &observer);
+    ATF_REQUIRE_EQ(observer.m_order.size(), 4);
+    ATF_REQUIRE_EQ(observer.m_order[3], 3);
+    ATF_REQUIRE(!b.succeeded(3));
+    ATF_REQUIRE(!b.all_succeeded());
+}
+
 // ------------------------------------------------------------------------
 // Main.
 // ------------------------------------------------------------------------
@@ -387,6 +439,7 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, build_c_o);
     ATF_ADD_TEST_CASE(tcs, build_cpp);
     ATF_ADD_TEST_CASE(tcs, build_cxx_o);
+    ATF_ADD_TEST_CASE(tcs, exec_batch);
     ATF_ADD_TEST_CASE(tcs, exec_cleanup);
     ATF_ADD_TEST_CASE(tcs, exec_exitstatus);
     ATF_ADD_TEST_CASE(tcs, exec_stdout_stderr);
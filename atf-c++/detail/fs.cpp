@@ -36,6 +36,7 @@ extern "C" {
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <unistd.h>
 }
@@ -301,6 +302,15 @@ impl::file_info::file_info(const path& p)
         throw_atf_error(err);
 }
 
+impl::file_info::file_info(const int dirfd, const char* name)
+{
+    atf_error_t err;
+
+    err = atf_fs_stat_init_at(&m_stat, dirfd, name);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
+
 impl::file_info::file_info(const file_info& fi)
 {
     atf_fs_stat_copy(&m_stat, &fi.m_stat);
@@ -410,25 +420,147 @@ impl::file_info::is_other_executable(void)
 }
 
 // ------------------------------------------------------------------------
-// The "directory" class.
+// The "directory_stream" class.
 // ------------------------------------------------------------------------
 
-impl::directory::directory(const path& p)
+//!
+//! \brief Converts a dirent type to one of the file_info types.
+//!
+//! \return The file_info type or -1 if the type is not known.
+//!
+static int
+dirent_type(const struct dirent* dep)
+{
+#if defined(HAVE_STRUCT_DIRENT_D_TYPE)
+    switch (dep->d_type) {
+    case DT_BLK: return impl::file_info::blk_type;
+    case DT_CHR: return impl::file_info::chr_type;
+    case DT_DIR: return impl::file_info::dir_type;
+    case DT_FIFO: return impl::file_info::fifo_type;
+    case DT_LNK: return impl::file_info::lnk_type;
+    case DT_REG: return impl::file_info::reg_type;
+    case DT_SOCK: return impl::file_info::sock_type;
+#if defined(DT_WHT)
+    case DT_WHT: return impl::file_info::wht_type;
+#endif
+    default: return -1;
+    }
+#else
+    (void)dep;
+    return -1;
+#endif
+}
+
+impl::directory_entry::directory_entry(void) :
+    m_dirfd(-1),
+    m_type(-1)
+{
+}
+
+impl::directory_entry::~directory_entry(void)
+{
+}
+
+void
+impl::directory_entry::reset(const int dirfd, const char* name,
+                             const int type)
+{
+    m_dirfd = dirfd;
+    m_name = name;
+    m_type = type;
+    m_info.reset();
+}
+
+const std::string&
+impl::directory_entry::name(void)
+    const
+{
+    return m_name;
+}
+
+int
+impl::directory_entry::type(void)
+    const
+{
+    if (m_type == -1)
+        return info().get_type();
+    else
+        return m_type;
+}
+
+const impl::file_info&
+impl::directory_entry::info(void)
+    const
+{
+    if (m_info.get() == NULL)
+        m_info.reset(new file_info(m_dirfd, m_name.c_str()));
+    return *m_info;
+}
+
+struct impl::directory_stream_impl {
+    path m_path;
+    DIR* m_dir;
+    directory_entry m_entry;
+
+    directory_stream_impl(const path& p) :
+        m_path(p),
+        m_dir(NULL)
+    {
+    }
+};
+
+impl::directory_stream::directory_stream(const path& p) :
+    m_pimpl(new directory_stream_impl(p))
+{
+    const int fd = ::open(p.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        throw system_error(IMPL_NAME "::directory_stream::directory_stream(" +
+                           p.str() + ")", "open(2) failed", errno);
+
+    m_pimpl->m_dir = ::fdopendir(fd);
+    if (m_pimpl->m_dir == NULL) {
+        const int original_errno = errno;
+        ::close(fd);
+        throw system_error(IMPL_NAME "::directory_stream::directory_stream(" +
+                           p.str() + ")", "fdopendir(3) failed",
+                           original_errno);
+    }
+}
+
+impl::directory_stream::~directory_stream(void)
 {
-    DIR* dp = ::opendir(p.c_str());
-    if (dp == NULL)
-        throw system_error(IMPL_NAME "::directory::directory(" +
-                           p.str() + ")", "opendir(3) failed", errno);
+    ::closedir(m_pimpl->m_dir);
+}
 
-    struct dirent* dep;
-    while ((dep = ::readdir(dp)) != NULL) {
-        path entryp = p / dep->d_name;
-        insert(value_type(dep->d_name, file_info(entryp)));
+const impl::directory_entry*
+impl::directory_stream::next(void)
+{
+    errno = 0;
+    const struct dirent* dep = ::readdir(m_pimpl->m_dir);
+    if (dep == NULL) {
+        if (errno != 0)
+            throw system_error(IMPL_NAME "::directory_stream::next(" +
+                               m_pimpl->m_path.str() + ")",
+                               "readdir(3) failed", errno);
+        return NULL;
     }
 
-    if (::closedir(dp) == -1)
-        throw system_error(IMPL_NAME "::directory::directory(" +
-                           p.str() + ")", "closedir(3) failed", errno);
+    m_pimpl->m_entry.reset(::dirfd(m_pimpl->m_dir), dep->d_name,
+                           dirent_type(dep));
+    return &m_pimpl->m_entry;
+}
+
+// ------------------------------------------------------------------------
+// The "directory" class.
+// ------------------------------------------------------------------------
+
+impl::directory::directory(const path& p)
+{
+    directory_stream ds(p);
+
+    const directory_entry* entry;
+    while ((entry = ds.next()) != NULL)
+        insert(value_type(entry->name(), entry->info()));
 }
 
 std::set< std::string >
@@ -511,3 +643,11 @@ impl::rmdir(const path& p)
     if (atf_is_error(err))
         throw_atf_error(err);
 }
+
+void
+impl::remove_tree(const path& p)
+{
+    atf_error_t err = atf_fs_rmtree(p.c_path());
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
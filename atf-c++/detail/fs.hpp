@@ -232,6 +232,14 @@ public:
     //!
     explicit file_info(const path&);
 
+    //!
+    //! \brief Constructs a new file_info for an entry of an open directory.
+    //!
+    //! This is equivalent to the constructor above but uses ::fstatat on
+    //! the given name relative to the given directory descriptor.
+    //!
+    file_info(const int, const char*);
+
     //!
     //! \brief The copy constructor.
     //!
@@ -319,6 +327,81 @@ public:
     bool is_other_executable(void) const;
 };
 
+// ------------------------------------------------------------------------
+// The "directory_stream" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief An entry returned by a directory_stream.
+//!
+//! The entry's type is taken from the directory itself when the file
+//! system provides it; the full file_info is only gathered, with a single
+//! ::fstatat call, the first time it is requested.
+//!
+class directory_entry {
+    int m_dirfd;
+    std::string m_name;
+    int m_type;
+    mutable std::unique_ptr< file_info > m_info;
+
+    friend class directory_stream;
+    friend struct directory_stream_impl;
+
+    directory_entry(void);
+    void reset(const int, const char*, const int);
+
+    // Non-copyable.
+    directory_entry(const directory_entry&);
+    directory_entry& operator=(const directory_entry&);
+
+public:
+    ~directory_entry(void);
+
+    //!
+    //! \brief Returns the leaf name of the entry.
+    //!
+    const std::string& name(void) const;
+
+    //!
+    //! \brief Returns the type of the entry as one of file_info's types.
+    //!
+    int type(void) const;
+
+    //!
+    //! \brief Returns the information of the entry, querying it if needed.
+    //!
+    const file_info& info(void) const;
+};
+
+struct directory_stream_impl;
+
+//!
+//! \brief Iterates over the entries of a directory as they are read.
+//!
+//! Unlike the directory class, this does not read the whole directory in
+//! advance nor sort it, and it only queries the information of the
+//! entries whose file_info is requested.  The "." and ".." entries are
+//! returned like any other.
+//!
+class directory_stream {
+    std::unique_ptr< directory_stream_impl > m_pimpl;
+
+    // Non-copyable.
+    directory_stream(const directory_stream&);
+    directory_stream& operator=(const directory_stream&);
+
+public:
+    explicit directory_stream(const path&);
+    ~directory_stream(void);
+
+    //!
+    //! \brief Returns the next entry or NULL if there are no more.
+    //!
+    //! The returned entry is only valid until the next call.
+    //!
+    const directory_entry* next(void);
+};
+
 // ------------------------------------------------------------------------
 // The "directory" class.
 // ------------------------------------------------------------------------
@@ -327,7 +410,8 @@ public:
 //! \brief A class representing a file system directory.
 //!
 //! The directory class represents a group of files in the file system and
-//! corresponds to exactly one directory.
+//! corresponds to exactly one directory.  It is a sorted snapshot of the
+//! directory's contents; use directory_stream to walk large directories.
 //!
 class directory : public std::map< std::string, file_info > {
 public:
@@ -381,6 +465,14 @@ void remove(const path&);
 //!
 void rmdir(const path&);
 
+//!
+//! \brief Removes a file or a directory and all of its contents.
+//!
+//! Symbolic links are not followed and mount points found within the
+//! tree are not traversed.
+//!
+void remove_tree(const path&);
+
 } // namespace fs
 } // namespace atf
 
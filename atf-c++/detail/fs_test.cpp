@@ -282,6 +282,45 @@ ATF_TEST_CASE_BODY(directory_read)
     ATF_REQUIRE(d.find("reg") != d.end());
 }
 
+ATF_TEST_CASE(directory_stream);
+ATF_TEST_CASE_HEAD(directory_stream)
+{
+    set_md_var("descr", "Tests the directory_stream class");
+}
+ATF_TEST_CASE_BODY(directory_stream)
+{
+    using atf::fs::directory_entry;
+    using atf::fs::directory_stream;
+    using atf::fs::file_info;
+    using atf::fs::path;
+
+    create_files();
+
+    std::set< std::string > names;
+    directory_stream ds(path("files"));
+    const directory_entry* entry;
+    while ((entry = ds.next()) != NULL) {
+        names.insert(entry->name());
+        if (entry->name() == "dir") {
+            ATF_REQUIRE_EQ(entry->type(), file_info::dir_type);
+            ATF_REQUIRE_EQ(entry->info().get_type(), file_info::dir_type);
+        } else if (entry->name() == "reg") {
+            ATF_REQUIRE_EQ(entry->type(), file_info::reg_type);
+            ATF_REQUIRE_EQ(entry->info().get_size(), 0);
+        }
+    }
+    ATF_REQUIRE(ds.next() == NULL);
+
+    std::set< std::string > exp;
+    exp.insert(".");
+    exp.insert("..");
+    exp.insert("dir");
+    exp.insert("reg");
+    ATF_REQUIRE(names == exp);
+
+    ATF_REQUIRE_THROW(atf::system_error, directory_stream(path("files/reg")));
+}
+
 ATF_TEST_CASE(directory_file_info);
 ATF_TEST_CASE_HEAD(directory_file_info)
 {
@@ -508,6 +547,31 @@ ATF_TEST_CASE_BODY(remove)
     ATF_REQUIRE( exists(path("files/dir")));
 }
 
+ATF_TEST_CASE(remove_tree);
+ATF_TEST_CASE_HEAD(remove_tree)
+{
+    set_md_var("descr", "Tests the remove_tree function");
+}
+ATF_TEST_CASE_BODY(remove_tree)
+{
+    using atf::fs::exists;
+    using atf::fs::path;
+    using atf::fs::remove_tree;
+
+    create_files();
+    ::mkdir("files/dir/subdir", 0755);
+    std::ofstream os("files/dir/subdir/reg");
+    os.close();
+
+    remove_tree(path("files/reg"));
+    ATF_REQUIRE(!exists(path("files/reg")));
+
+    remove_tree(path("files"));
+    ATF_REQUIRE(!exists(path("files")));
+
+    ATF_REQUIRE_THROW(atf::system_error, remove_tree(path("files")));
+}
+
 // ------------------------------------------------------------------------
 // Main.
 // ------------------------------------------------------------------------
@@ -534,9 +598,11 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, directory_read);
     ATF_ADD_TEST_CASE(tcs, directory_names);
     ATF_ADD_TEST_CASE(tcs, directory_file_info);
+    ATF_ADD_TEST_CASE(tcs, directory_stream);
 
     // Add the tests for the free functions.
     ATF_ADD_TEST_CASE(tcs, exists);
     ATF_ADD_TEST_CASE(tcs, is_executable);
     ATF_ADD_TEST_CASE(tcs, remove);
+    ATF_ADD_TEST_CASE(tcs, remove_tree);
 }
@@ -27,12 +27,17 @@
 
 extern "C" {
 #include <signal.h>
+#include <unistd.h>
 
 #include "atf-c/detail/process.h"
 #include "atf-c/error.h"
 }
 
+#include <cerrno>
+#include <cstdarg>
+#include <cstring>
 #include <iostream>
+#include <new>
 
 #include "atf-c++/detail/exceptions.hpp"
 #include "atf-c++/detail/sanity.hpp"
@@ -45,121 +50,163 @@ namespace impl = atf::process;
 // Auxiliary functions.
 // ------------------------------------------------------------------------
 
-template< class C >
-atf::auto_array< const char* >
-collection_to_argv(const C& c)
+static
+std::size_t
+arena_offset(const std::size_t nargs)
 {
-    atf::auto_array< const char* > argv(new const char*[c.size() + 1]);
-
-    std::size_t pos = 0;
-    for (typename C::const_iterator iter = c.begin(); iter != c.end();
-         iter++) {
-        argv[pos] = (*iter).c_str();
-        pos++;
-    }
-    INV(pos == c.size());
-    argv[pos] = NULL;
-
-    return argv;
-}
-
-template< class C >
-C
-argv_to_collection(const char* const* argv)
-{
-    C c;
-
-    for (const char* const* iter = argv; *iter != NULL; iter++)
-        c.push_back(std::string(*iter));
-
-    return c;
+    return (nargs + 1) * sizeof(const char*);
 }
 
 // ------------------------------------------------------------------------
 // The "argv_array" type.
 // ------------------------------------------------------------------------
 
-impl::argv_array::argv_array(void) :
-    m_exec_argv(collection_to_argv(m_args))
+impl::argv_array::argv_array(void)
 {
+    allocate(0, 0);
 }
 
 impl::argv_array::argv_array(const char* arg1, ...)
 {
-    m_args.push_back(arg1);
+    std::size_t nargs = 1, nbytes = std::strlen(arg1) + 1;
+    {
+        va_list ap;
+        const char* nextarg;
 
+        va_start(ap, arg1);
+        while ((nextarg = va_arg(ap, const char*)) != NULL) {
+            nargs++;
+            nbytes += std::strlen(nextarg) + 1;
+        }
+        va_end(ap);
+    }
+
+    char* next = append(allocate(nargs, nbytes), arg1);
     {
         va_list ap;
         const char* nextarg;
 
         va_start(ap, arg1);
         while ((nextarg = va_arg(ap, const char*)) != NULL)
-            m_args.push_back(nextarg);
+            next = append(next, nextarg);
         va_end(ap);
     }
-
-    ctor_init_exec_argv();
 }
 
-impl::argv_array::argv_array(const char* const* ca) :
-    m_args(argv_to_collection< args_vector >(ca)),
-    m_exec_argv(collection_to_argv(m_args))
+impl::argv_array::argv_array(const char* const* ca)
 {
+    std::size_t nargs = 0, nbytes = 0;
+    for (const char* const* iter = ca; *iter != NULL; iter++) {
+        nargs++;
+        nbytes += std::strlen(*iter) + 1;
+    }
+
+    char* next = allocate(nargs, nbytes);
+    for (const char* const* iter = ca; *iter != NULL; iter++)
+        next = append(next, *iter);
 }
 
 impl::argv_array::argv_array(const argv_array& a) :
-    m_args(a.m_args),
-    m_exec_argv(collection_to_argv(m_args))
+    argv_array(a.exec_argv())
 {
 }
 
-void
-impl::argv_array::ctor_init_exec_argv(void)
+impl::argv_array::argv_array(argv_array&& a) noexcept :
+    m_arena(std::move(a.m_arena)),
+    m_arena_size(a.m_arena_size),
+    m_size(a.m_size)
 {
-    m_exec_argv = collection_to_argv(m_args);
+    a.m_arena_size = 0;
+    a.m_size = 0;
+}
+
+//!
+//! \brief Allocates the arena for nargs arguments totalling nbytes.
+//!
+//! The returned pointer is where the contents of the first argument have
+//! to be stored by append().  The table is NULL-terminated upfront.
+//!
+char*
+impl::argv_array::allocate(const std::size_t nargs, const std::size_t nbytes)
+{
+    m_arena_size = arena_offset(nargs) + nbytes;
+    m_arena.reset(new char[m_arena_size]);
+    m_size = 0;
+
+    const char** table = reinterpret_cast< const char** >(m_arena.get());
+    table[nargs] = NULL;
+    return m_arena.get() + arena_offset(nargs);
+}
+
+char*
+impl::argv_array::append(char* next, const char* arg)
+{
+    const std::size_t length = std::strlen(arg) + 1;
+    std::memcpy(next, arg, length);
+
+    const char** table = reinterpret_cast< const char** >(m_arena.get());
+    table[m_size] = next;
+    m_size++;
+    return next + length;
 }
 
 const char* const*
 impl::argv_array::exec_argv(void)
     const
 {
-    return m_exec_argv.get();
+    static const char* const empty[] = { NULL };
+
+    if (m_arena.get() == NULL)
+        return empty;
+    return reinterpret_cast< const char* const* >(m_arena.get());
 }
 
 impl::argv_array::size_type
 impl::argv_array::size(void)
     const
 {
-    return m_args.size();
+    return m_size;
 }
 
 const char*
 impl::argv_array::operator[](int idx)
     const
 {
-    return m_args[idx].c_str();
+    PRE(static_cast< size_type >(idx) < m_size);
+    return exec_argv()[idx];
 }
 
 impl::argv_array::const_iterator
 impl::argv_array::begin(void)
     const
 {
-    return m_args.begin();
+    return exec_argv();
 }
 
 impl::argv_array::const_iterator
 impl::argv_array::end(void)
     const
 {
-    return m_args.end();
+    return exec_argv() + m_size;
 }
 
 impl::argv_array&
 impl::argv_array::operator=(const argv_array& a)
+{
+    if (this != &a)
+        *this = argv_array(a);
+    return *this;
+}
+
+impl::argv_array&
+impl::argv_array::operator=(argv_array&& a) noexcept
 {
     if (this != &a) {
-        m_args = a.m_args;
-        m_exec_argv = collection_to_argv(m_args);
+        m_arena = std::move(a.m_arena);
+        m_arena_size = a.m_arena_size;
+        m_size = a.m_size;
+        a.m_arena_size = 0;
+        a.m_size = 0;
     }
     return *this;
 }
@@ -227,6 +274,84 @@ impl::stream_redirect_path::stream_redirect_path(const fs::path& p)
     m_inited = true;
 }
 
+// ------------------------------------------------------------------------
+// The "output_capture" type.
+// ------------------------------------------------------------------------
+
+impl::output_capture::output_capture(void)
+{
+    atf_error_t err = atf_process_capture_init(&m_capture, receive, this);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
+
+impl::output_capture::~output_capture(void)
+{
+    atf_process_capture_fini(&m_capture);
+}
+
+atf_error_t
+impl::output_capture::receive(const int fd, const char* buf,
+                              const size_t length, void* data)
+{
+    output_capture* self = static_cast< output_capture* >(data);
+
+    // Exceptions must not cross the C library, so convert them into
+    // errors here.
+    try {
+        self->append(fd, buf, length);
+        return atf_no_error();
+    } catch (const std::bad_alloc&) {
+        return atf_no_memory_error();
+    } catch (const std::exception& e) {
+        self->m_error = e.what();
+        return atf_libc_error(ECANCELED, "%s", self->m_error.c_str());
+    }
+}
+
+void
+impl::output_capture::append(const int fd, const char* buf,
+                             const size_t length)
+{
+    if (fd == STDOUT_FILENO)
+        m_stdout.append(buf, length);
+    else
+        m_stderr.append(buf, length);
+}
+
+void
+impl::output_capture::set_limit(const size_t limit)
+{
+    atf_process_capture_set_limit(&m_capture, limit);
+}
+
+void
+impl::output_capture::set_timeout(const int timeout)
+{
+    atf_process_capture_set_timeout(&m_capture, timeout);
+}
+
+const std::string&
+impl::output_capture::stdout_data(void)
+    const
+{
+    return m_stdout;
+}
+
+const std::string&
+impl::output_capture::stderr_data(void)
+    const
+{
+    return m_stderr;
+}
+
+bool
+impl::output_capture::truncated(const int fd)
+    const
+{
+    return atf_process_capture_truncated(&m_capture, fd);
+}
+
 // ------------------------------------------------------------------------
 // The "status" type.
 // ------------------------------------------------------------------------
@@ -311,6 +436,14 @@ impl::child::wait(void)
     return status(s);
 }
 
+void
+impl::child::capture(output_capture& oc)
+{
+    atf_error_t err = atf_process_child_capture(&m_child, &oc.m_capture);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+}
+
 pid_t
 impl::child::pid(void)
     const
@@ -344,3 +477,19 @@ detail::flush_streams(void)
     std::cout.flush();
     std::cerr.flush();
 }
+
+impl::status
+impl::exec(const atf::fs::path& prog, const argv_array& argv,
+           output_capture& oc, void (*prehook)(void))
+{
+    atf_process_status_t s;
+
+    detail::flush_streams();
+    atf_error_t err = atf_process_exec_capture(&s, prog.c_path(),
+                                               argv.exec_argv(),
+                                               &oc.m_capture, prehook);
+    if (atf_is_error(err))
+        throw_atf_error(err);
+
+    return status(s);
+}
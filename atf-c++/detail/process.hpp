@@ -33,10 +33,12 @@ extern "C" {
 #include <atf-c/error.h>
 }
 
+#include <cstddef>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
-#include <atf-c++/detail/auto_array.hpp>
 #include <atf-c++/detail/exceptions.hpp>
 #include <atf-c++/detail/fs.hpp>
 
@@ -50,26 +52,37 @@ class status;
 // The "argv_array" type.
 // ------------------------------------------------------------------------
 
+//!
+//! \brief An immutable list of arguments suitable for exec(2).
+//!
+//! The pointer table and the strings it points to live in a single
+//! allocation: the table comes first and is followed by the contents of
+//! every argument, so constructing or copying an argv_array costs one
+//! allocation regardless of the number of arguments.
+//!
 class argv_array {
-    typedef std::vector< std::string > args_vector;
-    args_vector m_args;
+    std::unique_ptr< char[] > m_arena;
+    std::size_t m_arena_size;
+    std::size_t m_size;
 
-    // TODO: This is immutable, so we should be able to use
-    // std::tr1::shared_array instead when it becomes widely available.
-    // The reason would be to remove all copy constructors and assignment
-    // operators from this class.
-    auto_array< const char* > m_exec_argv;
-    void ctor_init_exec_argv(void);
+    char* allocate(const std::size_t, const std::size_t);
+    char* append(char*, const char*);
+
+    static const char* arg_cstr(const char* arg) { return arg; }
+    static const char* arg_cstr(const std::string& arg) { return arg.c_str(); }
 
 public:
-    typedef args_vector::const_iterator const_iterator;
-    typedef args_vector::size_type size_type;
+    //! Iterates over the arguments without copying them; the iterators
+    //! point into the NULL-terminated table returned by exec_argv.
+    typedef const char* const* const_iterator;
+    typedef std::size_t size_type;
 
     argv_array(void);
     argv_array(const char*, ...);
     explicit argv_array(const char* const*);
     template< class C > explicit argv_array(const C&);
     argv_array(const argv_array&);
+    argv_array(argv_array&&) noexcept;
 
     const char* const* exec_argv(void) const;
     size_type size(void) const;
@@ -79,15 +92,23 @@ public:
     const_iterator end(void) const;
 
     argv_array& operator=(const argv_array&);
+    argv_array& operator=(argv_array&&) noexcept;
 };
 
 template< class C >
 argv_array::argv_array(const C& c)
 {
+    std::size_t nargs = 0, nbytes = 0;
+    for (typename C::const_iterator iter = c.begin(); iter != c.end();
+         iter++) {
+        nargs++;
+        nbytes += std::strlen(arg_cstr(*iter)) + 1;
+    }
+
+    char* next = allocate(nargs, nbytes);
     for (typename C::const_iterator iter = c.begin(); iter != c.end();
          iter++)
-        m_args.push_back(*iter);
-    ctor_init_exec_argv();
+        next = append(next, arg_cstr(*iter));
 }
 
 // ------------------------------------------------------------------------
@@ -166,6 +187,49 @@ public:
     stream_redirect_path(const fs::path&);
 };
 
+// ------------------------------------------------------------------------
+// The "output_capture" type.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief Collects the stdout and stderr of a child process.
+//!
+//! Both streams are read concurrently as the child writes them, so the
+//! child never blocks on a full pipe.  By default the data is stored in
+//! two growable buffers; subclasses can override append() to process it
+//! on the fly instead.
+//!
+class output_capture {
+    atf_process_capture_t m_capture;
+    std::string m_stdout;
+    std::string m_stderr;
+    std::string m_error;
+
+    // Non-copyable.
+    output_capture(const output_capture&);
+    output_capture& operator=(const output_capture&);
+
+    static atf_error_t receive(const int, const char*, const size_t, void*);
+
+    friend class child;
+    friend status exec(const atf::fs::path&, const argv_array&,
+                       output_capture&, void (*)(void));
+
+protected:
+    virtual void append(const int, const char*, const size_t);
+
+public:
+    output_capture(void);
+    virtual ~output_capture(void);
+
+    void set_limit(const size_t);
+    void set_timeout(const int);
+
+    const std::string& stdout_data(void) const;
+    const std::string& stderr_data(void) const;
+    bool truncated(const int) const;
+};
+
 // ------------------------------------------------------------------------
 // The "status" type.
 // ------------------------------------------------------------------------
@@ -177,6 +241,8 @@ class status {
     template< class OutStream, class ErrStream > friend
     status exec(const atf::fs::path&, const argv_array&,
                 const OutStream&, const ErrStream&, void (*)(void));
+    friend status exec(const atf::fs::path&, const argv_array&,
+                       output_capture&, void (*)(void));
 
     status(atf_process_status_t&);
 
@@ -208,6 +274,7 @@ public:
     ~child(void);
 
     status wait(void);
+    void capture(output_capture&);
 
     pid_t pid(void) const;
     int stdout_fd(void);
@@ -268,6 +335,9 @@ exec(const atf::fs::path& prog, const argv_array& argv,
     return exec(prog, argv, outsb, errsb, NULL);
 }
 
+status exec(const atf::fs::path&, const argv_array&, output_capture&,
+            void (*)(void) = NULL);
+
 } // namespace process
 } // namespace atf
 
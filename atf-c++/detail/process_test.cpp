@@ -25,8 +25,13 @@
 
 #include "atf-c++/detail/process.hpp"
 
+extern "C" {
+#include <unistd.h>
+}
+
 #include <cstdlib>
 #include <cstring>
+#include <utility>
 
 #include <atf-c++.hpp>
 
@@ -243,6 +248,43 @@ ATF_TEST_CASE_BODY(argv_array_copy)
     argv2.release();
 }
 
+ATF_TEST_CASE(argv_array_move);
+ATF_TEST_CASE_HEAD(argv_array_move)
+{
+    set_md_var("descr", "Tests that moving an argv_array transfers its "
+               "storage instead of copying it");
+}
+ATF_TEST_CASE_BODY(argv_array_move)
+{
+    using atf::process::argv_array;
+
+    const char* const carray[] = { "arg0", "arg1", NULL };
+
+    argv_array argv1(carray);
+    const char* const* eargv1 = argv1.exec_argv();
+
+    argv_array argv2(std::move(argv1));
+    ATF_REQUIRE_EQ(argv2.exec_argv(), eargv1);
+    ATF_REQUIRE_EQ(argv2.size(), 2);
+    ATF_REQUIRE(std::strcmp(argv2[1], "arg1") == 0);
+
+    ATF_REQUIRE_EQ(argv1.size(), 0);
+    ATF_REQUIRE_EQ(argv1.exec_argv()[0], static_cast< const char* >(NULL));
+
+    argv_array argv3("other", NULL);
+    argv3 = std::move(argv2);
+    ATF_REQUIRE_EQ(argv3.exec_argv(), eargv1);
+    ATF_REQUIRE_EQ(argv3.size(), 2);
+
+    // A moved-from array can still be copied and assigned to.
+    argv_array argv4(argv2);
+    ATF_REQUIRE_EQ(argv4.size(), 0);
+    argv2 = argv3;
+    ATF_REQUIRE_EQ(argv2.size(), 2);
+    ATF_REQUIRE(argv2.exec_argv() != argv3.exec_argv());
+    ATF_REQUIRE(std::strcmp(argv2[0], "arg0") == 0);
+}
+
 ATF_TEST_CASE(argv_array_exec_argv);
 ATF_TEST_CASE_HEAD(argv_array_exec_argv)
 {
@@ -299,15 +341,62 @@ ATF_TEST_CASE_BODY(argv_array_iter)
     std::vector< std::string >::size_type pos = 0;
     for (argv_array::const_iterator iter = argv.begin(); iter != argv.end();
          iter++) {
-        ATF_REQUIRE_EQ(*iter, vector[pos]);
+        ATF_REQUIRE_EQ(vector[pos], *iter);
+        ATF_REQUIRE(iter == argv.exec_argv() + pos);
         pos++;
     }
+    ATF_REQUIRE_EQ(pos, 3);
 }
 
 // ------------------------------------------------------------------------
 // Tests cases for the free functions.
 // ------------------------------------------------------------------------
 
+ATF_TEST_CASE(exec_capture);
+ATF_TEST_CASE_HEAD(exec_capture)
+{
+    set_md_var("descr", "Tests execing a command and capturing its large "
+               "stdout and stderr concurrently");
+    set_md_var("timeout", "60");
+}
+ATF_TEST_CASE_BODY(exec_capture)
+{
+    std::vector< std::string > argv;
+    argv.push_back(get_process_helpers_path(*this, true).leaf_name());
+    argv.push_back("large-output");
+    argv.push_back("1000000");
+
+    atf::process::output_capture oc;
+    const atf::process::status s = atf::process::exec(
+        get_process_helpers_path(*this, true), atf::process::argv_array(argv),
+        oc);
+    ATF_REQUIRE(s.exited());
+    ATF_REQUIRE_EQ(s.exitstatus(), EXIT_SUCCESS);
+    ATF_REQUIRE_EQ(std::string(1000000, 'o'), oc.stdout_data());
+    ATF_REQUIRE_EQ(std::string(1000000, 'e'), oc.stderr_data());
+    ATF_REQUIRE(!oc.truncated(STDOUT_FILENO));
+}
+
+ATF_TEST_CASE(exec_capture_timeout);
+ATF_TEST_CASE_HEAD(exec_capture_timeout)
+{
+    set_md_var("descr", "Tests that capturing the output of a command "
+               "honors the timeout");
+    set_md_var("timeout", "30");
+}
+ATF_TEST_CASE_BODY(exec_capture_timeout)
+{
+    std::vector< std::string > argv;
+    argv.push_back(get_process_helpers_path(*this, true).leaf_name());
+    argv.push_back("hang");
+
+    atf::process::output_capture oc;
+    oc.set_timeout(100);
+    ATF_REQUIRE_THROW(atf::system_error, atf::process::exec(
+        get_process_helpers_path(*this, true), atf::process::argv_array(argv),
+        oc));
+}
+
 ATF_TEST_CASE(exec_failure);
 ATF_TEST_CASE_HEAD(exec_failure)
 {
@@ -347,8 +436,11 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, argv_array_init_empty);
     ATF_ADD_TEST_CASE(tcs, argv_array_init_varargs);
     ATF_ADD_TEST_CASE(tcs, argv_array_iter);
+    ATF_ADD_TEST_CASE(tcs, argv_array_move);
 
     // Add the test cases for the free functions.
+    ATF_ADD_TEST_CASE(tcs, exec_capture);
+    ATF_ADD_TEST_CASE(tcs, exec_capture_timeout);
     ATF_ADD_TEST_CASE(tcs, exec_failure);
     ATF_ADD_TEST_CASE(tcs, exec_success);
 }
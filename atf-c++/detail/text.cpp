@@ -29,8 +29,10 @@ extern "C" {
 #include <regex.h>
 }
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
+#include <limits>
 
 extern "C" {
 #include "atf-c/detail/text.h"
@@ -42,6 +44,81 @@ extern "C" {
 namespace impl = atf::text;
 #define IMPL_NAME "atf::text"
 
+// ------------------------------------------------------------------------
+// The "string_ref" class.
+// ------------------------------------------------------------------------
+
+impl::string_ref::string_ref(void) :
+    m_data(""),
+    m_length(0)
+{
+}
+
+impl::string_ref::string_ref(const char* data) :
+    m_data(data),
+    m_length(std::strlen(data))
+{
+}
+
+impl::string_ref::string_ref(const char* data, const std::size_t length) :
+    m_data(data),
+    m_length(length)
+{
+}
+
+impl::string_ref::string_ref(const std::string& str) :
+    m_data(str.data()),
+    m_length(str.length())
+{
+}
+
+const char*
+impl::string_ref::data(void)
+    const
+{
+    return m_data;
+}
+
+std::size_t
+impl::string_ref::length(void)
+    const
+{
+    return m_length;
+}
+
+bool
+impl::string_ref::empty(void)
+    const
+{
+    return m_length == 0;
+}
+
+std::string
+impl::string_ref::str(void)
+    const
+{
+    return std::string(m_data, m_length);
+}
+
+bool
+impl::string_ref::operator==(const string_ref& other)
+    const
+{
+    return m_length == other.m_length &&
+        std::memcmp(m_data, other.m_data, m_length) == 0;
+}
+
+bool
+impl::string_ref::operator!=(const string_ref& other)
+    const
+{
+    return !(*this == other);
+}
+
+// ------------------------------------------------------------------------
+// Free functions.
+// ------------------------------------------------------------------------
+
 char*
 impl::duplicate(const char* str)
 {
@@ -79,13 +156,54 @@ impl::match(const std::string& str, const std::string& regex)
 std::string
 impl::to_lower(const std::string& str)
 {
-    std::string lc;
-    for (std::string::const_iterator iter = str.begin(); iter != str.end();
-         iter++)
-        lc += std::tolower(*iter);
+    std::string lc(str);
+    lower_in_place(lc);
     return lc;
 }
 
+void
+impl::lower_in_place(std::string& str)
+{
+    for (std::string::iterator iter = str.begin(); iter != str.end(); iter++)
+        *iter = std::tolower(static_cast< unsigned char >(*iter));
+}
+
+bool
+impl::parse_integer(const string_ref& str, int64_t& value)
+{
+    const char* iter = str.data();
+    const char* const end = iter + str.length();
+
+    bool negative = false;
+    if (iter != end && (*iter == '-' || *iter == '+')) {
+        negative = *iter == '-';
+        iter++;
+    }
+    if (iter == end)
+        return false;
+
+    // Accumulate the value as a negative number, whose range is larger,
+    // so that the minimum integer can be parsed too.
+    const int64_t min = std::numeric_limits< int64_t >::min();
+    int64_t result = 0;
+    for (; iter != end; iter++) {
+        if (*iter < '0' || *iter > '9')
+            return false;
+        const int digit = *iter - '0';
+        if (result < (min + digit) / 10)
+            return false;
+        result = result * 10 - digit;
+    }
+
+    if (!negative) {
+        if (result == min)
+            return false;
+        result = -result;
+    }
+    value = result;
+    return true;
+}
+
 std::vector< std::string >
 impl::split(const std::string& str, const std::string& delim)
 {
@@ -102,6 +220,28 @@ impl::split(const std::string& str, const std::string& delim)
     return words;
 }
 
+std::size_t
+impl::split(const std::string& str, const std::string& delim,
+            string_ref* words, const std::size_t max)
+{
+    std::size_t count = 0;
+
+    std::string::size_type pos = 0, newpos = 0;
+    while (pos < str.length() && newpos != std::string::npos) {
+        newpos = str.find(delim, pos);
+        if (newpos != pos) {
+            const std::string::size_type end =
+                std::min(newpos, str.length());
+            if (count < max)
+                words[count] = string_ref(str.data() + pos, end - pos);
+            count++;
+        }
+        pos = newpos + delim.length();
+    }
+
+    return count;
+}
+
 std::string
 impl::trim(const std::string& str)
 {
@@ -154,3 +294,44 @@ impl::to_bytes(std::string str)
 
     return to_type< int64_t >(str) * multiplier;
 }
+
+namespace atf {
+namespace text {
+
+//!
+//! \brief Skips the leading whitespace that the stream extractors ignore.
+//!
+static string_ref
+skip_space(const std::string& str)
+{
+    std::string::size_type pos = 0;
+    while (pos < str.length() &&
+           std::isspace(static_cast< unsigned char >(str[pos])))
+        pos++;
+    return string_ref(str.data() + pos, str.length() - pos);
+}
+
+template<>
+int
+to_type< int >(const std::string& str)
+{
+    int64_t value;
+    if (!parse_integer(skip_space(str), value) ||
+        value < std::numeric_limits< int >::min() ||
+        value > std::numeric_limits< int >::max())
+        throw std::runtime_error("Cannot convert string to requested type");
+    return static_cast< int >(value);
+}
+
+template<>
+int64_t
+to_type< int64_t >(const std::string& str)
+{
+    int64_t value;
+    if (!parse_integer(skip_space(str), value))
+        throw std::runtime_error("Cannot convert string to requested type");
+    return value;
+}
+
+} // namespace text
+} // namespace atf
@@ -30,6 +30,7 @@ extern "C" {
 #include <stdint.h>
 }
 
+#include <cstddef>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -38,6 +39,32 @@ extern "C" {
 namespace atf {
 namespace text {
 
+//!
+//! \brief A reference to a range of characters owned by another string.
+//!
+//! The referenced characters are not copied, so the original string must
+//! outlive the reference and must not be modified while it is in use.
+//!
+class string_ref {
+    const char* m_data;
+    std::size_t m_length;
+
+public:
+    string_ref(void);
+    string_ref(const char*);
+    string_ref(const char*, const std::size_t);
+    string_ref(const std::string&);
+
+    const char* data(void) const;
+    std::size_t length(void) const;
+    bool empty(void) const;
+
+    std::string str(void) const;
+
+    bool operator==(const string_ref&) const;
+    bool operator!=(const string_ref&) const;
+};
+
 //!
 //! \brief Duplicates a C string using the new[] allocator.
 //!
@@ -87,6 +114,17 @@ bool match(const std::string&, const std::string&);
 //!
 std::vector< std::string > split(const std::string&, const std::string&);
 
+//!
+//! \brief Splits a string into words without copying them.
+//!
+//! Behaves like split but stores references to the words into the
+//! caller-provided array, which can hold up to the given number of
+//! entries.  Returns the total number of words in the string, which may
+//! be larger than the number of entries stored.
+//!
+std::size_t split(const std::string&, const std::string&, string_ref*,
+                  const std::size_t);
+
 //!
 //! \brief Removes whitespace from the beginning and end of a string.
 //!
@@ -110,6 +148,20 @@ int64_t to_bytes(std::string);
 //!
 std::string to_lower(const std::string&);
 
+//!
+//! \brief Changes the case of a string to lowercase in place.
+//!
+void lower_in_place(std::string&);
+
+//!
+//! \brief Parses a decimal integer without allocating memory.
+//!
+//! The whole range must be made of an optional sign followed by digits.
+//! Returns false if that is not the case or if the value does not fit in
+//! the result, in which case the output value is left untouched.
+//!
+bool parse_integer(const string_ref&, int64_t&);
+
 //!
 //! \brief Converts the given object to a string.
 //!
@@ -143,6 +195,12 @@ to_type(const std::string& str)
     return value;
 }
 
+// Integer conversions are common (e.g. when parsing configuration values
+// and command-line flags) and are done with parse_integer instead of a
+// stream to avoid allocating memory.
+template<> int to_type< int >(const std::string&);
+template<> int64_t to_type< int64_t >(const std::string&);
+
 } // namespace text
 } // namespace atf
 
@@ -254,6 +254,90 @@ ATF_TEST_CASE_BODY(split_delims)
     ATF_REQUIRE_EQ(words[2], "ef");
 }
 
+ATF_TEST_CASE(split_refs);
+ATF_TEST_CASE_HEAD(split_refs)
+{
+    set_md_var("descr", "Tests the split function that returns references "
+               "to the original string");
+}
+ATF_TEST_CASE_BODY(split_refs)
+{
+    using atf::text::split;
+    using atf::text::string_ref;
+
+    string_ref words[3];
+
+    ATF_REQUIRE_EQ(split("", " ", words, 3), 0);
+    ATF_REQUIRE_EQ(split("    ", " ", words, 3), 0);
+
+    const std::string str1 = "  foo  bar  ";
+    ATF_REQUIRE_EQ(split(str1, " ", words, 3), 2);
+    ATF_REQUIRE(words[0] == string_ref("foo"));
+    ATF_REQUIRE(words[1] == string_ref("bar"));
+    ATF_REQUIRE(words[0].data() == str1.data() + 2);
+
+    const std::string str2 = "aLONGDELIMbcdLONGDELIMefLONGDELIMg";
+    ATF_REQUIRE_EQ(split(str2, "LONGDELIM", words, 3), 4);
+    ATF_REQUIRE_EQ(words[0].str(), "a");
+    ATF_REQUIRE_EQ(words[1].str(), "bcd");
+    ATF_REQUIRE_EQ(words[2].str(), "ef");
+
+    ATF_REQUIRE_EQ(split("a=b", "=", NULL, 0), 2);
+}
+
+ATF_TEST_CASE(lower_in_place);
+ATF_TEST_CASE_HEAD(lower_in_place)
+{
+    set_md_var("descr", "Tests the lower_in_place and to_lower functions");
+}
+ATF_TEST_CASE_BODY(lower_in_place)
+{
+    using atf::text::lower_in_place;
+    using atf::text::to_lower;
+
+    std::string str = "Foo BAR 123 baz";
+    lower_in_place(str);
+    ATF_REQUIRE_EQ(str, "foo bar 123 baz");
+
+    ATF_REQUIRE_EQ(to_lower(""), "");
+    ATF_REQUIRE_EQ(to_lower("TrUe"), "true");
+}
+
+ATF_TEST_CASE(parse_integer);
+ATF_TEST_CASE_HEAD(parse_integer)
+{
+    set_md_var("descr", "Tests the parse_integer function");
+}
+ATF_TEST_CASE_BODY(parse_integer)
+{
+    using atf::text::parse_integer;
+    using atf::text::string_ref;
+
+    int64_t value = 5;
+    ATF_REQUIRE(parse_integer(string_ref("0"), value));
+    ATF_REQUIRE_EQ(value, 0);
+    ATF_REQUIRE(parse_integer(string_ref("+1234"), value));
+    ATF_REQUIRE_EQ(value, 1234);
+    ATF_REQUIRE(parse_integer(string_ref("-1234"), value));
+    ATF_REQUIRE_EQ(value, -1234);
+    ATF_REQUIRE(parse_integer(string_ref("123456", 3), value));
+    ATF_REQUIRE_EQ(value, 123);
+    ATF_REQUIRE(parse_integer(string_ref("9223372036854775807"), value));
+    ATF_REQUIRE_EQ(value, INT64_MAX);
+    ATF_REQUIRE(parse_integer(string_ref("-9223372036854775808"), value));
+    ATF_REQUIRE_EQ(value, INT64_MIN);
+
+    value = 5;
+    ATF_REQUIRE(!parse_integer(string_ref(""), value));
+    ATF_REQUIRE(!parse_integer(string_ref("-"), value));
+    ATF_REQUIRE(!parse_integer(string_ref(" 1"), value));
+    ATF_REQUIRE(!parse_integer(string_ref("1 "), value));
+    ATF_REQUIRE(!parse_integer(string_ref("12a"), value));
+    ATF_REQUIRE(!parse_integer(string_ref("9223372036854775808"), value));
+    ATF_REQUIRE(!parse_integer(string_ref("-9223372036854775809"), value));
+    ATF_REQUIRE_EQ(value, 5);
+}
+
 ATF_TEST_CASE(trim);
 ATF_TEST_CASE_HEAD(trim)
 {
@@ -357,6 +441,14 @@ ATF_TEST_CASE_BODY(to_type)
     ATF_REQUIRE_THROW(std::runtime_error, to_type< int >("   "));
     ATF_REQUIRE_THROW(std::runtime_error, to_type< int >("0 a"));
     ATF_REQUIRE_THROW(std::runtime_error, to_type< int >("a"));
+    ATF_REQUIRE_EQ(to_type< int >(" -12"), -12);
+    ATF_REQUIRE_THROW(std::runtime_error, to_type< int >(""));
+    ATF_REQUIRE_THROW(std::runtime_error, to_type< int >("12 "));
+    ATF_REQUIRE_THROW(std::runtime_error, to_type< int >("4294967296"));
+
+    ATF_REQUIRE_EQ(to_type< int64_t >("4294967296"), INT64_C(4294967296));
+    ATF_REQUIRE_THROW(std::runtime_error,
+                      to_type< int64_t >("99999999999999999999"));
 
     ATF_REQUIRE_EQ(to_type< float >("0.5"), 0.5);
     ATF_REQUIRE_EQ(to_type< float >("1234.5"), 1234.5);
@@ -378,6 +470,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, match);
     ATF_ADD_TEST_CASE(tcs, split);
     ATF_ADD_TEST_CASE(tcs, split_delims);
+    ATF_ADD_TEST_CASE(tcs, split_refs);
+    ATF_ADD_TEST_CASE(tcs, lower_in_place);
+    ATF_ADD_TEST_CASE(tcs, parse_integer);
     ATF_ADD_TEST_CASE(tcs, trim);
     ATF_ADD_TEST_CASE(tcs, to_bool);
     ATF_ADD_TEST_CASE(tcs, to_bytes);
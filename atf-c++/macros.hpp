@@ -42,9 +42,11 @@
         void body(void) const; \
     public: \
         atfu_tc_ ## name(void); \
+        static atf::tests::tc* atfu_create(const char*); \
     }; \
-    static atfu_tc_ ## name* atfu_tcptr_ ## name; \
     atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, false) {} \
+    atf::tests::tc* atfu_tc_ ## name::atfu_create(const char*) \
+        { return new atfu_tc_ ## name(); } \
     }
 
 #define ATF_TEST_CASE(name) \
@@ -54,9 +56,11 @@
         void body(void) const; \
     public: \
         atfu_tc_ ## name(void); \
+        static atf::tests::tc* atfu_create(const char*); \
     }; \
-    static atfu_tc_ ## name* atfu_tcptr_ ## name; \
     atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, false) {} \
+    atf::tests::tc* atfu_tc_ ## name::atfu_create(const char*) \
+        { return new atfu_tc_ ## name(); } \
     }
 
 #define ATF_TEST_CASE_WITH_CLEANUP(name) \
@@ -67,13 +71,83 @@
         void cleanup(void) const; \
     public: \
         atfu_tc_ ## name(void); \
+        static atf::tests::tc* atfu_create(const char*); \
     }; \
-    static atfu_tc_ ## name* atfu_tcptr_ ## name; \
     atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::tc(#name, true) {} \
+    atf::tests::tc* atfu_tc_ ## name::atfu_create(const char*) \
+        { return new atfu_tc_ ## name(); } \
     }
 
+// Benchmarks are test cases whose body runs the measured code as many
+// times as requested by the library, which calibrates the count and
+// times the runs; see atf::tests::bench.
+#define ATF_BENCHMARK_WITHOUT_HEAD(name) \
+    namespace { \
+    class atfu_tc_ ## name : public atf::tests::bench { \
+        void measure(const std::size_t) const; \
+    public: \
+        atfu_tc_ ## name(void); \
+        static atf::tests::tc* atfu_create(const char*); \
+    }; \
+    atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::bench(#name) {} \
+    atf::tests::tc* atfu_tc_ ## name::atfu_create(const char*) \
+        { return new atfu_tc_ ## name(); } \
+    }
+
+#define ATF_BENCHMARK(name) \
+    namespace { \
+    class atfu_tc_ ## name : public atf::tests::bench { \
+        void head(void); \
+        void measure(const std::size_t) const; \
+    public: \
+        atfu_tc_ ## name(void); \
+        static atf::tests::tc* atfu_create(const char*); \
+    }; \
+    atfu_tc_ ## name::atfu_tc_ ## name(void) : atf::tests::bench(#name) {} \
+    atf::tests::tc* atfu_tc_ ## name::atfu_create(const char*) \
+        { return new atfu_tc_ ## name(); } \
+    }
+
+#define ATF_BENCHMARK_HEAD(name) \
+    void \
+    atfu_tc_ ## name::head(void)
+
+#define ATF_BENCHMARK_BODY(name, iters) \
+    void \
+    atfu_tc_ ## name::measure(const std::size_t iters) \
+        const
+
+// A benchmark fixture parameterized by a type.  Each instantiation
+// registered with ATF_ADD_BENCHMARK_TEMPLATE becomes a separate test case,
+// so variants of a data structure can be compared without duplicating the
+// benchmark.  Compile-time constants can be passed wrapped in a type such
+// as std::integral_constant.
+#define ATF_BENCHMARK_TEMPLATE(name, param) \
+    namespace { \
+    template< typename param > \
+    class atfu_bm_ ## name : public atf::tests::bench { \
+        void head(void); \
+        void measure(const std::size_t) const; \
+    public: \
+        atfu_bm_ ## name(const char* ident) : atf::tests::bench(ident) {} \
+        static atf::tests::tc* atfu_create(const char* ident) \
+            { return new atfu_bm_ ## name(ident); } \
+    }; \
+    }
+
+#define ATF_BENCHMARK_TEMPLATE_HEAD(name, param) \
+    template< typename param > \
+    void \
+    atfu_bm_ ## name< param >::head(void)
+
+#define ATF_BENCHMARK_TEMPLATE_BODY(name, param, iters) \
+    template< typename param > \
+    void \
+    atfu_bm_ ## name< param >::measure(const std::size_t iters) \
+        const
+
 #define ATF_TEST_CASE_NAME(name) atfu_tc_ ## name
-#define ATF_TEST_CASE_USE(name) (atfu_tcptr_ ## name) = NULL
+#define ATF_TEST_CASE_USE(name) (void)atfu_tc_ ## name::atfu_create
 
 #define ATF_TEST_CASE_HEAD(name) \
     void \
@@ -200,11 +274,11 @@
     namespace atf { \
         namespace tests { \
             int run_tp(int, char**, \
-                       void (*)(std::vector< atf::tests::tc * >&)); \
+                       void (*)(atf::tests::detail::tc_table&)); \
         } \
     } \
     \
-    static void atfu_init_tcs(std::vector< atf::tests::tc * >&); \
+    static void atfu_init_tcs(atf::tests::detail::tc_table&); \
     \
     int \
     main(int argc, char** argv) \
@@ -214,12 +288,25 @@
     \
     static \
     void \
-    atfu_init_tcs(std::vector< atf::tests::tc * >& tcs)
+    atfu_init_tcs(atf::tests::detail::tc_table& tcs)
 
+// Test cases are only registered here; the library instantiates the one
+// selected by the command line (or each of them in turn when listing).
 #define ATF_ADD_TEST_CASE(tcs, tcname) \
     do { \
-        atfu_tcptr_ ## tcname = new atfu_tc_ ## tcname(); \
-        (tcs).push_back(atfu_tcptr_ ## tcname); \
+        const atf::tests::detail::tc_entry atfu_entry = \
+            { #tcname, atfu_tc_ ## tcname::atfu_create }; \
+        (tcs).push_back(atfu_entry); \
+    } while (0);
+
+// Registers one instantiation of a benchmark template under the name
+// "<name>_<suffix>".  The type goes last so that it can contain commas.
+#define ATF_ADD_BENCHMARK_TEMPLATE(tcs, name, suffix, ...) \
+    do { \
+        const atf::tests::detail::tc_entry atfu_entry = \
+            { #name "_" #suffix, \
+              atfu_bm_ ## name< __VA_ARGS__ >::atfu_create }; \
+        (tcs).push_back(atfu_entry); \
     } while (0);
 
 #endif // !defined(ATF_CXX_MACROS_HPP)
@@ -26,6 +26,7 @@
 #include <atf-c++/macros.hpp>
 
 #include <stdexcept>
+#include <utility>
 
 void
 atf_check_errno_semicolons(void)
@@ -124,3 +125,33 @@ void instatiate_3(void) {
     atf::tests::tc* the_test = new ATF_TEST_CASE_NAME(TEST_MACRO_3)();
     delete the_test;
 }
+#define TEST_MACRO_4 invalid + name
+#define TEST_MACRO_5 invalid + name
+#define TEST_MACRO_6 invalid + name
+ATF_BENCHMARK(TEST_MACRO_4);
+ATF_BENCHMARK_HEAD(TEST_MACRO_4) { }
+ATF_BENCHMARK_BODY(TEST_MACRO_4, n) { atf::tests::do_not_optimize(n); }
+void instantiate_4(void) {
+    ATF_TEST_CASE_USE(TEST_MACRO_4);
+    atf::tests::tc* the_test = new ATF_TEST_CASE_NAME(TEST_MACRO_4)();
+    delete the_test;
+}
+ATF_BENCHMARK_WITHOUT_HEAD(TEST_MACRO_6);
+ATF_BENCHMARK_BODY(TEST_MACRO_6, n) { atf::tests::do_not_optimize(n); }
+void instantiate_6(void) {
+    ATF_TEST_CASE_USE(TEST_MACRO_6);
+    atf::tests::tc* the_test = new ATF_TEST_CASE_NAME(TEST_MACRO_6)();
+    delete the_test;
+}
+ATF_BENCHMARK_TEMPLATE(TEST_MACRO_5, T);
+ATF_BENCHMARK_TEMPLATE_HEAD(TEST_MACRO_5, T) { }
+ATF_BENCHMARK_TEMPLATE_BODY(TEST_MACRO_5, T, n) {
+    const T value = T();
+    atf::tests::do_not_optimize(value);
+    atf::tests::do_not_optimize(n);
+}
+void instantiate_5(void) {
+    atf::tests::detail::tc_table tcs;
+    ATF_ADD_BENCHMARK_TEMPLATE(tcs, TEST_MACRO_5, int, int);
+    ATF_ADD_BENCHMARK_TEMPLATE(tcs, TEST_MACRO_5, pair, std::pair< int, int >);
+}
@@ -277,6 +277,27 @@ ATF_TEST_CASE_BODY(h_require_errno)
     create_ctl_file("after");
 }
 
+ATF_BENCHMARK(h_bench);
+ATF_BENCHMARK_HEAD(h_bench)
+{
+    set_md_var("descr", "Helper benchmark");
+}
+ATF_BENCHMARK_BODY(h_bench, iters)
+{
+    ATF_REQUIRE(iters > 0);
+    for (std::size_t i = 0; i < iters; i++) {
+        int value = static_cast< int >(i);
+        atf::tests::do_not_optimize(value);
+        atf::tests::clobber_memory();
+    }
+}
+
+ATF_BENCHMARK_WITHOUT_HEAD(h_bench_without_head);
+ATF_BENCHMARK_BODY(h_bench_without_head, iters)
+{
+    atf::tests::do_not_optimize(iters);
+}
+
 // ------------------------------------------------------------------------
 // Test cases for the macros.
 // ------------------------------------------------------------------------
@@ -751,6 +772,53 @@ ATF_TEST_CASE_BODY(require_errno)
     }
 }
 
+ATF_TEST_CASE(benchmark);
+ATF_TEST_CASE_HEAD(benchmark)
+{
+    set_md_var("descr", "Tests the ATF_BENCHMARK macros");
+}
+ATF_TEST_CASE_BODY(benchmark)
+{
+    ATF_TEST_CASE_USE(h_bench);
+
+    ATF_TEST_CASE_NAME(h_bench) bm;
+    bm.init(atf::tests::vars_map());
+    ATF_REQUIRE_EQ("benchmark", bm.get_md_var("X-type"));
+    ATF_REQUIRE_EQ("Helper benchmark", bm.get_md_var("descr"));
+
+    atf::tests::vars_map config;
+    config["bench.time_ms"] = "1";
+    config["bench.runs"] = "3";
+    run_h_tc< ATF_TEST_CASE_NAME(h_bench) >(config);
+    ATF_REQUIRE(atf::utils::grep_file("^passed", "result"));
+    ATF_REQUIRE(atf::utils::grep_file("^bench: h_bench: [0-9]+ iterations "
+                                      "x 3 runs; ", "stdout"));
+}
+
+ATF_TEST_CASE(benchmark_without_head);
+ATF_TEST_CASE_HEAD(benchmark_without_head)
+{
+    set_md_var("descr", "Tests the ATF_BENCHMARK_WITHOUT_HEAD macro");
+}
+ATF_TEST_CASE_BODY(benchmark_without_head)
+{
+    ATF_TEST_CASE_USE(h_bench_without_head);
+
+    ATF_TEST_CASE_NAME(h_bench_without_head) bm;
+    bm.init(atf::tests::vars_map());
+    ATF_REQUIRE_EQ("benchmark", bm.get_md_var("X-type"));
+    ATF_REQUIRE(!bm.has_md_var("descr"));
+
+    atf::tests::vars_map config;
+    config["bench.time_ms"] = "1";
+    config["bench.runs"] = "3";
+    run_h_tc< ATF_TEST_CASE_NAME(h_bench_without_head) >(config);
+    ATF_REQUIRE(atf::utils::grep_file("^passed", "result"));
+    ATF_REQUIRE(atf::utils::grep_file("^bench: h_bench_without_head: "
+                                      "[0-9]+ iterations x 3 runs; ",
+                                      "stdout"));
+}
+
 // ------------------------------------------------------------------------
 // Tests cases for the header file.
 // ------------------------------------------------------------------------
@@ -804,6 +872,8 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, require_throw);
     ATF_ADD_TEST_CASE(tcs, require_throw_re);
     ATF_ADD_TEST_CASE(tcs, require_errno);
+    ATF_ADD_TEST_CASE(tcs, benchmark);
+    ATF_ADD_TEST_CASE(tcs, benchmark_without_head);
 
     // Add the test cases for the header file.
     ATF_ADD_TEST_CASE(tcs, use);
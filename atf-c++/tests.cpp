@@ -52,9 +52,10 @@ extern "C" {
 #include <vector>
 
 extern "C" {
+#include "atf-c/detail/repeat.h"
+#include "atf-c/detail/watchdog.h"
 #include "atf-c/error.h"
 #include "atf-c/tc.h"
-#include "atf-c/utils.h"
 }
 
 #include "atf-c++/detail/application.hpp"
@@ -89,7 +90,7 @@ detail::atf_tp_writer::atf_tp_writer(std::ostream& os) :
 }
 
 void
-detail::atf_tp_writer::start_tc(const std::string& ident)
+detail::atf_tp_writer::start_tc(const char* ident)
 {
     if (!m_is_first)
         m_os << "\n";
@@ -105,10 +106,9 @@ detail::atf_tp_writer::end_tc(void)
 }
 
 void
-detail::atf_tp_writer::tc_meta_data(const std::string& name,
-                                    const std::string& value)
+detail::atf_tp_writer::tc_meta_data(const char* name, const char* value)
 {
-    PRE(name != "ident");
+    PRE(std::strcmp(name, "ident") != 0);
     m_os << name << ": " << value << "\n";
     m_os.flush();
 }
@@ -138,12 +138,31 @@ detail::match(const std::string& regexp, const std::string& str)
     return atf::text::match(str, regexp);
 }
 
+// ------------------------------------------------------------------------
+// The "md_visitor" class.
+// ------------------------------------------------------------------------
+
+impl::md_visitor::~md_visitor(void)
+{
+}
+
 // ------------------------------------------------------------------------
 // The "tc" class.
 // ------------------------------------------------------------------------
 
-static std::map< atf_tc_t*, impl::tc* > wraps;
-static std::map< const atf_tc_t*, const impl::tc* > cwraps;
+// Glue between a C test case and the C++ object that owns it.  The C
+// structure must be the first member so that the callbacks can recover
+// the owner from the pointer they receive without any lookup.
+struct tc_handle {
+    atf_tc_t m_tc;
+    impl::tc* m_owner;
+};
+
+static impl::tc*
+owner_of(const atf_tc_t* tc)
+{
+    return reinterpret_cast< const tc_handle* >(tc)->m_owner;
+}
 
 struct impl::tc_impl {
 private:
@@ -153,53 +172,59 @@ private:
 
 public:
     std::string m_ident;
-    atf_tc_t m_tc;
+    tc_handle m_handle;
     bool m_has_cleanup;
 
-    tc_impl(const std::string& ident, const bool has_cleanup) :
+    tc_impl(const std::string& ident, const bool has_cleanup,
+            impl::tc* owner) :
         m_ident(ident),
         m_has_cleanup(has_cleanup)
     {
+        m_handle.m_owner = owner;
     }
 
     static void
     wrap_head(atf_tc_t *tc)
     {
-        std::map< atf_tc_t*, impl::tc* >::iterator iter = wraps.find(tc);
-        INV(iter != wraps.end());
-        (*iter).second->head();
+        impl::tc* owner = owner_of(tc);
+
+        owner->head_defaults();
+        owner->head();
     }
 
     static void
     wrap_body(const atf_tc_t *tc)
     {
-        std::map< const atf_tc_t*, const impl::tc* >::const_iterator iter =
-            cwraps.find(tc);
-        INV(iter != cwraps.end());
-        (*iter).second->body();
+        owner_of(tc)->body();
     }
 
     static void
     wrap_cleanup(const atf_tc_t *tc)
     {
-        std::map< const atf_tc_t*, const impl::tc* >::const_iterator iter =
-            cwraps.find(tc);
-        INV(iter != cwraps.end());
-        (*iter).second->cleanup();
+        owner_of(tc)->cleanup();
+    }
+
+    static void
+    wrap_measure(const atf_tc_t *tc, const size_t iters)
+    {
+        static_cast< const impl::bench* >(owner_of(tc))->measure(iters);
+    }
+
+    static void
+    run_bench(const impl::bench& b)
+    {
+        atf_tc_run_bench(&b.pimpl->m_handle.m_tc, wrap_measure);
     }
 };
 
 impl::tc::tc(const std::string& ident, const bool has_cleanup) :
-    pimpl(new tc_impl(ident, has_cleanup))
+    pimpl(new tc_impl(ident, has_cleanup, this))
 {
 }
 
 impl::tc::~tc(void)
 {
-    cwraps.erase(&pimpl->m_tc);
-    wraps.erase(&pimpl->m_tc);
-
-    atf_tc_fini(&pimpl->m_tc);
+    atf_tc_fini(&pimpl->m_handle.m_tc);
 }
 
 void
@@ -217,12 +242,9 @@ impl::tc::init(const vars_map& config)
     }
     *ptr = NULL;
 
-    wraps[&pimpl->m_tc] = this;
-    cwraps[&pimpl->m_tc] = this;
-
-    err = atf_tc_init(&pimpl->m_tc, pimpl->m_ident.c_str(), pimpl->wrap_head,
-        pimpl->wrap_body, pimpl->m_has_cleanup ? pimpl->wrap_cleanup : NULL,
-        array.get());
+    err = atf_tc_init(&pimpl->m_handle.m_tc, pimpl->m_ident.c_str(),
+        pimpl->wrap_head, pimpl->wrap_body,
+        pimpl->m_has_cleanup ? pimpl->wrap_cleanup : NULL, array.get());
     if (atf_is_error(err))
         throw_atf_error(err);
 }
@@ -231,60 +253,89 @@ bool
 impl::tc::has_config_var(const std::string& var)
     const
 {
-    return atf_tc_has_config_var(&pimpl->m_tc, var.c_str());
+    return atf_tc_has_config_var(&pimpl->m_handle.m_tc, var.c_str());
 }
 
 bool
 impl::tc::has_md_var(const std::string& var)
     const
 {
-    return atf_tc_has_md_var(&pimpl->m_tc, var.c_str());
+    return atf_tc_has_md_var(&pimpl->m_handle.m_tc, var.c_str());
 }
 
 const std::string
 impl::tc::get_config_var(const std::string& var)
     const
 {
-    return atf_tc_get_config_var(&pimpl->m_tc, var.c_str());
+    return atf_tc_get_config_var(&pimpl->m_handle.m_tc, var.c_str());
 }
 
 const std::string
 impl::tc::get_config_var(const std::string& var, const std::string& defval)
     const
 {
-    return atf_tc_get_config_var_wd(&pimpl->m_tc, var.c_str(), defval.c_str());
+    return atf_tc_get_config_var_wd(&pimpl->m_handle.m_tc, var.c_str(),
+                                    defval.c_str());
 }
 
 const std::string
 impl::tc::get_md_var(const std::string& var)
     const
 {
-    return atf_tc_get_md_var(&pimpl->m_tc, var.c_str());
+    return atf_tc_get_md_var(&pimpl->m_handle.m_tc, var.c_str());
 }
 
+namespace {
+
+class vars_map_builder : public impl::md_visitor {
+    impl::vars_map& m_vars;
+
+public:
+    vars_map_builder(impl::vars_map& vars) :
+        m_vars(vars)
+    {
+    }
+
+    void
+    visit(const char* name, const char* value)
+    {
+        m_vars[name] = value;
+    }
+};
+
+} // anonymous namespace
+
 const impl::vars_map
 impl::tc::get_md_vars(void)
     const
 {
     vars_map vars;
+    vars_map_builder builder(vars);
+    for_each_md_var(builder);
+    return vars;
+}
 
-    char **array = atf_tc_get_md_vars(&pimpl->m_tc);
-    try {
-        char **ptr;
-        for (ptr = array; *ptr != NULL; ptr += 2)
-            vars[*ptr] = *(ptr + 1);
-    } catch (...) {
-        atf_utils_free_charpp(array);
-        throw;
-    }
+static atf_error_t
+visit_md_var(const char* name, const char* value, void* data)
+{
+    static_cast< impl::md_visitor* >(data)->visit(name, value);
+    return atf_no_error();
+}
 
-    return vars;
+void
+impl::tc::for_each_md_var(md_visitor& visitor)
+    const
+{
+    atf_error_t err = atf_tc_for_each_md_var(&pimpl->m_handle.m_tc,
+                                             visit_md_var, &visitor);
+    INV(!atf_is_error(err));
 }
 
 void
 impl::tc::set_md_var(const std::string& var, const std::string& val)
 {
-    atf_error_t err = atf_tc_set_md_var(&pimpl->m_tc, var.c_str(), val.c_str());
+    atf_error_t err = atf_tc_set_md_var(&pimpl->m_handle.m_tc, var.c_str(),
+                                        val.c_str());
     if (atf_is_error(err))
         throw_atf_error(err);
 }
@@ -293,7 +344,7 @@ void
 impl::tc::run(const std::string& resfile)
     const
 {
-    atf_error_t err = atf_tc_run(&pimpl->m_tc, resfile.c_str());
+    atf_error_t err = atf_tc_run(&pimpl->m_handle.m_tc, resfile.c_str());
     if (atf_is_error(err))
         throw_atf_error(err);
 }
@@ -302,11 +353,16 @@ void
 impl::tc::run_cleanup(void)
     const
 {
-    atf_error_t err = atf_tc_cleanup(&pimpl->m_tc);
+    atf_error_t err = atf_tc_cleanup(&pimpl->m_handle.m_tc);
     if (atf_is_error(err))
         throw_atf_error(err);
 }
 
+void
+impl::tc::head_defaults(void)
+{
+}
+
 void
 impl::tc::head(void)
 {
@@ -399,14 +455,43 @@ impl::tc::expect_timeout(const std::string& reason)
     atf_tc_expect_timeout("%s", reason.c_str());
 }
 
+// ------------------------------------------------------------------------
+// The "bench" class.
+// ------------------------------------------------------------------------
+
+impl::bench::bench(const std::string& ident) :
+    tc(ident, false)
+{
+}
+
+impl::bench::~bench(void)
+{
+}
+
+void
+impl::bench::head_defaults(void)
+{
+    set_md_var("X-type", "benchmark");
+}
+
+void
+impl::bench::body(void)
+    const
+{
+    tc_impl::run_bench(*this);
+}
+
+void
+detail::use_pointer(const volatile void*)
+{
+}
+
 // ------------------------------------------------------------------------
 // Test program main code.
 // ------------------------------------------------------------------------
 
 namespace {
 
-typedef std::vector< impl::tc * > tc_vector;
-
 enum tc_part { BODY, CLEANUP };
 
 static void
@@ -415,15 +500,16 @@ parse_vflag(const std::string& str, atf::tests::vars_map& vars)
     if (str.empty())
         throw std::runtime_error("-v requires a non-empty argument");
 
-    std::vector< std::string > ws = atf::text::split(str, "=");
-    if (ws.size() == 1 && str[str.length() - 1] == '=') {
-        vars[ws[0]] = "";
+    atf::text::string_ref ws[2];
+    const std::size_t nws = atf::text::split(str, "=", ws, 2);
+    if (nws == 1 && str[str.length() - 1] == '=') {
+        vars[ws[0].str()] = "";
     } else {
-        if (ws.size() != 2)
+        if (nws != 2)
             throw std::runtime_error("-v requires an argument of the form "
                                      "var=value");
 
-        vars[ws[0]] = ws[1];
+        vars[ws[0].str()] = ws[1].str();
     }
 }
 
@@ -449,56 +535,57 @@ handle_srcdir(const char* argv0, const std::string& srcdir_arg)
     return srcdir;
 }
 
-static void
-init_tcs(void (*add_tcs)(tc_vector&), tc_vector& tcs,
-         const atf::tests::vars_map& vars)
+static std::unique_ptr< impl::tc >
+create_tc(const detail::tc_entry& entry, const atf::tests::vars_map& vars)
 {
-    add_tcs(tcs);
-    for (tc_vector::iterator iter = tcs.begin(); iter != tcs.end(); iter++) {
-        impl::tc* tc = *iter;
+    std::unique_ptr< impl::tc > tc(entry.m_factory(entry.m_ident));
+    tc->init(vars);
+    return tc;
+}
+
+class md_writer : public impl::md_visitor {
+    detail::atf_tp_writer& m_writer;
+
+public:
+    md_writer(detail::atf_tp_writer& writer) :
+        m_writer(writer)
+    {
+    }
 
-        tc->init(vars);
+    void
+    visit(const char* name, const char* value)
+    {
+        // The properties are visited in definition order, so 'ident' is
+        // always the first one.
+        if (std::strcmp(name, "ident") == 0)
+            m_writer.start_tc(value);
+        else
+            m_writer.tc_meta_data(name, value);
     }
-}
+};
 
 static int
-list_tcs(const tc_vector& tcs)
+list_tcs(const detail::tc_table& tcs, const atf::tests::vars_map& config)
 {
     detail::atf_tp_writer writer(std::cout);
+    md_writer visitor(writer);
 
-    for (tc_vector::const_iterator iter = tcs.begin();
+    for (detail::tc_table::const_iterator iter = tcs.begin();
          iter != tcs.end(); iter++) {
-        const impl::vars_map vars = (*iter)->get_md_vars();
-
-        {
-            impl::vars_map::const_iterator iter2 = vars.find("ident");
-            INV(iter2 != vars.end());
-            writer.start_tc((*iter2).second);
-        }
-
-        for (impl::vars_map::const_iterator iter2 = vars.begin();
-             iter2 != vars.end(); iter2++) {
-            const std::string& key = (*iter2).first;
-            if (key != "ident")
-                writer.tc_meta_data(key, (*iter2).second);
-        }
-
+        create_tc(*iter, config)->for_each_md_var(visitor);
         writer.end_tc();
     }
 
     return EXIT_SUCCESS;
 }
 
-static impl::tc*
-find_tc(tc_vector tcs, const std::string& name)
+static const detail::tc_entry&
+find_tc(const detail::tc_table& tcs, const std::string& name)
 {
-    std::vector< std::string > ids;
-    for (tc_vector::iterator iter = tcs.begin();
+    for (detail::tc_table::const_iterator iter = tcs.begin();
          iter != tcs.end(); iter++) {
-        impl::tc* tc = *iter;
-
-        if (tc->get_md_var("ident") == name)
-            return tc;
+        if (name == (*iter).m_ident)
+            return *iter;
     }
     throw usage_error("Unknown test case `%s'", name.c_str());
 }
@@ -523,21 +610,104 @@ process_tcarg(const std::string& tcarg)
     }
 }
 
+static void
+child_body(void* data, const char* resfile)
+{
+    const impl::tc* tc = static_cast< const impl::tc* >(data);
+    try {
+        tc->run(resfile);
+    } catch (const std::exception& e) {
+        std::cerr << Program_Name << ": ERROR: " << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+static void
+child_cleanup(void* data)
+{
+    const impl::tc* tc = static_cast< const impl::tc* >(data);
+    try {
+        tc->run_cleanup();
+    } catch (const std::exception& e) {
+        std::cerr << Program_Name << ": ERROR: " << e.what() << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+//!
+//! \brief Runs the body of a test case as requested by -n and -d.
+//!
 static int
-run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path& resfile)
+repeat_tc(impl::tc& tc, const std::string& tcname, const atf_repeat_t& repeat,
+          const atf::fs::path& resfile)
+{
+    const bool has_cleanup = tc.has_md_var("has.cleanup");
+
+    bool passed;
+    atf_error_t err = atf_repeat_run(&repeat, tcname.c_str(), child_body,
+                                     has_cleanup ? child_cleanup : NULL,
+                                     &tc, resfile.c_str(), &passed);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//!
+//! \brief Runs the body of a test case within its timeout as requested by -t.
+//!
+static int
+watchdog_tc(impl::tc& tc, const atf_watchdog_t& watchdog,
+            const atf::fs::path& resfile)
+{
+    const bool has_cleanup = tc.has_md_var("has.cleanup");
+    const bool has_timeout = tc.has_md_var("timeout");
+    const std::string timeout = has_timeout ? tc.get_md_var("timeout") : "";
+
+    bool passed;
+    atf_error_t err = atf_watchdog_run(&watchdog,
+                                       has_timeout ? timeout.c_str() : NULL,
+                                       child_body,
+                                       has_cleanup ? child_cleanup : NULL,
+                                       &tc, resfile.c_str(), &passed);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int
+run_tc(const detail::tc_table& tcs, const std::string& tcarg,
+       const atf::tests::vars_map& vars, const atf_repeat_t& repeat,
+       const atf_watchdog_t& watchdog, const atf::fs::path& resfile)
 {
     const std::pair< std::string, tc_part > fields = process_tcarg(tcarg);
 
-    impl::tc* tc = find_tc(tcs, fields.first);
+    const detail::tc_entry& entry = find_tc(tcs, fields.first);
 
     if (!atf::env::has("__RUNNING_INSIDE_ATF_RUN") || atf::env::get(
         "__RUNNING_INSIDE_ATF_RUN") != "internal-yes-value")
     {
         std::cerr << Program_Name << ": WARNING: Running test cases outside "
             "of kyua(1) is unsupported\n";
-        std::cerr << Program_Name << ": WARNING: No isolation nor timeout "
-            "control is being applied; you may get unexpected failures; see "
-            "atf-test-case(4)\n";
+        if (atf_watchdog_enabled(&watchdog))
+            std::cerr << Program_Name << ": WARNING: No isolation is being "
+                "applied; you may get unexpected failures; see "
+                "atf-test-case(4)\n";
+        else
+            std::cerr << Program_Name << ": WARNING: No isolation nor "
+                "timeout control is being applied; you may get unexpected "
+                "failures; see atf-test-case(4)\n";
+    }
+
+    std::unique_ptr< impl::tc > tc = create_tc(entry, vars);
+    if (atf_repeat_enabled(&repeat)) {
+        if (fields.second != BODY)
+            throw usage_error("Cannot repeat the cleanup of a test case");
+        return repeat_tc(*tc, fields.first, repeat, resfile);
+    } else if (atf_watchdog_enabled(&watchdog)) {
+        if (fields.second != BODY)
+            throw usage_error("Cannot enforce the timeout of the cleanup of "
+                              "a test case");
+        return watchdog_tc(*tc, watchdog, resfile);
     }
 
     switch (fields.second) {
@@ -554,7 +724,7 @@ run_tc(tc_vector& tcs, const std::string& tcarg, const atf::fs::path& resfile)
 }
 
 static int
-safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
+safe_main(int argc, char** argv, void (*add_tcs)(detail::tc_table&))
 {
     const char* argv0 = argv[0];
 
@@ -562,18 +732,34 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
     atf::fs::path resfile("/dev/stdout");
     std::string srcdir_arg;
     atf::tests::vars_map vars;
+    atf_repeat_t repeat;
+    atf_repeat_init(&repeat);
+    atf_watchdog_t watchdog;
+    atf_watchdog_init(&watchdog);
 
     int ch;
     int old_opterr;
 
     old_opterr = opterr;
     ::opterr = 0;
-    while ((ch = ::getopt(argc, argv, GETOPT_POSIX ":lr:s:v:")) != -1) {
+    while ((ch = ::getopt(argc, argv, GETOPT_POSIX ":d:ln:r:s:t:v:")) != -1) {
         switch (ch) {
+        case 'd':
+            if (!atf_repeat_set_duration(&repeat, ::optarg))
+                throw usage_error("Invalid duration `%s'; must be a positive "
+                                  "number of seconds", ::optarg);
+            break;
+
         case 'l':
             lflag = true;
             break;
 
+        case 'n':
+            if (!atf_repeat_set_runs(&repeat, ::optarg))
+                throw usage_error("Invalid number of runs `%s'; must be a "
+                                  "positive integer", ::optarg);
+            break;
+
         case 'r':
             resfile = atf::fs::path(::optarg);
             break;
@@ -582,6 +768,12 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
             srcdir_arg = ::optarg;
             break;
 
+        case 't':
+            if (!atf_watchdog_set_grace(&watchdog, ::optarg))
+                throw usage_error("Invalid grace period `%s'; must be a "
+                                  "positive number of seconds", ::optarg);
+            break;
+
         case 'v':
             parse_vflag(::optarg, vars);
             break;
@@ -607,44 +799,43 @@ safe_main(int argc, char** argv, void (*add_tcs)(tc_vector&))
 
     vars["srcdir"] = handle_srcdir(argv0, srcdir_arg).str();
 
-    int errcode;
+    detail::tc_table tcs;
+    add_tcs(tcs);
 
-    tc_vector tcs;
     if (lflag) {
         if (argc > 0)
             throw usage_error("Cannot provide test case names with -l");
+        if (atf_repeat_enabled(&repeat))
+            throw usage_error("Cannot repeat test cases with -l");
+        if (atf_watchdog_enabled(&watchdog))
+            throw usage_error("Cannot enforce timeouts with -l");
 
-        init_tcs(add_tcs, tcs, vars);
-        errcode = list_tcs(tcs);
+        return list_tcs(tcs, vars);
     } else {
         if (argc == 0)
             throw usage_error("Must provide a test case name");
         else if (argc > 1)
             throw usage_error("Cannot provide more than one test case name");
+        else if (atf_repeat_enabled(&repeat) &&
+                 atf_watchdog_enabled(&watchdog))
+            throw usage_error("Cannot enforce timeouts of repeated test "
+                              "cases");
         INV(argc == 1);
 
-        init_tcs(add_tcs, tcs, vars);
-        errcode = run_tc(tcs, argv[0], resfile);
+        return run_tc(tcs, argv[0], vars, repeat, watchdog, resfile);
     }
-    for (tc_vector::iterator iter = tcs.begin(); iter != tcs.end(); iter++) {
-        impl::tc* tc = *iter;
-
-        delete tc;
-    }
-
-    return errcode;
 }
 
 }  // anonymous namespace
 
 namespace atf {
     namespace tests {
-        int run_tp(int, char**, void (*)(tc_vector&));
+        int run_tp(int, char**, void (*)(detail::tc_table&));
     }
 }
 
 int
-impl::run_tp(int argc, char** argv, void (*add_tcs)(tc_vector&))
+impl::run_tp(int argc, char** argv, void (*add_tcs)(detail::tc_table&))
 {
     try {
         set_program_name(argv[0]);
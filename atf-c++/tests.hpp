@@ -26,9 +26,11 @@
 #if !defined(ATF_CXX_TESTS_HPP)
 #define ATF_CXX_TESTS_HPP
 
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 extern "C" {
 #include <atf-c/defs.h>
@@ -47,9 +49,9 @@ class atf_tp_writer {
 public:
     atf_tp_writer(std::ostream&);
 
-    void start_tc(const std::string&);
+    void start_tc(const char*);
     void end_tc(void);
-    void tc_meta_data(const std::string&, const std::string&);
+    void tc_meta_data(const char*, const char*);
 };
 
 bool match(const std::string&, const std::string&);
@@ -62,6 +64,24 @@ bool match(const std::string&, const std::string&);
 
 typedef std::map< std::string, std::string > vars_map;
 
+// ------------------------------------------------------------------------
+// The "md_visitor" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief Receives the meta-data properties of a test case.
+//!
+//! The name and value passed to visit() point into the test case's own
+//! storage; they are only valid until the test case is modified and must
+//! be copied if they need to outlive the call.
+//!
+class md_visitor {
+public:
+    virtual ~md_visitor(void);
+
+    virtual void visit(const char*, const char*) = 0;
+};
+
 // ------------------------------------------------------------------------
 // The "tc" class.
 // ------------------------------------------------------------------------
@@ -75,6 +95,9 @@ class tc {
 
     std::unique_ptr< tc_impl > pimpl;
 
+    //! Sets the metadata implied by the kind of test case; runs before head.
+    virtual void head_defaults(void);
+
 protected:
     virtual void head(void);
     virtual void body(void) const = 0;
@@ -95,6 +118,7 @@ public:
         const;
     const std::string get_md_var(const std::string&) const;
     const vars_map get_md_vars(void) const;
+    void for_each_md_var(md_visitor&) const;
     bool has_config_var(const std::string&) const;
     bool has_md_var(const std::string&) const;
     void set_md_var(const std::string&, const std::string&);
@@ -119,6 +143,94 @@ public:
     static void expect_timeout(const std::string&);
 };
 
+// ------------------------------------------------------------------------
+// The "bench" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief A test case that measures the performance of some code.
+//!
+//! Subclasses implement measure(), which has to run the measured code the
+//! given number of times.  The body calibrates that number against the
+//! bench.time_ms configuration variable and prints timing statistics
+//! over bench.runs runs, like the atf-c ATF_BENCH test cases do.
+//!
+class bench : public tc {
+    void head_defaults(void);
+    void body(void) const;
+
+protected:
+    virtual void measure(const std::size_t) const = 0;
+
+    friend struct tc_impl;
+
+public:
+    bench(const std::string&);
+    virtual ~bench(void);
+};
+
+namespace detail {
+
+void use_pointer(const volatile void*);
+
+} // namespace detail
+
+//!
+//! \brief Prevents the compiler from optimizing away a value.
+//!
+//! Benchmarks should pass the results of the measured code to this
+//! function so that the computation is not elided because its result is
+//! unused.
+//!
+template< typename T >
+inline void
+do_not_optimize(const T& value)
+{
+#if defined(__GNUC__)
+    __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#else
+    detail::use_pointer(&value);
+#endif
+}
+
+//!
+//! \brief Forces pending memory writes to be considered observable.
+//!
+//! Prevents the compiler from eliding or reordering stores to memory
+//! across this point, e.g. to a buffer that is never read back.
+//!
+inline void
+clobber_memory(void)
+{
+#if defined(__GNUC__)
+    __asm__ __volatile__("" : : : "memory");
+#else
+    detail::use_pointer(NULL);
+#endif
+}
+
+namespace detail {
+
+// ------------------------------------------------------------------------
+// The "tc_table" class.
+// ------------------------------------------------------------------------
+
+//!
+//! \brief An entry of the table of test cases in a test program.
+//!
+//! Entries are built by the ATF_ADD_TEST_CASE macro and are cheap to
+//! create: the test case itself is only instantiated on demand through
+//! the factory, which receives the identifier of the entry.
+//!
+struct tc_entry {
+    const char* m_ident;
+    tc* (*m_factory)(const char*);
+};
+
+typedef std::vector< tc_entry > tc_table;
+
+} // namespace detail
+
 } // namespace tests
 } // namespace atf
 
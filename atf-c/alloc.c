@@ -0,0 +1,283 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+/* Allocator hooks for the allocation tracking of atf-c test cases.
+ *
+ * Linking a test program against this library replaces the allocation
+ * functions of the C library with wrappers that account for every block
+ * before forwarding the call.  C++ programs are covered too because the
+ * default operator new and operator delete are built on top of these. */
+
+/* RTLD_NEXT is a GNU extension in glibc. */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#if defined(HAVE_MALLOC_H)
+#include <malloc.h>
+#elif defined(HAVE_MALLOC_NP_H)
+#include <malloc_np.h>
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atf-c/detail/alloc.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static void *(*Real_malloc)(size_t);
+static void *(*Real_calloc)(size_t, size_t);
+static void *(*Real_realloc)(void *, size_t);
+static void (*Real_free)(void *);
+static int (*Real_posix_memalign)(void **, size_t, size_t);
+static void *(*Real_aligned_alloc)(size_t, size_t);
+
+/* dlsym(3) may allocate memory while we look up the real functions.  Such
+ * requests are served from a static buffer that is never reclaimed. */
+static union {
+    max_align_t align;
+    char data[8192];
+} Bootstrap;
+static size_t Bootstrap_used = 0;
+static bool Resolving = false;
+
+static void *
+bootstrap_alloc(const size_t size)
+{
+    const size_t rounded = (size + sizeof(max_align_t) - 1) &
+        ~(sizeof(max_align_t) - 1);
+    void *ptr;
+
+    if (rounded > sizeof(Bootstrap.data) - Bootstrap_used)
+        return NULL;
+    ptr = &Bootstrap.data[Bootstrap_used];
+    Bootstrap_used += rounded;
+    return ptr;
+}
+
+static bool
+is_bootstrap(const void *ptr)
+{
+    const char *p = ptr;
+
+    return p >= Bootstrap.data && p < Bootstrap.data + sizeof(Bootstrap.data);
+}
+
+static void
+resolve(void)
+{
+    Resolving = true;
+    Real_malloc = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    Real_calloc = (void *(*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+    Real_realloc = (void *(*)(void *, size_t))dlsym(RTLD_NEXT, "realloc");
+    Real_free = (void (*)(void *))dlsym(RTLD_NEXT, "free");
+    Real_posix_memalign = (int (*)(void **, size_t, size_t))dlsym(
+        RTLD_NEXT, "posix_memalign");
+    Real_aligned_alloc = (void *(*)(size_t, size_t))dlsym(
+        RTLD_NEXT, "aligned_alloc");
+    Resolving = false;
+
+    if (Real_malloc == NULL || Real_calloc == NULL || Real_realloc == NULL ||
+        Real_free == NULL)
+        abort();
+    atf_alloc_install();
+}
+
+/* Gets the size of a block as seen by the allocator.  Without
+ * malloc_usable_size(3), released blocks cannot be measured, so the
+ * amount of live memory only ever grows. */
+static size_t
+usable_size(void *ptr, const size_t requested)
+{
+#if defined(HAVE_MALLOC_USABLE_SIZE)
+    (void)requested;
+    return malloc_usable_size(ptr);
+#else
+    (void)ptr;
+    return requested;
+#endif
+}
+
+static void
+record(void *ptr, const size_t size, const void *caller)
+{
+    if (ptr != NULL)
+        atf_alloc_record(caller, size, usable_size(ptr, size));
+}
+
+static void
+record_free(void *ptr)
+{
+#if defined(HAVE_MALLOC_USABLE_SIZE)
+    atf_alloc_record_free(malloc_usable_size(ptr));
+#else
+    (void)ptr;
+#endif
+}
+
+__attribute__((constructor))
+static void
+init(void)
+{
+    if (Real_malloc == NULL)
+        resolve();
+}
+
+/* ---------------------------------------------------------------------
+ * Allocation functions.
+ * --------------------------------------------------------------------- */
+
+void *
+malloc(size_t size)
+{
+    void *ptr;
+
+    if (Real_malloc == NULL) {
+        if (Resolving)
+            return bootstrap_alloc(size);
+        resolve();
+    }
+
+    ptr = Real_malloc(size);
+    record(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    void *ptr;
+
+    if (Real_calloc == NULL) {
+        if (Resolving) {
+            /* The buffer is zeroed and never reused. */
+            if (size != 0 && nmemb > SIZE_MAX / size)
+                return NULL;
+            return bootstrap_alloc(nmemb * size);
+        }
+        resolve();
+    }
+
+    ptr = Real_calloc(nmemb, size);
+    record(ptr, nmemb * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    void *newptr;
+
+    if (Real_realloc == NULL) {
+        if (Resolving)
+            return ptr == NULL ? bootstrap_alloc(size) : NULL;
+        resolve();
+    }
+
+    if (is_bootstrap(ptr)) {
+        const size_t available = (size_t)(Bootstrap.data +
+            sizeof(Bootstrap.data) - (const char *)ptr);
+
+        newptr = Real_malloc(size);
+        if (newptr != NULL)
+            memcpy(newptr, ptr, size < available ? size : available);
+        record(newptr, size, __builtin_return_address(0));
+        return newptr;
+    }
+
+    if (ptr != NULL) {
+        const size_t old = usable_size(ptr, 0);
+
+        newptr = Real_realloc(ptr, size);
+        if (newptr != NULL || size == 0)
+            atf_alloc_record_free(old);
+    } else
+        newptr = Real_realloc(ptr, size);
+    record(newptr, size, __builtin_return_address(0));
+    return newptr;
+}
+
+void
+free(void *ptr)
+{
+    if (ptr == NULL || is_bootstrap(ptr))
+        return;
+
+    if (Real_free == NULL)
+        resolve();
+
+    record_free(ptr);
+    Real_free(ptr);
+}
+
+int
+posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int ret;
+
+    if (Real_posix_memalign == NULL) {
+        if (Real_malloc == NULL)
+            resolve();
+        if (Real_posix_memalign == NULL)
+            return ENOSYS;
+    }
+
+    ret = Real_posix_memalign(memptr, alignment, size);
+    if (ret == 0)
+        record(*memptr, size, __builtin_return_address(0));
+    return ret;
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if (Real_aligned_alloc == NULL) {
+        if (Real_malloc == NULL)
+            resolve();
+        if (Real_aligned_alloc == NULL) {
+            errno = ENOSYS;
+            return NULL;
+        }
+    }
+
+    ptr = Real_aligned_alloc(alignment, size);
+    record(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
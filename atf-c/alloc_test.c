@@ -0,0 +1,214 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/alloc.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* Keeps the compiler from optimizing away the allocations below. */
+static void *volatile sink;
+
+static void
+allocate(const size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        sink = malloc(64);
+        free(sink);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the allocator hooks.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(hooks);
+ATF_TC_BODY(hooks, tc)
+{
+    atf_alloc_stats_t before, after;
+
+    ATF_REQUIRE(atf_alloc_available());
+
+    atf_alloc_get_stats(&before);
+    allocate(10);
+    sink = calloc(4, 16);
+    sink = realloc(sink, 128);
+    free(sink);
+    atf_alloc_get_stats(&after);
+
+    ATF_CHECK(after.m_count - before.m_count >= 12);
+    ATF_CHECK(after.m_bytes - before.m_bytes >= 10 * 64 + 64 + 128);
+    ATF_CHECK_EQ(before.m_live, after.m_live);
+}
+
+ATF_TC_WITHOUT_HEAD(profile_sites);
+ATF_TC_BODY(profile_sites, tc)
+{
+    atf_dynstr_t sites;
+
+    atf_alloc_profile_start();
+    allocate(5);
+    atf_alloc_profile_stop();
+    ATF_CHECK(atf_alloc_profile_peak() >= 64);
+
+    RE(atf_alloc_format_sites(&sites, 3));
+    printf("Sites: %s\n", atf_dynstr_cstring(&sites));
+    ATF_CHECK(atf_utils_grep_string("5 allocations, [0-9]+ bytes",
+                                    atf_dynstr_cstring(&sites)));
+    atf_dynstr_fini(&sites);
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the ATF_CHECK_MAX_ALLOCS and ATF_REQUIRE_MAX_ALLOCS macros.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(max_allocs_pass);
+ATF_TC_BODY(max_allocs_pass, tc)
+{
+    ATF_REQUIRE_MAX_ALLOCS(0, (void)strlen("no allocations"));
+    ATF_REQUIRE_MAX_ALLOCS(3, allocate(3));
+    ATF_CHECK_MAX_ALLOCS(3, allocate(2));
+}
+
+ATF_TC(h_max_allocs);
+ATF_TC_HEAD(h_max_allocs, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+}
+ATF_TC_BODY(h_max_allocs, tc)
+{
+    ATF_CHECK_MAX_ALLOCS(1, allocate(2));
+    ATF_REQUIRE_MAX_ALLOCS(2, allocate(4));
+    atf_utils_create_file("after", "%s", "");
+}
+
+ATF_TC(max_allocs_fail);
+ATF_TC_HEAD(max_allocs_fail, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that exceeding an allocation "
+                      "budget fails the test case");
+}
+ATF_TC_BODY(max_allocs_fail, tc)
+{
+    atf_tc_t *h = &ATF_TC_NAME(h_max_allocs);
+
+    RE(atf_tc_init_pack(h, &ATF_TC_PACK_NAME(h_max_allocs), NULL));
+    run_h_tc(h, "output", "error", "result");
+    atf_tc_fini(h);
+
+    ATF_CHECK(atf_utils_grep_file("alloc_test.c:[0-9]+: 2 allocations "
+        "\\([0-9]+ bytes\\) exceed the budget of 1", "error"));
+    ATF_CHECK(atf_utils_grep_file("^failed: .*alloc_test.c:[0-9]+: 4 "
+        "allocations \\([0-9]+ bytes\\) exceed the budget of 2", "result"));
+    ATF_CHECK(!atf_utils_file_exists("after"));
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the profile.alloc configuration variable.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(h_profile);
+ATF_TC_HEAD(h_profile, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+}
+ATF_TC_BODY(h_profile, tc)
+{
+    allocate(7);
+}
+
+ATF_TC(profile);
+ATF_TC_HEAD(profile, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that profile.alloc reports the "
+                      "allocations of the test case body");
+}
+ATF_TC_BODY(profile, tc)
+{
+    atf_tc_t *h = &ATF_TC_NAME(h_profile);
+    const char *const config[] = { "profile.alloc", "true", NULL };
+
+    RE(atf_tc_init_pack(h, &ATF_TC_PACK_NAME(h_profile), config));
+    run_h_tc(h, "output", "error", "result");
+    atf_tc_fini(h);
+
+    ATF_CHECK(atf_utils_grep_file("^passed$", "result"));
+    ATF_CHECK(atf_utils_grep_file("^alloc: [0-9]+ allocations, [0-9]+ "
+        "bytes, peak [0-9]+ bytes live; top sites: .*7 allocations",
+        "output"));
+}
+
+ATF_TC(h_profile_invalid);
+ATF_TC_HEAD(h_profile_invalid, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+    atf_tc_set_md_var(tc, "X-profile.alloc", "maybe");
+}
+ATF_TC_BODY(h_profile_invalid, tc)
+{
+}
+
+ATF_TC(profile_invalid);
+ATF_TC_HEAD(profile_invalid, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that an invalid profile.alloc "
+                      "value fails the test case");
+}
+ATF_TC_BODY(profile_invalid, tc)
+{
+    atf_tc_t *h = &ATF_TC_NAME(h_profile_invalid);
+
+    RE(atf_tc_init_pack(h, &ATF_TC_PACK_NAME(h_profile_invalid), NULL));
+    run_h_tc(h, "output", "error", "result");
+    atf_tc_fini(h);
+
+    ATF_CHECK(atf_utils_grep_file("^failed: Invalid value 'maybe' for "
+        "profile.alloc", "result"));
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, hooks);
+    ATF_TP_ADD_TC(tp, profile_sites);
+
+    ATF_TP_ADD_TC(tp, max_allocs_pass);
+    ATF_TP_ADD_TC(tp, max_allocs_fail);
+
+    ATF_TP_ADD_TC(tp, profile);
+    ATF_TP_ADD_TC(tp, profile_invalid);
+
+    return atf_no_error();
+}
@@ -0,0 +1,85 @@
+#! __ATF_SHELL__
+# Copyright (c) 2014 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Stores the listing of a test program, as printed by -l, in the
+# .atf_list section of its executable so that listing it later does not
+# need to run the heads of its test cases.  See atf-embed-list(1).
+
+Prog_Name=${0##*/}
+Section=.atf_list
+
+usage_error() {
+    echo "${Prog_Name}: ERROR: ${*}" 1>&2
+    echo "Usage: ${Prog_Name} [-l lister] program" 1>&2
+    exit 1
+}
+
+err() {
+    echo "${Prog_Name}: ERROR: ${*}" 1>&2
+    exit 1
+}
+
+lister=
+while getopts ':l:' arg; do
+    case "${arg}" in
+        l)
+            lister="${OPTARG}"
+            ;;
+        :)
+            usage_error "Option -${OPTARG} requires an argument"
+            ;;
+        \?)
+            usage_error "Unknown option -${OPTARG}"
+            ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ ${#} -eq 1 ] || usage_error "Must provide a single test program"
+program="${1}"
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/atf-embed-list.XXXXXX") || exit 1
+trap 'rm -rf "${work}"' EXIT
+
+objcopy="${OBJCOPY:-__OBJCOPY__}"
+
+# A program that already has a listing would print it instead of its
+# current test cases, so list a copy of it without the section.
+if [ -z "${lister}" ]; then
+    lister="${work}/${program##*/}"
+    "${objcopy}" --remove-section="${Section}" "${program}" "${lister}" \
+        || err "Failed to copy ${program}"
+fi
+
+"${lister}" -l >"${work}/listing" || err "Failed to list ${lister}"
+head -n 1 "${work}/listing" | grep '^Content-Type: application/X-atf-tp;' \
+    >/dev/null || err "${lister} is not an atf test program"
+
+"${objcopy}" --remove-section="${Section}" \
+    --add-section "${Section}=${work}/listing" \
+    --set-section-flags "${Section}=readonly" "${program}" \
+    || err "Failed to store the listing in ${program}"
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
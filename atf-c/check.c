@@ -25,10 +25,17 @@
 
 #include "atf-c/check.h"
 
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
 #include <sys/wait.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +50,7 @@
 #include "atf-c/detail/list.h"
 #include "atf-c/detail/process.h"
 #include "atf-c/detail/sanity.h"
+#include "atf-c/detail/trace.h"
 #include "atf-c/error.h"
 #include "atf-c/utils.h"
 
@@ -74,33 +82,10 @@ out:
 
 static
 void
-cleanup_tmpdir(const atf_fs_path_t *dir, const atf_fs_path_t *outfile,
-               const atf_fs_path_t *errfile)
+cleanup_tmpdir(const atf_fs_path_t *dir)
 {
-    {
-        atf_error_t err = atf_fs_unlink(outfile);
-        if (atf_is_error(err)) {
-            INV(atf_error_is(err, "libc") &&
-                atf_libc_error_code(err) == ENOENT);
-            atf_error_free(err);
-        } else
-            INV(!atf_is_error(err));
-    }
-
-    {
-        atf_error_t err = atf_fs_unlink(errfile);
-        if (atf_is_error(err)) {
-            INV(atf_error_is(err, "libc") &&
-                atf_libc_error_code(err) == ENOENT);
-            atf_error_free(err);
-        } else
-            INV(!atf_is_error(err));
-    }
-
-    {
-        atf_error_t err = atf_fs_rmdir(dir);
-        INV(!atf_is_error(err));
-    }
+    atf_error_t err = atf_fs_rmtree(dir);
+    INV(!atf_is_error(err));
 }
 
 static
@@ -159,6 +144,7 @@ exec_child(void *v)
 {
     struct exec_data *ea = v;
 
+    atf_trace_instant("exec", ea->m_argv[0]);
     const_execvp(ea->m_argv[0], ea->m_argv);
     fprintf(stderr, "execvp(%s) failed: %s\n", ea->m_argv[0], strerror(errno));
     exit(127);
@@ -334,13 +320,11 @@ out:
     return err;
 }
 
+static
 void
-atf_check_result_fini(atf_check_result_t *r)
+release_result(atf_check_result_t *r)
 {
-    atf_process_status_fini(&r->pimpl->m_status);
-
-    cleanup_tmpdir(&r->pimpl->m_dir, &r->pimpl->m_stdout,
-                   &r->pimpl->m_stderr);
+    cleanup_tmpdir(&r->pimpl->m_dir);
     atf_fs_path_fini(&r->pimpl->m_stdout);
     atf_fs_path_fini(&r->pimpl->m_stderr);
     atf_fs_path_fini(&r->pimpl->m_dir);
@@ -350,6 +334,13 @@ atf_check_result_fini(atf_check_result_t *r)
     free(r->pimpl);
 }
 
+void
+atf_check_result_fini(atf_check_result_t *r)
+{
+    atf_process_status_fini(&r->pimpl->m_status);
+    release_result(r);
+}
+
 const char *
 atf_check_result_stdout(const atf_check_result_t *r)
 {
@@ -453,11 +444,15 @@ out:
     return err;
 }
 
+static
 atf_error_t
-atf_check_exec_array(const char *const *argv, atf_check_result_t *r)
+start_exec(const char *const *argv, atf_check_result_t *r,
+           atf_process_child_t *child)
 {
     atf_error_t err;
     atf_fs_path_t dir;
+    atf_process_stream_t outsb, errsb;
+    struct exec_data ea = { argv };
 
     err = create_tmpdir(&dir);
     if (atf_is_error(err))
@@ -467,19 +462,231 @@ atf_check_exec_array(const char *const *argv, atf_check_result_t *r)
     if (atf_is_error(err)) {
         atf_error_t err2 = atf_fs_rmdir(&dir);
         INV(!atf_is_error(err2));
-        goto out;
+        goto out_dir;
     }
 
-    err = fork_and_wait(argv, &r->pimpl->m_stdout, &r->pimpl->m_stderr,
-                        &r->pimpl->m_status);
+    err = init_sbs(&r->pimpl->m_stdout, &outsb, &r->pimpl->m_stderr, &errsb);
     if (atf_is_error(err)) {
-        atf_check_result_fini(r);
-        goto out;
+        release_result(r);
+        goto out_dir;
     }
 
-    INV(!atf_is_error(err));
+    err = atf_process_fork(child, exec_child, &outsb, &errsb, &ea);
+    if (atf_is_error(err))
+        release_result(r);
 
+    atf_process_stream_fini(&errsb);
+    atf_process_stream_fini(&outsb);
+out_dir:
     atf_fs_path_fini(&dir);
 out:
     return err;
 }
+
+struct batch_job {
+    atf_process_child_t m_child;
+    size_t m_index;
+};
+
+/* Looks for a job of the batch that has terminated, without reaping it so
+ * that atf_process_child_wait can collect its status later on. */
+static
+atf_error_t
+find_finished_job(const struct batch_job *jobs, const size_t njobs,
+                  size_t *index, bool *found)
+{
+    size_t i;
+
+    *found = false;
+    for (i = 0; i < njobs && !*found; i++) {
+        const pid_t pid = atf_process_child_pid(&jobs[i].m_child);
+        siginfo_t info;
+
+        info.si_pid = 0;
+        if (waitid(P_PID, (id_t)pid, &info,
+                   WEXITED | WNOHANG | WNOWAIT) == -1)
+            return atf_libc_error(errno, "Failed to wait for child %d",
+                                  (int)pid);
+        if (info.si_pid != 0) {
+            *index = i;
+            *found = true;
+        }
+    }
+    return atf_no_error();
+}
+
+/* Waits until any of the given jobs terminates and returns its position.
+ *
+ * Only the children of the batch are waited for: other children of the
+ * caller belong to someone else.  SIGCHLD is blocked while waiting so that
+ * the termination of a child wakes us up without a window in which it
+ * could be missed; the signal is raised again on the way out if the
+ * caller has a handler for it, as it may have been meant for the caller.
+ * Without sigtimedwait(2), the children are polled for instead. */
+static
+atf_error_t
+wait_any_job(const struct batch_job *jobs, const size_t njobs, size_t *index)
+{
+    atf_error_t err;
+    bool found;
+#if defined(HAVE_SIGTIMEDWAIT)
+    struct sigaction sa;
+    sigset_t chld, old;
+    bool consumed = false;
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &chld, &old);
+#endif
+
+    for (;;) {
+        err = find_finished_job(jobs, njobs, index, &found);
+        if (atf_is_error(err) || found)
+            break;
+
+#if defined(HAVE_SIGTIMEDWAIT)
+        {
+            /* The timeout only guards against a SIGCHLD consumed by
+             * another thread of the caller. */
+            const struct timespec timeout = { 0, 100000000 };
+
+            if (sigtimedwait(&chld, NULL, &timeout) == SIGCHLD)
+                consumed = true;
+        }
+#else
+        usleep(10000);
+#endif
+    }
+
+#if defined(HAVE_SIGTIMEDWAIT)
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (consumed && !sigismember(&old, SIGCHLD) &&
+        sigaction(SIGCHLD, NULL, &sa) != -1 &&
+        sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN)
+        raise(SIGCHLD);
+#endif
+
+    return err;
+}
+
+atf_error_t
+atf_check_exec_array(const char *const *argv, atf_check_result_t *r)
+{
+    atf_error_t err;
+    atf_process_child_t child;
+
+    atf_trace_begin_argv("check", argv);
+    err = start_exec(argv, r, &child);
+    if (atf_is_error(err))
+        goto out;
+
+    err = atf_process_child_wait(&child, &r->pimpl->m_status);
+    if (atf_is_error(err))
+        release_result(r);
+
+out:
+    atf_trace_end("check");
+    return err;
+}
+
+atf_error_t
+atf_check_exec_arrays(const char *const *const *argvs, const size_t ncmds,
+                      const size_t max_jobs, atf_check_result_t *results,
+                      atf_check_done_func_t done, void *data)
+{
+    atf_error_t err;
+    struct batch_job *jobs;
+    bool *finished;
+    size_t njobs, running, next, i = 0;
+
+    njobs = max_jobs;
+    if (njobs == 0) {
+        const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        njobs = ncpus > 0 ? (size_t)ncpus : 1;
+    }
+    if (njobs > ncmds)
+        njobs = ncmds;
+    if (njobs == 0)
+        return atf_no_error();
+
+    jobs = malloc(njobs * sizeof(*jobs));
+    finished = calloc(ncmds, sizeof(*finished));
+    if (jobs == NULL || finished == NULL) {
+        err = atf_no_memory_error();
+        goto out;
+    }
+
+    atf_trace_begin("batch", NULL);
+    err = atf_no_error();
+    running = 0;
+    next = 0;
+    while (running < njobs) {
+        err = start_exec(argvs[next], &results[next], &jobs[running].m_child);
+        if (atf_is_error(err))
+            break;
+        jobs[running].m_index = next++;
+        running++;
+    }
+
+    while (running > 0 && !atf_is_error(err)) {
+        struct batch_job *job;
+        atf_check_result_t *r;
+
+        err = wait_any_job(jobs, running, &i);
+        if (atf_is_error(err))
+            break;
+        job = &jobs[i];
+        r = &results[job->m_index];
+
+        err = atf_process_child_wait(&job->m_child, &r->pimpl->m_status);
+        if (atf_is_error(err)) {
+            release_result(r);
+            jobs[i] = jobs[--running];
+            break;
+        }
+        /* Results handed to the hook belong to the caller from then on,
+         * even if the batch fails later. */
+        if (done != NULL)
+            err = done(job->m_index, r, data);
+        else
+            finished[job->m_index] = true;
+
+        if (!atf_is_error(err) && next < ncmds) {
+            err = start_exec(argvs[next], &results[next], &job->m_child);
+            if (!atf_is_error(err)) {
+                job->m_index = next++;
+                continue;
+            }
+        }
+        jobs[i] = jobs[--running];
+    }
+
+    if (atf_is_error(err)) {
+        /* Do not leave any children behind nor any results for the
+         * caller to release. */
+        for (i = 0; i < running; i++) {
+            atf_check_result_t *r = &results[jobs[i].m_index];
+
+            atf_error_t err2;
+
+            kill(atf_process_child_pid(&jobs[i].m_child), SIGKILL);
+            err2 = atf_process_child_wait(&jobs[i].m_child,
+                                          &r->pimpl->m_status);
+            if (atf_is_error(err2)) {
+                atf_error_free(err2);
+                release_result(r);
+            } else
+                atf_check_result_fini(r);
+        }
+        for (i = 0; i < next; i++) {
+            if (finished[i])
+                atf_check_result_fini(&results[i]);
+        }
+    }
+    atf_trace_end("batch");
+
+out:
+    free(finished);
+    free(jobs);
+    return err;
+}
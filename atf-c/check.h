@@ -27,6 +27,7 @@
 #define ATF_C_CHECK_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include <atf-c/error_fwd.h>
 
@@ -66,4 +67,11 @@ atf_error_t atf_check_build_cxx_o(const char *, const char *,
                                   bool *);
 atf_error_t atf_check_exec_array(const char *const *, atf_check_result_t *);
 
+typedef atf_error_t (*atf_check_done_func_t)(const size_t,
+                                             const atf_check_result_t *,
+                                             void *);
+atf_error_t atf_check_exec_arrays(const char *const *const *, const size_t,
+                                  const size_t, atf_check_result_t *,
+                                  atf_check_done_func_t, void *);
+
 #endif /* !defined(ATF_C_CHECK_H) */
@@ -25,6 +25,9 @@
 
 #include "atf-c/check.h"
 
+#include <sys/wait.h>
+
+#include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
@@ -327,6 +330,179 @@ ATF_TC_BODY(exec_array, tc)
     atf_fs_path_fini(&process_helpers);
 }
 
+struct arrays_data {
+    size_t m_calls;
+    bool m_seen[5];
+    bool m_fail;
+};
+
+static
+atf_error_t
+arrays_done(const size_t index, const atf_check_result_t *r, void *v)
+{
+    struct arrays_data *data = v;
+
+    ATF_REQUIRE(index < 5);
+    ATF_CHECK(!data->m_seen[index]);
+    ATF_CHECK(atf_check_result_exited(r) || atf_check_result_signaled(r));
+    data->m_seen[index] = true;
+    data->m_calls++;
+
+    if (data->m_fail)
+        return atf_libc_error(ECANCELED, "Aborting batch");
+    return atf_no_error();
+}
+
+ATF_TC(exec_arrays);
+ATF_TC_HEAD(exec_arrays, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that atf_check_exec_arrays "
+                      "runs a batch of commands and reports every result");
+}
+ATF_TC_BODY(exec_arrays, tc)
+{
+    atf_fs_path_t process_helpers;
+    atf_check_result_t results[5];
+    struct arrays_data data;
+    size_t i;
+
+    get_process_helpers_path(tc, false, &process_helpers);
+    const char *helpers = atf_fs_path_cstring(&process_helpers);
+
+    const char *argv0[] = { helpers, "echo", "first", NULL };
+    const char *argv1[] = { helpers, "exit-failure", NULL };
+    const char *argv2[] = { helpers, "echo", "third", NULL };
+    const char *argv3[] = { helpers, "exit-signal", NULL };
+    const char *argv4[] = { helpers, "exit-success", NULL };
+    const char *const *argvs[] = { argv0, argv1, argv2, argv3, argv4 };
+
+    memset(&data, 0, sizeof(data));
+    RE(atf_check_exec_arrays(argvs, 5, 2, results, arrays_done, &data));
+    ATF_REQUIRE_EQ(5, data.m_calls);
+    for (i = 0; i < 5; i++)
+        ATF_CHECK(data.m_seen[i]);
+
+    ATF_CHECK(atf_check_result_exited(&results[0]));
+    ATF_CHECK_EQ(EXIT_SUCCESS, atf_check_result_exitcode(&results[0]));
+    ATF_CHECK(atf_utils_grep_file("^first$",
+                                  atf_check_result_stdout(&results[0])));
+    ATF_CHECK(atf_check_result_exited(&results[1]));
+    ATF_CHECK_EQ(EXIT_FAILURE, atf_check_result_exitcode(&results[1]));
+    ATF_CHECK(atf_utils_grep_file("^third$",
+                                  atf_check_result_stdout(&results[2])));
+    ATF_CHECK(atf_check_result_signaled(&results[3]));
+    ATF_CHECK_EQ(SIGKILL, atf_check_result_termsig(&results[3]));
+    ATF_CHECK(atf_check_result_exited(&results[4]));
+    ATF_CHECK_EQ(EXIT_SUCCESS, atf_check_result_exitcode(&results[4]));
+
+    for (i = 0; i < 5; i++)
+        atf_check_result_fini(&results[i]);
+    atf_fs_path_fini(&process_helpers);
+}
+
+ATF_TC(exec_arrays_abort);
+ATF_TC_HEAD(exec_arrays_abort, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that an error returned by the "
+                      "completion hook of atf_check_exec_arrays kills the "
+                      "commands still running");
+    atf_tc_set_md_var(tc, "timeout", "30");
+}
+ATF_TC_BODY(exec_arrays_abort, tc)
+{
+    atf_fs_path_t process_helpers;
+    atf_check_result_t results[3];
+    struct arrays_data data;
+    atf_error_t err;
+
+    get_process_helpers_path(tc, false, &process_helpers);
+    const char *helpers = atf_fs_path_cstring(&process_helpers);
+
+    const char *argv0[] = { helpers, "exit-success", NULL };
+    const char *argv1[] = { helpers, "hang", NULL };
+    const char *argv2[] = { helpers, "hang", NULL };
+    const char *const *argvs[] = { argv0, argv1, argv2 };
+
+    memset(&data, 0, sizeof(data));
+    data.m_fail = true;
+    err = atf_check_exec_arrays(argvs, 3, 2, results, arrays_done, &data);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+
+    ATF_CHECK_EQ(1, data.m_calls);
+    ATF_CHECK(data.m_seen[0]);
+    atf_check_result_fini(&results[0]);
+
+    atf_fs_path_fini(&process_helpers);
+}
+
+static volatile sig_atomic_t sigchld_received;
+
+static
+void
+sigchld_handler(const int signo)
+{
+    (void)signo;
+    sigchld_received = 1;
+}
+
+ATF_TC(exec_arrays_foreign_child);
+ATF_TC_HEAD(exec_arrays_foreign_child, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks that atf_check_exec_arrays "
+                      "leaves the other children of the caller and their "
+                      "SIGCHLD alone");
+    atf_tc_set_md_var(tc, "timeout", "30");
+}
+ATF_TC_BODY(exec_arrays_foreign_child, tc)
+{
+    atf_fs_path_t process_helpers;
+    atf_check_result_t results[3];
+    struct arrays_data data;
+    struct sigaction sa;
+    pid_t pid;
+    int status;
+    size_t i;
+
+    get_process_helpers_path(tc, false, &process_helpers);
+    const char *helpers = atf_fs_path_cstring(&process_helpers);
+
+    const char *argv0[] = { helpers, "echo", "first", NULL };
+    const char *argv1[] = { helpers, "exit-success", NULL };
+    const char *argv2[] = { helpers, "echo", "third", NULL };
+    const char *const *argvs[] = { argv0, argv1, argv2 };
+
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    ATF_REQUIRE(sigaction(SIGCHLD, &sa, NULL) != -1);
+
+    /* Left as a zombie while the batch runs. */
+    pid = fork();
+    ATF_REQUIRE(pid != -1);
+    if (pid == 0)
+        _exit(123);
+    {
+        siginfo_t info;
+        ATF_REQUIRE(waitid(P_PID, (id_t)pid, &info, WEXITED | WNOWAIT) != -1);
+    }
+    sigchld_received = 0;
+
+    memset(&data, 0, sizeof(data));
+    RE(atf_check_exec_arrays(argvs, 3, 1, results, arrays_done, &data));
+    ATF_REQUIRE_EQ(3, data.m_calls);
+    ATF_CHECK(sigchld_received);
+
+    ATF_REQUIRE_EQ(pid, waitpid(pid, &status, 0));
+    ATF_REQUIRE(WIFEXITED(status));
+    ATF_CHECK_EQ(123, WEXITSTATUS(status));
+
+    for (i = 0; i < 3; i++)
+        atf_check_result_fini(&results[i]);
+    atf_fs_path_fini(&process_helpers);
+}
+
 ATF_TC(exec_cleanup);
 ATF_TC_HEAD(exec_cleanup, tc)
 {
@@ -511,6 +687,9 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, build_cpp);
     ATF_TP_ADD_TC(tp, build_cxx_o);
     ATF_TP_ADD_TC(tp, exec_array);
+    ATF_TP_ADD_TC(tp, exec_arrays);
+    ATF_TP_ADD_TC(tp, exec_arrays_abort);
+    ATF_TP_ADD_TC(tp, exec_arrays_foreign_child);
     ATF_TP_ADD_TC(tp, exec_cleanup);
     ATF_TP_ADD_TC(tp, exec_exitstatus);
     ATF_TP_ADD_TC(tp, exec_stdout_stderr);
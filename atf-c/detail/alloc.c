@@ -0,0 +1,253 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+/* dladdr(3) is a GNU extension in glibc. */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "atf-c/detail/alloc.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#endif
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+/* The callers that allocated memory while profiling, keyed by return
+ * address in an open-addressed table that is filled with compare-and-swap
+ * so that concurrent allocations never block each other. */
+struct site {
+    _Atomic(uintptr_t) caller;
+    atomic_ullong count;
+    atomic_ullong bytes;
+};
+
+#define SITES_SIZE 1024
+#define MAX_TOP_SITES 16
+
+static atomic_bool Installed = false;
+static atomic_bool Profiling = false;
+
+static atomic_ullong Count = 0;
+static atomic_ullong Bytes = 0;
+static atomic_llong Live = 0;
+static atomic_llong Peak = 0;
+static long long Profile_live = 0;
+
+static struct site Sites[SITES_SIZE];
+
+static void
+record_site(const void *caller, const size_t size)
+{
+    const uintptr_t key = (uintptr_t)caller;
+    const size_t h = (size_t)(key >> 4) * 2654435761u;
+    size_t i;
+
+    if (key == 0)
+        return;
+
+    for (i = 0; i < SITES_SIZE; i++) {
+        struct site *site = &Sites[(h + i) % SITES_SIZE];
+        uintptr_t current = atomic_load(&site->caller);
+
+        if (current == 0 &&
+            atomic_compare_exchange_strong(&site->caller, &current, key))
+            current = key;
+        if (current == key) {
+            atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&site->bytes, size,
+                                      memory_order_relaxed);
+            return;
+        }
+    }
+    /* The table is full; the allocation is still counted in the totals. */
+}
+
+static atf_error_t
+format_site(atf_dynstr_t *out, const struct site *site)
+{
+    const uintptr_t caller = atomic_load(&site->caller);
+    const unsigned long long count = atomic_load(&site->count);
+    const unsigned long long bytes = atomic_load(&site->bytes);
+
+#if defined(HAVE_DLADDR)
+    Dl_info info;
+
+    if (dladdr((const void *)caller, &info) != 0 && info.dli_sname != NULL)
+        return atf_dynstr_append_fmt(out, "%s+0x%lx: %llu allocations, %llu "
+            "bytes", info.dli_sname,
+            (unsigned long)(caller - (uintptr_t)info.dli_saddr), count,
+            bytes);
+#endif
+    return atf_dynstr_append_fmt(out, "0x%lx: %llu allocations, %llu bytes",
+                                 (unsigned long)caller, count, bytes);
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/** Tells the library that the allocator hooks are in place. */
+void
+atf_alloc_install(void)
+{
+    atomic_store(&Installed, true);
+}
+
+/** Accounts for a new block.
+ *
+ * \param caller The return address of the allocation function.
+ * \param size The size requested by the caller.
+ * \param usable The size actually reserved by the allocator, which is
+ *     what a later atf_alloc_record_free will receive.
+ */
+void
+atf_alloc_record(const void *caller, const size_t size, const size_t usable)
+{
+    long long live, peak;
+
+    atomic_fetch_add_explicit(&Count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&Bytes, size, memory_order_relaxed);
+
+    live = atomic_fetch_add(&Live, (long long)usable) + (long long)usable;
+    peak = atomic_load(&Peak);
+    while (live > peak && !atomic_compare_exchange_weak(&Peak, &peak, live))
+        continue;
+
+    if (atomic_load_explicit(&Profiling, memory_order_relaxed))
+        record_site(caller, size);
+}
+
+void
+atf_alloc_record_free(const size_t usable)
+{
+    atomic_fetch_sub(&Live, (long long)usable);
+}
+
+bool
+atf_alloc_available(void)
+{
+    return atomic_load(&Installed);
+}
+
+/** Gets the totals since the program started. */
+void
+atf_alloc_get_stats(atf_alloc_stats_t *stats)
+{
+    stats->m_count = atomic_load(&Count);
+    stats->m_bytes = atomic_load(&Bytes);
+    stats->m_live = atomic_load(&Live);
+}
+
+/** Starts recording call sites and the peak of live memory.
+ *
+ * This must be called before spawning the threads to be profiled.
+ */
+void
+atf_alloc_profile_start(void)
+{
+    size_t i;
+
+    for (i = 0; i < SITES_SIZE; i++) {
+        atomic_store(&Sites[i].caller, 0);
+        atomic_store(&Sites[i].count, 0);
+        atomic_store(&Sites[i].bytes, 0);
+    }
+    Profile_live = atomic_load(&Live);
+    atomic_store(&Peak, Profile_live);
+    atomic_store(&Profiling, true);
+}
+
+void
+atf_alloc_profile_stop(void)
+{
+    atomic_store(&Profiling, false);
+}
+
+/** Gets the peak of live memory since profiling started, in bytes. */
+long long
+atf_alloc_profile_peak(void)
+{
+    return atomic_load(&Peak) - Profile_live;
+}
+
+/** Formats the call sites that allocated most often, most frequent first.
+ *
+ * Profiling must be stopped so that formatting does not count itself.
+ */
+atf_error_t
+atf_alloc_format_sites(atf_dynstr_t *out, const size_t max)
+{
+    const struct site *top[MAX_TOP_SITES];
+    size_t ntop, i, j;
+    atf_error_t err;
+
+    ntop = 0;
+    for (i = 0; i < SITES_SIZE; i++) {
+        const struct site *site = &Sites[i];
+        const unsigned long long count = atomic_load(&site->count);
+
+        if (atomic_load(&site->caller) == 0 || count == 0)
+            continue;
+
+        /* Insertion into the sorted array of the best sites so far. */
+        for (j = ntop; j > 0 && atomic_load(&top[j - 1]->count) < count; j--)
+            if (j < max && j < MAX_TOP_SITES)
+                top[j] = top[j - 1];
+        if (j < max && j < MAX_TOP_SITES) {
+            top[j] = site;
+            if (ntop < max && ntop < MAX_TOP_SITES)
+                ntop++;
+        }
+    }
+
+    err = atf_dynstr_init(out);
+    if (atf_is_error(err))
+        return err;
+
+    for (i = 0; i < ntop && !atf_is_error(err); i++) {
+        if (i > 0)
+            err = atf_dynstr_append_fmt(out, "; ");
+        if (!atf_is_error(err))
+            err = format_site(out, top[i]);
+    }
+    if (!atf_is_error(err) && ntop == 0)
+        err = atf_dynstr_append_fmt(out, "none");
+    if (atf_is_error(err))
+        atf_dynstr_fini(out);
+    return err;
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_ALLOC_H)
+#define ATF_C_DETAIL_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <atf-c/detail/dynstr.h>
+#include <atf-c/error_fwd.h>
+
+/* Accounting of the allocations made by the test program.  The numbers
+ * are fed by the allocator hooks in libatf-c-alloc, which test programs
+ * must be linked against for any of this to be available; these functions
+ * never allocate memory themselves so that the hooks can call them. */
+
+struct atf_alloc_stats {
+    unsigned long long m_count;
+    unsigned long long m_bytes;
+    long long m_live;
+};
+typedef struct atf_alloc_stats atf_alloc_stats_t;
+
+/* Interface for the hooks. */
+void atf_alloc_install(void);
+void atf_alloc_record(const void *, const size_t, const size_t);
+void atf_alloc_record_free(const size_t);
+
+/* Interface for the test case runner. */
+bool atf_alloc_available(void);
+void atf_alloc_get_stats(atf_alloc_stats_t *);
+void atf_alloc_profile_start(void);
+void atf_alloc_profile_stop(void);
+long long atf_alloc_profile_peak(void);
+atf_error_t atf_alloc_format_sites(atf_dynstr_t *, const size_t);
+
+#endif /* !defined(ATF_C_DETAIL_ALLOC_H) */
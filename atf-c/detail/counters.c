@@ -0,0 +1,361 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/counters.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+enum fallback {
+    FALLBACK_NONE,
+    FALLBACK_CPU_NS,
+    FALLBACK_FAULTS,
+    FALLBACK_SWITCHES,
+};
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#   define EVENT(type, config) PERF_TYPE_ ## type, PERF_COUNT_ ## config
+#else
+#   define EVENT(type, config) 0, 0
+#endif
+
+struct atf_counter_desc {
+    const char *name;
+    const char *unit;
+    unsigned int type;
+    unsigned long long config;
+    enum fallback fallback;
+};
+
+static const struct atf_counter_desc descs[] = {
+    { "instructions", "", EVENT(HARDWARE, HW_INSTRUCTIONS),
+      FALLBACK_NONE },
+    { "cycles", "", EVENT(HARDWARE, HW_CPU_CYCLES),
+      FALLBACK_NONE },
+    { "cache-references", "", EVENT(HARDWARE, HW_CACHE_REFERENCES),
+      FALLBACK_NONE },
+    { "cache-misses", "", EVENT(HARDWARE, HW_CACHE_MISSES),
+      FALLBACK_NONE },
+    { "branches", "", EVENT(HARDWARE, HW_BRANCH_INSTRUCTIONS),
+      FALLBACK_NONE },
+    { "branch-misses", "", EVENT(HARDWARE, HW_BRANCH_MISSES),
+      FALLBACK_NONE },
+    { "task-clock", " ns", EVENT(SOFTWARE, SW_TASK_CLOCK),
+      FALLBACK_CPU_NS },
+    { "page-faults", "", EVENT(SOFTWARE, SW_PAGE_FAULTS),
+      FALLBACK_FAULTS },
+    { "context-switches", "", EVENT(SOFTWARE, SW_CONTEXT_SWITCHES),
+      FALLBACK_SWITCHES },
+    { "cpu-migrations", "", EVENT(SOFTWARE, SW_CPU_MIGRATIONS),
+      FALLBACK_NONE },
+    { NULL, NULL, 0, 0, FALLBACK_NONE },
+};
+
+#undef EVENT
+
+static const struct atf_counter_desc *
+find_desc(const char *name, const size_t length)
+{
+    const struct atf_counter_desc *desc;
+
+    for (desc = descs; desc->name != NULL; desc++) {
+        if (strlen(desc->name) == length &&
+            strncmp(desc->name, name, length) == 0)
+            return desc;
+    }
+    return NULL;
+}
+
+/** Reads a counter's equivalent from the resource usage of the process.
+ *
+ * Children are included so that the result matches the inherited kernel
+ * counters as long as the test case waits for its subprocesses. */
+static unsigned long long
+read_rusage(const enum fallback field)
+{
+    static const int whos[] = { RUSAGE_SELF, RUSAGE_CHILDREN };
+    unsigned long long value = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(whos) / sizeof(whos[0]); i++) {
+        struct rusage ru;
+
+        if (getrusage(whos[i], &ru) == -1)
+            continue;
+
+        switch (field) {
+        case FALLBACK_CPU_NS:
+            value += (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+                1000000000ULL;
+            value += (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+            break;
+
+        case FALLBACK_FAULTS:
+            value += ru.ru_minflt + ru.ru_majflt;
+            break;
+
+        case FALLBACK_SWITCHES:
+            value += ru.ru_nvcsw + ru.ru_nivcsw;
+            break;
+
+        default:
+            UNREACHABLE;
+        }
+    }
+    return value;
+}
+
+/** Opens the kernel counter for a description, disabled.
+ *
+ * \return The descriptor of the counter, or -1 if the kernel does not
+ * provide it or does not let us use it. */
+static int
+open_counter(const struct atf_counter_desc *desc)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = desc->type;
+    attr.config = desc->config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    /* Hosts with the default perf_event_paranoid setting only allow
+     * unprivileged users to count in user space. */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                   PERF_FLAG_FD_CLOEXEC);
+#else
+    (void)desc;
+    return -1;
+#endif
+}
+
+/** Reads the final value of a kernel counter and closes it.
+ *
+ * The value is scaled up if the counter was multiplexed with others.
+ *
+ * \return True if the counter ever ran. */
+static bool
+close_counter(struct atf_counter *counter)
+{
+    bool ok = false;
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+    uint64_t data[3];
+
+    ioctl(counter->m_fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counter->m_fd, data, sizeof(data)) == sizeof(data) &&
+        data[2] > 0) {
+        counter->m_value = data[2] == data[1] ? data[0] :
+            (unsigned long long)((double)data[0] * data[1] / data[2]);
+        ok = true;
+    }
+#endif
+
+    close(counter->m_fd);
+    counter->m_fd = -1;
+    return ok;
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_counters" type.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Constructors/destructors.
+ */
+
+/** Parses a comma-separated list of counter names. */
+atf_error_t
+atf_counters_init(atf_counters_t *counters, const char *spec)
+{
+    const char *name = spec;
+
+    counters->m_count = 0;
+    while (*name != '\0') {
+        const struct atf_counter_desc *desc;
+        const size_t length = strcspn(name, ",");
+        size_t i;
+
+        desc = find_desc(name, length);
+        if (desc == NULL)
+            return atf_libc_error(EINVAL, "Unknown counter '%.*s'",
+                                  (int)length, name);
+        for (i = 0; i < counters->m_count; i++) {
+            if (counters->m_counters[i].m_desc == desc)
+                return atf_libc_error(EINVAL, "Duplicate counter '%s'",
+                                      desc->name);
+        }
+
+        INV(counters->m_count < ATF_COUNTERS_MAX);
+        counters->m_counters[counters->m_count].m_desc = desc;
+        counters->m_counters[counters->m_count].m_source = ATF_COUNTER_NONE;
+        counters->m_counters[counters->m_count].m_fd = -1;
+        counters->m_counters[counters->m_count].m_value = 0;
+        counters->m_count++;
+
+        name += length;
+        if (*name == ',')
+            name++;
+    }
+    return atf_no_error();
+}
+
+void
+atf_counters_fini(atf_counters_t *counters)
+{
+    size_t i;
+
+    for (i = 0; i < counters->m_count; i++) {
+        if (counters->m_counters[i].m_fd != -1)
+            close(counters->m_counters[i].m_fd);
+    }
+}
+
+/*
+ * Modifiers.
+ */
+
+/** Starts all counters.
+ *
+ * The kernel counters are opened first and only enabled once all of them
+ * exist so that they cover the same span of code. */
+void
+atf_counters_start(atf_counters_t *counters)
+{
+    size_t i;
+
+    for (i = 0; i < counters->m_count; i++) {
+        struct atf_counter *counter = &counters->m_counters[i];
+
+        counter->m_fd = open_counter(counter->m_desc);
+        if (counter->m_fd != -1)
+            counter->m_source = ATF_COUNTER_PERF;
+        else if (counter->m_desc->fallback != FALLBACK_NONE) {
+            counter->m_source = ATF_COUNTER_RUSAGE;
+            counter->m_value = read_rusage(counter->m_desc->fallback);
+        } else
+            counter->m_source = ATF_COUNTER_NONE;
+    }
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+    for (i = 0; i < counters->m_count; i++) {
+        if (counters->m_counters[i].m_fd != -1) {
+            ioctl(counters->m_counters[i].m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->m_counters[i].m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void
+atf_counters_stop(atf_counters_t *counters)
+{
+    size_t i;
+
+    for (i = 0; i < counters->m_count; i++) {
+        struct atf_counter *counter = &counters->m_counters[i];
+
+        if (counter->m_source == ATF_COUNTER_PERF) {
+            if (!close_counter(counter))
+                counter->m_source = ATF_COUNTER_NONE;
+        } else if (counter->m_source == ATF_COUNTER_RUSAGE)
+            counter->m_value = read_rusage(counter->m_desc->fallback) -
+                counter->m_value;
+    }
+}
+
+/*
+ * Getters.
+ */
+
+/** Formats the values of stopped counters as a single line. */
+atf_error_t
+atf_counters_format(const atf_counters_t *counters, atf_dynstr_t *out)
+{
+    atf_error_t err;
+    size_t i;
+
+    err = atf_dynstr_init(out);
+    if (atf_is_error(err))
+        return err;
+
+    for (i = 0; !atf_is_error(err) && i < counters->m_count; i++) {
+        const struct atf_counter *counter = &counters->m_counters[i];
+        const char *sep = i == 0 ? "" : ", ";
+
+        switch (counter->m_source) {
+        case ATF_COUNTER_PERF:
+            err = atf_dynstr_append_fmt(out, "%s%s %llu%s", sep,
+                counter->m_desc->name, counter->m_value,
+                counter->m_desc->unit);
+            break;
+
+        case ATF_COUNTER_RUSAGE:
+            err = atf_dynstr_append_fmt(out, "%s%s %llu%s (rusage)", sep,
+                counter->m_desc->name, counter->m_value,
+                counter->m_desc->unit);
+            break;
+
+        default:
+            err = atf_dynstr_append_fmt(out, "%s%s unavailable", sep,
+                                        counter->m_desc->name);
+        }
+    }
+    if (atf_is_error(err))
+        atf_dynstr_fini(out);
+    return err;
+}
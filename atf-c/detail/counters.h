@@ -0,0 +1,74 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_COUNTERS_H)
+#define ATF_C_DETAIL_COUNTERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <atf-c/detail/dynstr.h>
+#include <atf-c/error_fwd.h>
+
+/* ---------------------------------------------------------------------
+ * The "atf_counters" type.
+ * --------------------------------------------------------------------- */
+
+enum atf_counter_source {
+    ATF_COUNTER_NONE,
+    ATF_COUNTER_PERF,
+    ATF_COUNTER_RUSAGE,
+};
+
+/* A single counter.  Those that the kernel does not expose are read from
+ * getrusage(2) where it has an equivalent and are reported as missing
+ * otherwise. */
+struct atf_counter {
+    const struct atf_counter_desc *m_desc;
+    enum atf_counter_source m_source;
+    int m_fd;
+    unsigned long long m_value;
+};
+
+#define ATF_COUNTERS_MAX 16
+
+struct atf_counters {
+    size_t m_count;
+    struct atf_counter m_counters[ATF_COUNTERS_MAX];
+};
+typedef struct atf_counters atf_counters_t;
+
+/* Constructors/destructors. */
+atf_error_t atf_counters_init(atf_counters_t *, const char *);
+void atf_counters_fini(atf_counters_t *);
+
+/* Modifiers. */
+void atf_counters_start(atf_counters_t *);
+void atf_counters_stop(atf_counters_t *);
+
+/* Getters. */
+atf_error_t atf_counters_format(const atf_counters_t *, atf_dynstr_t *);
+
+#endif /* !defined(ATF_C_DETAIL_COUNTERS_H) */
@@ -0,0 +1,123 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/counters.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Tests for the "atf_counters" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(init);
+ATF_TC_BODY(init, tc)
+{
+    atf_counters_t counters;
+
+    RE(atf_counters_init(&counters, ""));
+    ATF_REQUIRE_EQ(0, counters.m_count);
+    atf_counters_fini(&counters);
+
+    RE(atf_counters_init(&counters, "instructions,task-clock,page-faults"));
+    ATF_REQUIRE_EQ(3, counters.m_count);
+    ATF_REQUIRE_EQ(-1, counters.m_counters[0].m_fd);
+    atf_counters_fini(&counters);
+}
+
+ATF_TC_WITHOUT_HEAD(init_invalid);
+ATF_TC_BODY(init_invalid, tc)
+{
+    atf_counters_t counters;
+    atf_error_t err;
+
+    err = atf_counters_init(&counters, "cycles,bogus");
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+
+    err = atf_counters_init(&counters, "cycles,cycle");
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+
+    err = atf_counters_init(&counters, "cycles,cycles");
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+}
+
+ATF_TC_WITHOUT_HEAD(start_stop);
+ATF_TC_BODY(start_stop, tc)
+{
+    atf_counters_t counters;
+    atf_dynstr_t out;
+    char *block;
+    size_t i;
+
+    RE(atf_counters_init(&counters, "task-clock,page-faults,instructions"));
+    atf_counters_start(&counters);
+
+    /* Touch fresh memory and burn some CPU time. */
+    block = malloc(16 * 1024 * 1024);
+    ATF_REQUIRE(block != NULL);
+    for (i = 0; i < 200; i++)
+        memset(block, (int)i, 16 * 1024 * 1024);
+    free(block);
+
+    atf_counters_stop(&counters);
+
+    /* Both software counters have a getrusage(2) fallback so they are
+     * always there; instructions depend on the host. */
+    ATF_REQUIRE(counters.m_counters[0].m_source != ATF_COUNTER_NONE);
+    ATF_REQUIRE(counters.m_counters[0].m_value > 0);
+    ATF_REQUIRE(counters.m_counters[1].m_source != ATF_COUNTER_NONE);
+    ATF_REQUIRE(counters.m_counters[1].m_value > 0);
+
+    RE(atf_counters_format(&counters, &out));
+    printf("%s\n", atf_dynstr_cstring(&out));
+    ATF_REQUIRE(atf_utils_grep_string("^task-clock [0-9]+ ns( \\(rusage\\))?, "
+        "page-faults [0-9]+( \\(rusage\\))?, instructions "
+        "([0-9]+|unavailable)$", atf_dynstr_cstring(&out)));
+    atf_dynstr_fini(&out);
+    atf_counters_fini(&counters);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, init);
+    ATF_TP_ADD_TC(tp, init_invalid);
+    ATF_TP_ADD_TC(tp, start_stop);
+
+    return atf_no_error();
+}
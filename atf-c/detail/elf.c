@@ -0,0 +1,224 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/elf.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+
+#if defined(HAVE_ELF_H)
+#include <elf.h>
+#endif
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+#if defined(HAVE_ELF_H)
+/* Sections larger than this are not read, to not trust a corrupt file
+ * with the size of an allocation. */
+static const uint64_t max_section_size = 64 * 1024 * 1024;
+
+struct file_header {
+    bool m_is64;
+    uint64_t m_shoff;
+    uint16_t m_shentsize;
+    uint16_t m_shnum;
+    uint16_t m_shstrndx;
+};
+
+struct section_header {
+    uint32_t m_name;
+    uint64_t m_offset;
+    uint64_t m_size;
+};
+
+static
+bool
+read_at(const int fd, void *buf, const size_t length, const uint64_t offset)
+{
+    return pread(fd, buf, length, (off_t)offset) == (ssize_t)length;
+}
+
+/** Reads the ELF header, which must match the class and byte order of
+ * the running program because it is meant to read itself. */
+static
+bool
+read_file_header(const int fd, struct file_header *fh)
+{
+    const uint16_t probe = 1;
+    unsigned char ident[EI_NIDENT];
+
+    if (!read_at(fd, ident, sizeof(ident), 0) ||
+        memcmp(ident, ELFMAG, SELFMAG) != 0 ||
+        ident[EI_DATA] != (*(const unsigned char *)&probe == 1 ?
+                           ELFDATA2LSB : ELFDATA2MSB))
+        return false;
+
+    if (ident[EI_CLASS] == ELFCLASS64) {
+        Elf64_Ehdr eh;
+
+        if (!read_at(fd, &eh, sizeof(eh), 0))
+            return false;
+        fh->m_is64 = true;
+        fh->m_shoff = eh.e_shoff;
+        fh->m_shentsize = eh.e_shentsize;
+        fh->m_shnum = eh.e_shnum;
+        fh->m_shstrndx = eh.e_shstrndx;
+        return fh->m_shentsize == sizeof(Elf64_Shdr);
+    } else if (ident[EI_CLASS] == ELFCLASS32) {
+        Elf32_Ehdr eh;
+
+        if (!read_at(fd, &eh, sizeof(eh), 0))
+            return false;
+        fh->m_is64 = false;
+        fh->m_shoff = eh.e_shoff;
+        fh->m_shentsize = eh.e_shentsize;
+        fh->m_shnum = eh.e_shnum;
+        fh->m_shstrndx = eh.e_shstrndx;
+        return fh->m_shentsize == sizeof(Elf32_Shdr);
+    } else
+        return false;
+}
+
+static
+bool
+read_section_header(const int fd, const struct file_header *fh,
+                    const uint16_t index, struct section_header *sh)
+{
+    const uint64_t offset = fh->m_shoff + (uint64_t)index * fh->m_shentsize;
+
+    if (fh->m_is64) {
+        Elf64_Shdr raw;
+
+        if (!read_at(fd, &raw, sizeof(raw), offset))
+            return false;
+        sh->m_name = raw.sh_name;
+        sh->m_offset = raw.sh_offset;
+        sh->m_size = raw.sh_size;
+    } else {
+        Elf32_Shdr raw;
+
+        if (!read_at(fd, &raw, sizeof(raw), offset))
+            return false;
+        sh->m_name = raw.sh_name;
+        sh->m_offset = raw.sh_offset;
+        sh->m_size = raw.sh_size;
+    }
+    return true;
+}
+
+/** Looks up a section by name; files with extended section numbering
+ * are never expected here and are reported as not having it. */
+static
+bool
+find_section(const int fd, const char *name, struct section_header *sh)
+{
+    const size_t length = strlen(name) + 1;
+    struct section_header strtab;
+    struct file_header fh;
+    char buf[64];
+    uint16_t i;
+
+    if (length > sizeof(buf) || !read_file_header(fd, &fh) ||
+        fh.m_shstrndx == SHN_UNDEF || fh.m_shstrndx >= fh.m_shnum ||
+        !read_section_header(fd, &fh, fh.m_shstrndx, &strtab))
+        return false;
+
+    for (i = 0; i < fh.m_shnum; i++) {
+        if (!read_section_header(fd, &fh, i, sh) ||
+            sh->m_name >= strtab.m_size)
+            continue;
+        if (read_at(fd, buf, length, strtab.m_offset + sh->m_name) &&
+            memcmp(buf, name, length) == 0)
+            return true;
+    }
+    return false;
+}
+#endif /* defined(HAVE_ELF_H) */
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/** Appends the contents of a section of an ELF file to a string.
+ *
+ * Sets found to false if the file cannot be read, is not an ELF file for
+ * the running platform or does not have the section; all of these mean
+ * that the caller has to do without it.
+ */
+atf_error_t
+atf_elf_read_section(const char *path, const char *name,
+                     atf_dynstr_t *contents, bool *found)
+{
+#if defined(HAVE_ELF_H)
+    struct section_header sh;
+    atf_error_t err;
+    char buf[4096];
+    uint64_t done;
+    int fd;
+
+    *found = false;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return atf_no_error();
+
+    err = atf_no_error();
+    if (find_section(fd, name, &sh) && sh.m_size <= max_section_size) {
+        *found = true;
+        for (done = 0; !atf_is_error(err) && done < sh.m_size; ) {
+            const size_t length = sh.m_size - done < sizeof(buf) ?
+                (size_t)(sh.m_size - done) : sizeof(buf);
+
+            if (!read_at(fd, buf, length, sh.m_offset + done)) {
+                atf_dynstr_clear(contents);
+                *found = false;
+                break;
+            }
+            err = atf_dynstr_append_fmt(contents, "%.*s", (int)length, buf);
+            done += length;
+        }
+    }
+
+    close(fd);
+    return err;
+#else
+    (void)path;
+    (void)name;
+    (void)contents;
+    *found = false;
+    return atf_no_error();
+#endif
+}
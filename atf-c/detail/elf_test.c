@@ -0,0 +1,200 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/elf.h"
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/check.h"
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/test_helpers.h"
+#include "atf-c/utils.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+require_elf(void)
+{
+#if !defined(HAVE_ELF_H)
+    atf_tc_skip("ELF files are not supported on this platform");
+#endif
+}
+
+/** Requires the compiler used by build_fixture and, optionally, objcopy. */
+static
+void
+require_progs(atf_tc_t *tc, const bool objcopy)
+{
+    atf_tc_set_md_var(tc, "require.progs", "%s%s",
+                      atf_env_get_with_default("ATF_BUILD_CC", ATF_BUILD_CC),
+                      objcopy ? " objcopy" : "");
+}
+
+/** Compiles a tiny object file to prog, where objcopy can modify it.
+ *
+ * This test program cannot be used instead: in the build tree it is the
+ * libtool wrapper script, not an ELF file. */
+static
+void
+build_fixture(void)
+{
+    bool success;
+
+    atf_utils_create_file("prog.c", "int elf_test_fixture = 1;\n");
+    RE(atf_check_build_c_o("prog.c", "prog", NULL, &success));
+    ATF_REQUIRE_MSG(success, "Failed to build the ELF fixture");
+}
+
+static
+void
+check_not_found(const char *path, const char *name)
+{
+    atf_dynstr_t contents;
+    bool found;
+
+    RE(atf_dynstr_init(&contents));
+    found = true;
+    RE(atf_elf_read_section(path, name, &contents, &found));
+    ATF_CHECK(!found);
+    ATF_CHECK_EQ(0, atf_dynstr_length(&contents));
+    atf_dynstr_fini(&contents);
+}
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC(read_section__found);
+ATF_TC_HEAD(read_section__found, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_elf_read_section "
+                      "returns the contents of an existing section");
+    require_progs(tc, true);
+}
+ATF_TC_BODY(read_section__found, tc)
+{
+    atf_dynstr_t contents;
+    bool found;
+
+    require_elf();
+    build_fixture();
+    atf_utils_create_file("listing", "first line\nsecond line\n");
+    ATF_REQUIRE(system("objcopy --add-section .atf_list=listing prog") == 0);
+
+    RE(atf_dynstr_init(&contents));
+    RE(atf_elf_read_section("prog", ATF_ELF_LIST_SECTION, &contents,
+                            &found));
+    ATF_REQUIRE(found);
+    ATF_CHECK_STREQ("first line\nsecond line\n",
+                    atf_dynstr_cstring(&contents));
+    atf_dynstr_fini(&contents);
+}
+
+ATF_TC(read_section__large);
+ATF_TC_HEAD(read_section__large, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_elf_read_section "
+                      "returns sections that span several reads");
+    require_progs(tc, true);
+}
+ATF_TC_BODY(read_section__large, tc)
+{
+    atf_dynstr_t contents;
+    FILE *f;
+    bool found;
+    int i;
+
+    require_elf();
+    build_fixture();
+    ATF_REQUIRE((f = fopen("listing", "w")) != NULL);
+    for (i = 0; i < 1000; i++)
+        fprintf(f, "ident: tc%04d\n", i);
+    fclose(f);
+    ATF_REQUIRE(system("objcopy --add-section .atf_list=listing prog") == 0);
+
+    RE(atf_dynstr_init(&contents));
+    RE(atf_elf_read_section("prog", ATF_ELF_LIST_SECTION, &contents,
+                            &found));
+    ATF_REQUIRE(found);
+    ATF_CHECK_EQ(1000 * strlen("ident: tc0000\n"),
+                 atf_dynstr_length(&contents));
+    ATF_CHECK(strstr(atf_dynstr_cstring(&contents),
+                     "ident: tc0999\n") != NULL);
+    atf_dynstr_fini(&contents);
+}
+
+ATF_TC(read_section__missing_section);
+ATF_TC_HEAD(read_section__missing_section, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_elf_read_section "
+                      "reports a section that does not exist as not found");
+    require_progs(tc, false);
+}
+ATF_TC_BODY(read_section__missing_section, tc)
+{
+    build_fixture();
+    check_not_found("prog", ATF_ELF_LIST_SECTION);
+}
+
+ATF_TC_WITHOUT_HEAD(read_section__missing_file);
+ATF_TC_BODY(read_section__missing_file, tc)
+{
+    check_not_found("non-existent", ATF_ELF_LIST_SECTION);
+}
+
+ATF_TC_WITHOUT_HEAD(read_section__not_elf);
+ATF_TC_BODY(read_section__not_elf, tc)
+{
+    atf_utils_create_file("prog", "#! /bin/sh\necho %s\n",
+                          ATF_ELF_LIST_SECTION);
+    check_not_found("prog", ATF_ELF_LIST_SECTION);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, read_section__found);
+    ATF_TP_ADD_TC(tp, read_section__large);
+    ATF_TP_ADD_TC(tp, read_section__missing_section);
+    ATF_TP_ADD_TC(tp, read_section__missing_file);
+    ATF_TP_ADD_TC(tp, read_section__not_elf);
+
+    return atf_no_error();
+}
@@ -37,6 +37,7 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -54,6 +55,13 @@
  * Prototypes for auxiliary functions.
  * --------------------------------------------------------------------- */
 
+/* A directory entered while removing a tree, to recognize it again when
+ * coming back up to it. */
+struct rmtree_level {
+    dev_t m_dev;
+    ino_t m_ino;
+};
+
 static bool check_umask(const mode_t, const mode_t);
 static atf_error_t copy_contents(const atf_fs_path_t *, char **);
 static mode_t current_umask(void);
@@ -61,6 +69,13 @@ static atf_error_t do_mkdtemp(char *);
 static atf_error_t normalize(atf_dynstr_t *, char *);
 static atf_error_t normalize_ap(atf_dynstr_t *, const char *, va_list);
 static void replace_contents(atf_fs_path_t *, const char *);
+static atf_error_t rmtree_dir(const char *, const dev_t);
+static atf_error_t rmtree_enter(const int, const char *, const char *,
+                                const dev_t, int *, struct rmtree_level *);
+static int rmtree_open(const int, const char *);
+static atf_error_t rmtree_scan(const int, const char *, atf_dynstr_t *,
+                               bool *);
+static atf_error_t stat_set_type(atf_fs_stat_t *, const char *);
 static const char *stat_type_to_string(const int);
 
 /* ---------------------------------------------------------------------
@@ -158,6 +173,45 @@ unknown_type_error(const char *path, int type)
     return err;
 }
 
+/* ---------------------------------------------------------------------
+ * The "mount_point" error type.
+ * --------------------------------------------------------------------- */
+
+struct mount_point_error_data {
+    /* See the comment in invalid_umask_error_data. */
+    char m_path[1024];
+};
+typedef struct mount_point_error_data mount_point_error_data_t;
+
+static
+void
+mount_point_format(const atf_error_t err, char *buf, size_t buflen)
+{
+    const mount_point_error_data_t *data;
+
+    PRE(atf_error_is(err, "mount_point"));
+
+    data = atf_error_data(err);
+    snprintf(buf, buflen, "Cannot remove %s because it is a mount point; "
+             "unmount it first", data->m_path);
+}
+
+static
+atf_error_t
+mount_point_error(const char *path)
+{
+    atf_error_t err;
+    mount_point_error_data_t data;
+
+    strncpy(data.m_path, path, sizeof(data.m_path));
+    data.m_path[sizeof(data.m_path) - 1] = '\0';
+
+    err = atf_error_new("mount_point", &data, sizeof(data),
+                        mount_point_format);
+
+    return err;
+}
+
 /* ---------------------------------------------------------------------
  * Auxiliary functions.
  * --------------------------------------------------------------------- */
@@ -542,6 +596,34 @@ const int atf_fs_stat_wht_type  = 8;
  * Constructors/destructors.
  */
 
+/* Fills in the type of 'st' from the mode returned by the stat(2) family
+ * of calls; 'pstr' is only used to construct the error message. */
+static
+atf_error_t
+stat_set_type(atf_fs_stat_t *st, const char *pstr)
+{
+    atf_error_t err;
+    int type = st->m_sb.st_mode & S_IFMT;
+
+    err = atf_no_error();
+    switch (type) {
+        case S_IFBLK:  st->m_type = atf_fs_stat_blk_type;  break;
+        case S_IFCHR:  st->m_type = atf_fs_stat_chr_type;  break;
+        case S_IFDIR:  st->m_type = atf_fs_stat_dir_type;  break;
+        case S_IFIFO:  st->m_type = atf_fs_stat_fifo_type; break;
+        case S_IFLNK:  st->m_type = atf_fs_stat_lnk_type;  break;
+        case S_IFREG:  st->m_type = atf_fs_stat_reg_type;  break;
+        case S_IFSOCK: st->m_type = atf_fs_stat_sock_type; break;
+#if defined(S_IFWHT)
+        case S_IFWHT:  st->m_type = atf_fs_stat_wht_type;  break;
+#endif
+        default:
+            err = unknown_type_error(pstr, type);
+    }
+
+    return err;
+}
+
 atf_error_t
 atf_fs_stat_init(atf_fs_stat_t *st, const atf_fs_path_t *p)
 {
@@ -551,24 +633,25 @@ atf_fs_stat_init(atf_fs_stat_t *st, const atf_fs_path_t *p)
     if (lstat(pstr, &st->m_sb) == -1) {
         err = atf_libc_error(errno, "Cannot get information of %s; "
                              "lstat(2) failed", pstr);
-    } else {
-        int type = st->m_sb.st_mode & S_IFMT;
-        err = atf_no_error();
-        switch (type) {
-            case S_IFBLK:  st->m_type = atf_fs_stat_blk_type;  break;
-            case S_IFCHR:  st->m_type = atf_fs_stat_chr_type;  break;
-            case S_IFDIR:  st->m_type = atf_fs_stat_dir_type;  break;
-            case S_IFIFO:  st->m_type = atf_fs_stat_fifo_type; break;
-            case S_IFLNK:  st->m_type = atf_fs_stat_lnk_type;  break;
-            case S_IFREG:  st->m_type = atf_fs_stat_reg_type;  break;
-            case S_IFSOCK: st->m_type = atf_fs_stat_sock_type; break;
-#if defined(S_IFWHT)
-            case S_IFWHT:  st->m_type = atf_fs_stat_wht_type;  break;
-#endif
-            default:
-                err = unknown_type_error(pstr, type);
-        }
-    }
+    } else
+        err = stat_set_type(st, pstr);
+
+    return err;
+}
+
+/* Same as atf_fs_stat_init, but for the entry 'name' of the directory
+ * open in 'dirfd'.  This avoids constructing and resolving the full path
+ * of every entry when walking a directory. */
+atf_error_t
+atf_fs_stat_init_at(atf_fs_stat_t *st, const int dirfd, const char *name)
+{
+    atf_error_t err;
+
+    if (fstatat(dirfd, name, &st->m_sb, AT_SYMLINK_NOFOLLOW) == -1) {
+        err = atf_libc_error(errno, "Cannot get information of %s; "
+                             "fstatat(2) failed", name);
+    } else
+        err = stat_set_type(st, name);
 
     return err;
 }
@@ -867,6 +950,284 @@ atf_fs_rmdir(const atf_fs_path_t *p)
     return err;
 }
 
+/* Opens the directory 'name' relative to 'parentfd' for the purposes of
+ * deleting its contents.  The directory may have been left without read
+ * or search permissions by the test case, so grant them to ourselves
+ * before giving up. */
+static
+int
+rmtree_open(const int parentfd, const char *name)
+{
+    const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    int fd;
+
+    fd = openat(parentfd, name, flags);
+    if (fd == -1 && errno == EACCES) {
+        if (fchmodat(parentfd, name, S_IRWXU, 0) != -1)
+            fd = openat(parentfd, name, flags);
+        else
+            errno = EACCES;
+    }
+    return fd;
+}
+
+/* Enters the directory 'name', relative to 'parentfd', and makes sure that
+ * its contents can be deleted.  'path' is the full name of the directory
+ * and is only used to construct error messages.  Directories that do not
+ * live in the 'device' file system are mount points and are refused. */
+static
+atf_error_t
+rmtree_enter(const int parentfd, const char *name, const char *path,
+             const dev_t device, int *fdp, struct rmtree_level *level)
+{
+    atf_error_t err;
+    struct stat sb;
+    int fd;
+
+    fd = rmtree_open(parentfd, name);
+    if (fd == -1)
+        return atf_libc_error(errno, "Cannot open directory %s", path);
+
+    if (fstat(fd, &sb) == -1) {
+        err = atf_libc_error(errno, "Cannot get information of %s", path);
+        goto err_fd;
+    }
+    if (sb.st_dev != device) {
+        err = mount_point_error(path);
+        goto err_fd;
+    }
+    if ((sb.st_mode & S_IRWXU) != S_IRWXU &&
+        fchmod(fd, (sb.st_mode & 07777) | S_IRWXU) == -1) {
+        err = atf_libc_error(errno, "Cannot grant write access to %s",
+                             path);
+        goto err_fd;
+    }
+
+    level->m_dev = sb.st_dev;
+    level->m_ino = sb.st_ino;
+    *fdp = fd;
+    return atf_no_error();
+
+err_fd:
+    close(fd);
+    return err;
+}
+
+/* Deletes all entries of the directory 'fd' that are not directories and
+ * stops at the first subdirectory, whose name is stored in 'subdir'.  The
+ * type of the entries is taken from the dirent structure whenever the file
+ * system provides it so that only the directories have to be inspected. */
+static
+atf_error_t
+rmtree_scan(const int fd, const char *path, atf_dynstr_t *subdir,
+            bool *found)
+{
+    atf_error_t err;
+    struct dirent *de;
+    DIR *dir;
+    int dirfd;
+
+    *found = false;
+
+    /* fdopendir takes ownership of the descriptor, which has to outlive
+     * the stream. */
+    dirfd = dup(fd);
+    if (dirfd == -1)
+        return atf_libc_error(errno, "Cannot open directory %s", path);
+    dir = fdopendir(dirfd);
+    if (dir == NULL) {
+        err = atf_libc_error(errno, "Cannot open directory %s", path);
+        close(dirfd);
+        return err;
+    }
+
+    err = atf_no_error();
+    while (!atf_is_error(err) && !*found) {
+        bool is_dir;
+
+        errno = 0;
+        de = readdir(dir);
+        if (de == NULL) {
+            if (errno != 0)
+                err = atf_libc_error(errno, "Cannot read directory %s",
+                                     path);
+            break;
+        }
+
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+
+#if defined(HAVE_STRUCT_DIRENT_D_TYPE)
+        if (de->d_type != DT_UNKNOWN)
+            is_dir = de->d_type == DT_DIR;
+        else
+#endif
+        {
+            struct stat sb;
+
+            if (fstatat(fd, de->d_name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+                err = atf_libc_error(errno, "Cannot get information of "
+                                     "%s/%s", path, de->d_name);
+                break;
+            }
+            is_dir = S_ISDIR(sb.st_mode);
+        }
+
+        if (is_dir) {
+            atf_dynstr_clear(subdir);
+            err = atf_dynstr_append_fmt(subdir, "%s", de->d_name);
+            *found = !atf_is_error(err);
+        } else if (unlinkat(fd, de->d_name, 0) == -1)
+            err = atf_libc_error(errno, "Cannot unlink file %s/%s", path,
+                                 de->d_name);
+    }
+    closedir(dir);
+
+    return err;
+}
+
+/* Removes the directory 'path' and all of its contents.
+ *
+ * The tree is walked without recursion and with a single open directory
+ * at any time so that its depth is only limited by memory.  Going back up
+ * happens through "..", which is checked against the directory that was
+ * entered on the way down in case the tree is moved while we remove it. */
+static
+atf_error_t
+rmtree_dir(const char *path, const dev_t device)
+{
+    struct rmtree_level *levels, *aux;
+    size_t depth, capacity;
+    atf_dynstr_t current, subdir;
+    atf_error_t err;
+    bool found;
+    int fd, parentfd;
+
+    err = atf_dynstr_init_fmt(&current, "%s", path);
+    if (atf_is_error(err))
+        return err;
+    err = atf_dynstr_init(&subdir);
+    if (atf_is_error(err))
+        goto out_current;
+
+    capacity = 16;
+    levels = (struct rmtree_level *)malloc(capacity * sizeof(*levels));
+    if (levels == NULL) {
+        err = atf_no_memory_error();
+        goto out_subdir;
+    }
+
+    err = rmtree_enter(AT_FDCWD, path, path, device, &fd, &levels[0]);
+    if (atf_is_error(err))
+        goto out_levels;
+    depth = 1;
+
+    while (!atf_is_error(err)) {
+        err = rmtree_scan(fd, atf_dynstr_cstring(&current), &subdir, &found);
+        if (atf_is_error(err))
+            break;
+
+        if (found) {
+            if (depth == capacity) {
+                aux = (struct rmtree_level *)realloc(
+                    levels, capacity * 2 * sizeof(*levels));
+                if (aux == NULL) {
+                    err = atf_no_memory_error();
+                    break;
+                }
+                levels = aux;
+                capacity *= 2;
+            }
+
+            err = atf_dynstr_append_fmt(&current, "/%s",
+                                        atf_dynstr_cstring(&subdir));
+            if (atf_is_error(err))
+                break;
+
+            parentfd = fd;
+            err = rmtree_enter(parentfd, atf_dynstr_cstring(&subdir),
+                               atf_dynstr_cstring(&current), device, &fd,
+                               &levels[depth]);
+            if (atf_is_error(err))
+                break;
+            close(parentfd);
+            depth++;
+        } else if (depth == 1) {
+            close(fd);
+            fd = -1;
+            if (unlinkat(AT_FDCWD, path, AT_REMOVEDIR) == -1)
+                err = atf_libc_error(errno, "Cannot remove directory %s",
+                                     path);
+            break;
+        } else {
+            const size_t slash = atf_dynstr_rfind_ch(&current, '/');
+            atf_dynstr_t parent;
+            struct stat sb;
+
+            parentfd = openat(fd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (parentfd == -1) {
+                err = atf_libc_error(errno, "Cannot open the parent of %s",
+                                     atf_dynstr_cstring(&current));
+                break;
+            }
+            if (fstat(parentfd, &sb) == -1 ||
+                sb.st_dev != levels[depth - 2].m_dev ||
+                sb.st_ino != levels[depth - 2].m_ino) {
+                err = atf_libc_error(ENOENT, "Cannot remove %s: it was "
+                                     "moved during the removal",
+                                     atf_dynstr_cstring(&current));
+                close(parentfd);
+                break;
+            }
+            close(fd);
+            fd = parentfd;
+            depth--;
+
+            if (unlinkat(fd, atf_dynstr_cstring(&current) + slash + 1,
+                         AT_REMOVEDIR) == -1) {
+                err = atf_libc_error(errno, "Cannot remove directory %s",
+                                     atf_dynstr_cstring(&current));
+                break;
+            }
+            err = atf_dynstr_init_substr(&parent, &current, 0, slash);
+            if (atf_is_error(err))
+                break;
+            atf_dynstr_fini(&current);
+            current = parent;
+        }
+    }
+
+    if (fd != -1)
+        close(fd);
+out_levels:
+    free(levels);
+out_subdir:
+    atf_dynstr_fini(&subdir);
+out_current:
+    atf_dynstr_fini(&current);
+    return err;
+}
+
+atf_error_t
+atf_fs_rmtree(const atf_fs_path_t *p)
+{
+    const char *path;
+    struct stat sb;
+
+    path = atf_fs_path_cstring(p);
+
+    if (lstat(path, &sb) == -1)
+        return atf_libc_error(errno, "Cannot get information of %s", path);
+
+    if (!S_ISDIR(sb.st_mode)) {
+        if (unlink(path) == -1)
+            return atf_libc_error(errno, "Cannot unlink file %s", path);
+        return atf_no_error();
+    }
+
+    return rmtree_dir(path, sb.st_dev);
+}
+
 atf_error_t
 atf_fs_unlink(const atf_fs_path_t *p)
 {
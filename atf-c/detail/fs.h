@@ -89,6 +89,7 @@ extern const int atf_fs_stat_wht_type;
 
 /* Constructors/destructors. */
 atf_error_t atf_fs_stat_init(atf_fs_stat_t *, const atf_fs_path_t *);
+atf_error_t atf_fs_stat_init_at(atf_fs_stat_t *, const int, const char *);
 void atf_fs_stat_copy(atf_fs_stat_t *, const atf_fs_stat_t *);
 void atf_fs_stat_fini(atf_fs_stat_t *);
 
@@ -123,6 +124,7 @@ atf_error_t atf_fs_getcwd(atf_fs_path_t *);
 atf_error_t atf_fs_mkdtemp(atf_fs_path_t *);
 atf_error_t atf_fs_mkstemp(atf_fs_path_t *, int *);
 atf_error_t atf_fs_rmdir(const atf_fs_path_t *);
+atf_error_t atf_fs_rmtree(const atf_fs_path_t *);
 atf_error_t atf_fs_unlink(const atf_fs_path_t *);
 
 #endif /* !defined(ATF_C_DETAIL_FS_H) */
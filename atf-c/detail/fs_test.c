@@ -26,6 +26,7 @@
 #include "atf-c/detail/fs.h"
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 
 #include <errno.h>
@@ -454,6 +455,43 @@ ATF_TC_BODY(stat_mode, tc)
     atf_fs_path_fini(&p);
 }
 
+ATF_TC(stat_init_at);
+ATF_TC_HEAD(stat_init_at, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_stat_init_at "
+                      "function");
+}
+ATF_TC_BODY(stat_init_at, tc)
+{
+    atf_fs_stat_t st;
+    atf_error_t err;
+    int fd;
+
+    create_dir("dir", 0755);
+    create_file("dir/reg", 0640);
+    ATF_REQUIRE(symlink("reg", "dir/link") != -1);
+
+    fd = open("dir", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+
+    RE(atf_fs_stat_init_at(&st, fd, "reg"));
+    ATF_CHECK_EQ(atf_fs_stat_reg_type, atf_fs_stat_get_type(&st));
+    ATF_CHECK_EQ(0640, atf_fs_stat_get_mode(&st));
+    atf_fs_stat_fini(&st);
+
+    RE(atf_fs_stat_init_at(&st, fd, "link"));
+    ATF_CHECK_EQ(atf_fs_stat_lnk_type, atf_fs_stat_get_type(&st));
+    atf_fs_stat_fini(&st);
+
+    err = atf_fs_stat_init_at(&st, fd, "missing");
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_REQUIRE_EQ(ENOENT, atf_libc_error_code(err));
+    atf_error_free(err);
+
+    close(fd);
+}
+
 ATF_TC(stat_type);
 ATF_TC_HEAD(stat_type, tc)
 {
@@ -816,6 +854,146 @@ ATF_TC_CLEANUP(rmdir_eperm, tc)
     }
 }
 
+ATF_TC(rmtree_file);
+ATF_TC_HEAD(rmtree_file, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_rmtree function on a "
+                      "file that is not a directory");
+}
+ATF_TC_BODY(rmtree_file, tc)
+{
+    atf_fs_path_t p;
+
+    RE(atf_fs_path_init_fmt(&p, "test-file"));
+
+    create_file("test-file", 0644);
+    RE(atf_fs_rmtree(&p));
+    ATF_REQUIRE(!exists(&p));
+
+    atf_fs_path_fini(&p);
+}
+
+ATF_TC(rmtree_tree);
+ATF_TC_HEAD(rmtree_tree, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_rmtree function on a "
+                      "nested directory tree");
+}
+ATF_TC_BODY(rmtree_tree, tc)
+{
+    atf_fs_path_t p, outside;
+
+    RE(atf_fs_path_init_fmt(&p, "test-dir"));
+    RE(atf_fs_path_init_fmt(&outside, "outside"));
+
+    ATF_REQUIRE(mkdir("outside", 0755) != -1);
+    create_file("outside/keep", 0644);
+
+    ATF_REQUIRE(mkdir("test-dir", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/a", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/a/b", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/a/b/c", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/empty", 0755) != -1);
+    create_file("test-dir/file", 0644);
+    create_file("test-dir/a/file", 0644);
+    create_file("test-dir/a/b/c/file", 0000);
+    ATF_REQUIRE(mkfifo("test-dir/a/fifo", 0644) != -1);
+    ATF_REQUIRE(symlink("../../outside", "test-dir/a/link") != -1);
+
+    RE(atf_fs_rmtree(&p));
+    ATF_REQUIRE(!exists(&p));
+    ATF_REQUIRE(exists(&outside));
+    ATF_REQUIRE(access("outside/keep", F_OK) != -1);
+
+    atf_fs_path_fini(&outside);
+    atf_fs_path_fini(&p);
+}
+
+ATF_TC(rmtree_unprotect);
+ATF_TC_HEAD(rmtree_unprotect, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_fs_rmtree removes "
+                      "directories left without read, write or search "
+                      "permissions");
+}
+ATF_TC_BODY(rmtree_unprotect, tc)
+{
+    atf_fs_path_t p;
+
+    RE(atf_fs_path_init_fmt(&p, "test-dir"));
+
+    ATF_REQUIRE(mkdir("test-dir", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/ro", 0755) != -1);
+    ATF_REQUIRE(mkdir("test-dir/none", 0755) != -1);
+    create_file("test-dir/ro/file", 0644);
+    create_file("test-dir/none/file", 0644);
+    ATF_REQUIRE(chmod("test-dir/ro", 0555) != -1);
+    ATF_REQUIRE(chmod("test-dir/none", 0000) != -1);
+    ATF_REQUIRE(chmod("test-dir", 0500) != -1);
+
+    RE(atf_fs_rmtree(&p));
+    ATF_REQUIRE(!exists(&p));
+
+    atf_fs_path_fini(&p);
+}
+
+ATF_TC(rmtree_deep);
+ATF_TC_HEAD(rmtree_deep, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_fs_rmtree removes "
+                      "trees deeper than the number of files that can be "
+                      "open at once");
+}
+ATF_TC_BODY(rmtree_deep, tc)
+{
+    struct rlimit rl;
+    atf_fs_path_t p;
+    char path[1024];
+    size_t i;
+
+    RE(atf_fs_path_init_fmt(&p, "test-dir"));
+
+    strcpy(path, "test-dir");
+    ATF_REQUIRE(mkdir(path, 0755) != -1);
+    for (i = 0; i < 100; i++) {
+        strcat(path, "/d");
+        ATF_REQUIRE(mkdir(path, 0755) != -1);
+    }
+    strcat(path, "/file");
+    create_file(path, 0644);
+
+    ATF_REQUIRE(getrlimit(RLIMIT_NOFILE, &rl) != -1);
+    rl.rlim_cur = 32;
+    ATF_REQUIRE(setrlimit(RLIMIT_NOFILE, &rl) != -1);
+
+    RE(atf_fs_rmtree(&p));
+    ATF_REQUIRE(!exists(&p));
+
+    atf_fs_path_fini(&p);
+}
+
+ATF_TC(rmtree_enoent);
+ATF_TC_HEAD(rmtree_enoent, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_fs_rmtree function on a "
+                      "missing file");
+}
+ATF_TC_BODY(rmtree_enoent, tc)
+{
+    atf_fs_path_t p;
+    atf_error_t err;
+
+    RE(atf_fs_path_init_fmt(&p, "missing"));
+
+    err = atf_fs_rmtree(&p);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_REQUIRE_EQ(atf_libc_error_code(err), ENOENT);
+    atf_error_free(err);
+
+    atf_fs_path_fini(&p);
+}
+
 ATF_TC(mkdtemp_ok);
 ATF_TC_HEAD(mkdtemp_ok, tc)
 {
@@ -1066,6 +1244,7 @@ ATF_TP_ADD_TCS(tp)
     /* Add the tests for the "atf_fs_stat" type. */
     ATF_TP_ADD_TC(tp, stat_mode);
     ATF_TP_ADD_TC(tp, stat_type);
+    ATF_TP_ADD_TC(tp, stat_init_at);
     ATF_TP_ADD_TC(tp, stat_perms);
 
     /* Add the tests for the free functions. */
@@ -1075,6 +1254,11 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, rmdir_empty);
     ATF_TP_ADD_TC(tp, rmdir_enotempty);
     ATF_TP_ADD_TC(tp, rmdir_eperm);
+    ATF_TP_ADD_TC(tp, rmtree_file);
+    ATF_TP_ADD_TC(tp, rmtree_tree);
+    ATF_TP_ADD_TC(tp, rmtree_unprotect);
+    ATF_TP_ADD_TC(tp, rmtree_deep);
+    ATF_TP_ADD_TC(tp, rmtree_enoent);
     ATF_TP_ADD_TC(tp, mkdtemp_ok);
     ATF_TP_ADD_TC(tp, mkdtemp_err);
     ATF_TP_ADD_TC(tp, mkdtemp_umask);
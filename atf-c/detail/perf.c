@@ -0,0 +1,365 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/perf.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atf-c/detail/sanity.h"
+#include "atf-c/detail/text.h"
+#include "atf-c/error.h"
+#include "atf-c/utils.h"
+
+/* Number of median absolute deviations above the baseline that are still
+ * considered noise.  1.4826 scales the MAD to a standard deviation for
+ * normally-distributed samples, so this allows about three of those. */
+#define NOISE_MADS (3 * 1.4826)
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static int
+compare_doubles(const void *v1, const void *v2)
+{
+    const double d1 = *(const double *)v1;
+    const double d2 = *(const double *)v2;
+
+    return d1 < d2 ? -1 : d1 > d2;
+}
+
+/* Computes the median of an array of values, which is sorted. */
+static double
+sorted_median(double *values, const size_t count)
+{
+    atf_perf_sort(values, count);
+    if (count % 2 == 1)
+        return values[count / 2];
+    else
+        return (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/** Locks a baseline file for the duration of a read or an update.
+ *
+ * The lock is released when the file is closed.  This serializes the test
+ * cases that share a baseline when they are run in parallel.
+ */
+static atf_error_t
+lock_file(const int fd, const char *path, const short type)
+{
+    struct flock fl;
+
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) == -1) {
+        if (errno != EINTR)
+            return atf_libc_error(errno, "Cannot lock baseline file %s",
+                                  path);
+    }
+    return atf_no_error();
+}
+
+/** Parses a line of a baseline file.
+ *
+ * Lines have the form "key median mad".  Returns false if the line does
+ * not belong to the given key or is malformed.
+ */
+static bool
+parse_line(const char *line, const char *key, atf_perf_stats_t *stats)
+{
+    const size_t keylen = strlen(key);
+    char *end;
+
+    if (strncmp(line, key, keylen) != 0 || line[keylen] != ' ')
+        return false;
+    line += keylen;
+
+    stats->m_median = strtod(line, &end);
+    if (end == line)
+        return false;
+    line = end;
+    stats->m_mad = strtod(line, &end);
+    if (end == line)
+        return false;
+
+    while (isspace((unsigned char)*end))
+        end++;
+    return *end == '\0';
+}
+
+static bool
+line_has_key(const char *line, const char *key)
+{
+    const size_t keylen = strlen(key);
+
+    return strncmp(line, key, keylen) == 0 && line[keylen] == ' ';
+}
+
+static atf_error_t
+write_all(const int fd, const char *path, const char *data, size_t length)
+{
+    while (length > 0) {
+        const ssize_t ret = write(fd, data, length);
+        if (ret == -1) {
+            if (errno == EINTR)
+                continue;
+            return atf_libc_error(errno, "Cannot write baseline file %s",
+                                  path);
+        }
+        data += ret;
+        length -= ret;
+    }
+    return atf_no_error();
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_perf_config" type.
+ * --------------------------------------------------------------------- */
+
+void
+atf_perf_config_init(atf_perf_config_t *config)
+{
+    config->m_baseline = NULL;
+    config->m_record = false;
+    config->m_tolerance = 0.1;
+    config->m_samples = 5;
+}
+
+/** Sets one of the perf.* variables.
+ *
+ * The tolerance is given as a percentage of the baseline median.
+ */
+atf_error_t
+atf_perf_config_set(atf_perf_config_t *config, const char *name,
+                    const char *value)
+{
+    atf_error_t err;
+    long l;
+
+    if (strcmp(name, "perf.baseline") == 0) {
+        config->m_baseline = value[0] == '\0' ? NULL : value;
+        err = atf_no_error();
+    } else if (strcmp(name, "perf.record") == 0) {
+        err = atf_text_to_bool(value, &config->m_record);
+    } else if (strcmp(name, "perf.tolerance") == 0) {
+        err = atf_text_to_long(value, &l);
+        if (!atf_is_error(err) && l < 0)
+            err = atf_libc_error(EINVAL, "Invalid value '%s' for %s; must "
+                                 "be a non-negative percentage", value, name);
+        if (!atf_is_error(err))
+            config->m_tolerance = l / 100.0;
+    } else if (strcmp(name, "perf.samples") == 0) {
+        err = atf_text_to_long(value, &l);
+        if (!atf_is_error(err) && l < 1)
+            err = atf_libc_error(EINVAL, "Invalid value '%s' for %s; must "
+                                 "be a positive integer", value, name);
+        if (!atf_is_error(err))
+            config->m_samples = l;
+    } else {
+        err = atf_libc_error(EINVAL, "Unknown performance setting %s", name);
+    }
+
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_perf_stats" type.
+ * --------------------------------------------------------------------- */
+
+/** Computes the median and the median absolute deviation of some samples.
+ *
+ * The samples are overwritten in the process.
+ */
+void
+atf_perf_stats_compute(atf_perf_stats_t *stats, double *samples,
+                       const size_t count)
+{
+    size_t i;
+
+    PRE(count > 0);
+
+    stats->m_median = sorted_median(samples, count);
+    for (i = 0; i < count; i++) {
+        const double d = samples[i] - stats->m_median;
+        samples[i] = d < 0 ? -d : d;
+    }
+    stats->m_mad = sorted_median(samples, count);
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+/* Sorts an array of samples in ascending order. */
+void
+atf_perf_sort(double *values, const size_t count)
+{
+    qsort(values, count, sizeof(*values), compare_doubles);
+}
+
+/** Looks up the entry of a measurement in a baseline file.
+ *
+ * A missing file is handled like a file without the entry.
+ */
+atf_error_t
+atf_perf_baseline_get(const char *path, const char *key, bool *found,
+                      atf_perf_stats_t *stats)
+{
+    atf_utils_linereader_t reader;
+    atf_error_t err;
+    const char *line;
+    int fd;
+
+    *found = false;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT)
+            return atf_no_error();
+        return atf_libc_error(errno, "Cannot open baseline file %s", path);
+    }
+
+    err = lock_file(fd, path, F_RDLCK);
+    if (!atf_is_error(err)) {
+        atf_utils_linereader_init(&reader, fd);
+        while (!*found &&
+               (line = atf_utils_linereader_next(&reader, NULL)) != NULL)
+            *found = parse_line(line, key, stats);
+        atf_utils_linereader_fini(&reader);
+    }
+
+    close(fd);
+    return err;
+}
+
+/** Stores the entry of a measurement in a baseline file.
+ *
+ * Replaces any previous entry for the same key and keeps the rest of the
+ * file, including comments, intact.
+ */
+atf_error_t
+atf_perf_baseline_put(const char *path, const char *key,
+                      const atf_perf_stats_t *stats)
+{
+    atf_utils_linereader_t reader;
+    atf_dynstr_t contents;
+    atf_error_t err;
+    const char *line;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return atf_libc_error(errno, "Cannot open baseline file %s", path);
+
+    err = lock_file(fd, path, F_WRLCK);
+    if (atf_is_error(err))
+        goto out_fd;
+
+    err = atf_dynstr_init(&contents);
+    if (atf_is_error(err))
+        goto out_fd;
+
+    atf_utils_linereader_init(&reader, fd);
+    while (!atf_is_error(err) &&
+           (line = atf_utils_linereader_next(&reader, NULL)) != NULL) {
+        if (!line_has_key(line, key))
+            err = atf_dynstr_append_fmt(&contents, "%s\n", line);
+    }
+    atf_utils_linereader_fini(&reader);
+    if (atf_is_error(err))
+        goto out_contents;
+
+    err = atf_dynstr_append_fmt(&contents, "%s %.1f %.1f\n", key,
+                                stats->m_median, stats->m_mad);
+    if (atf_is_error(err))
+        goto out_contents;
+
+    if (ftruncate(fd, 0) == -1 || lseek(fd, 0, SEEK_SET) == -1) {
+        err = atf_libc_error(errno, "Cannot rewrite baseline file %s", path);
+        goto out_contents;
+    }
+    err = write_all(fd, path, atf_dynstr_cstring(&contents),
+                    atf_dynstr_length(&contents));
+
+out_contents:
+    atf_dynstr_fini(&contents);
+out_fd:
+    close(fd);
+    return err;
+}
+
+/** Compares a measurement against its baseline, or records it.
+ *
+ * A measurement regresses if its median exceeds the baseline median by
+ * more than the tolerance plus the noise of the baseline.  Measurements
+ * without a baseline never regress.  The message describing the outcome
+ * is stored in the uninitialized msg in all cases except on error.
+ */
+atf_error_t
+atf_perf_evaluate(const atf_perf_config_t *config, const char *key,
+                  const atf_perf_stats_t *stats, bool *regressed,
+                  atf_dynstr_t *msg)
+{
+    atf_perf_stats_t baseline;
+    atf_error_t err;
+    bool found;
+
+    *regressed = false;
+
+    if (config->m_baseline == NULL) {
+        return atf_dynstr_init_fmt(msg, "%s: median %.1f ns, deviation "
+            "%.1f ns; no baseline configured", key, stats->m_median,
+            stats->m_mad);
+    } else if (config->m_record) {
+        err = atf_perf_baseline_put(config->m_baseline, key, stats);
+        if (atf_is_error(err))
+            return err;
+        return atf_dynstr_init_fmt(msg, "%s: median %.1f ns, deviation "
+            "%.1f ns; recorded in %s", key, stats->m_median, stats->m_mad,
+            config->m_baseline);
+    }
+
+    err = atf_perf_baseline_get(config->m_baseline, key, &found, &baseline);
+    if (atf_is_error(err))
+        return err;
+    if (!found)
+        return atf_dynstr_init_fmt(msg, "%s: median %.1f ns, deviation "
+            "%.1f ns; no entry in %s", key, stats->m_median, stats->m_mad,
+            config->m_baseline);
+
+    const double limit = baseline.m_median * (1 + config->m_tolerance) +
+        baseline.m_mad * NOISE_MADS;
+    *regressed = stats->m_median > limit;
+    return atf_dynstr_init_fmt(msg, "%s: median %.1f ns %s the limit of "
+        "%.1f ns (baseline %.1f ns, deviation %.1f ns, tolerance %.0f%%)",
+        key, stats->m_median, *regressed ? "exceeds" : "is within", limit,
+        baseline.m_median, baseline.m_mad, config->m_tolerance * 100);
+}
@@ -0,0 +1,79 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_PERF_H)
+#define ATF_C_DETAIL_PERF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <atf-c/detail/dynstr.h>
+#include <atf-c/error_fwd.h>
+
+/* ---------------------------------------------------------------------
+ * The "atf_perf_config" type.
+ * --------------------------------------------------------------------- */
+
+/* Settings of the performance checks, given by the perf.* variables.
+ * The baseline path is not copied and must outlive the object. */
+struct atf_perf_config {
+    const char *m_baseline;
+    bool m_record;
+    double m_tolerance;
+    long m_samples;
+};
+typedef struct atf_perf_config atf_perf_config_t;
+
+void atf_perf_config_init(atf_perf_config_t *);
+atf_error_t atf_perf_config_set(atf_perf_config_t *, const char *,
+                                const char *);
+
+/* ---------------------------------------------------------------------
+ * The "atf_perf_stats" type.
+ * --------------------------------------------------------------------- */
+
+/* Summary of the samples of a measurement, in nanoseconds. */
+struct atf_perf_stats {
+    double m_median;
+    double m_mad;
+};
+typedef struct atf_perf_stats atf_perf_stats_t;
+
+void atf_perf_stats_compute(atf_perf_stats_t *, double *, const size_t);
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+atf_error_t atf_perf_baseline_get(const char *, const char *, bool *,
+                                  atf_perf_stats_t *);
+atf_error_t atf_perf_baseline_put(const char *, const char *,
+                                  const atf_perf_stats_t *);
+void atf_perf_sort(double *, const size_t);
+atf_error_t atf_perf_evaluate(const atf_perf_config_t *, const char *,
+                              const atf_perf_stats_t *, bool *,
+                              atf_dynstr_t *);
+
+#endif /* !defined(ATF_C_DETAIL_PERF_H) */
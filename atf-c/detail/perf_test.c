@@ -0,0 +1,208 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/perf.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/test_helpers.h"
+#include "atf-c/utils.h"
+
+/* ---------------------------------------------------------------------
+ * Tests for the "atf_perf_config" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(config_set);
+ATF_TC_BODY(config_set, tc)
+{
+    atf_perf_config_t config;
+
+    atf_perf_config_init(&config);
+    ATF_REQUIRE(config.m_baseline == NULL);
+    ATF_REQUIRE(!config.m_record);
+
+    RE(atf_perf_config_set(&config, "perf.baseline", "the-file"));
+    ATF_REQUIRE_STREQ("the-file", config.m_baseline);
+    RE(atf_perf_config_set(&config, "perf.baseline", ""));
+    ATF_REQUIRE(config.m_baseline == NULL);
+
+    RE(atf_perf_config_set(&config, "perf.record", "yes"));
+    ATF_REQUIRE(config.m_record);
+
+    RE(atf_perf_config_set(&config, "perf.tolerance", "25"));
+    ATF_REQUIRE(config.m_tolerance > 0.249 && config.m_tolerance < 0.251);
+
+    RE(atf_perf_config_set(&config, "perf.samples", "3"));
+    ATF_REQUIRE_EQ(3, config.m_samples);
+}
+
+ATF_TC_WITHOUT_HEAD(config_set_invalid);
+ATF_TC_BODY(config_set_invalid, tc)
+{
+    atf_perf_config_t config;
+    atf_error_t err;
+
+    atf_perf_config_init(&config);
+
+    err = atf_perf_config_set(&config, "perf.record", "maybe");
+    ATF_REQUIRE(atf_is_error(err));
+    atf_error_free(err);
+
+    err = atf_perf_config_set(&config, "perf.tolerance", "-1");
+    ATF_REQUIRE(atf_is_error(err));
+    atf_error_free(err);
+
+    err = atf_perf_config_set(&config, "perf.samples", "0");
+    ATF_REQUIRE(atf_is_error(err));
+    atf_error_free(err);
+
+    err = atf_perf_config_set(&config, "perf.unknown", "1");
+    ATF_REQUIRE(atf_is_error(err));
+    atf_error_free(err);
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the "atf_perf_stats" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(stats_compute);
+ATF_TC_BODY(stats_compute, tc)
+{
+    double odd[] = { 30, 10, 20, 100, 25 };
+    double even[] = { 4, 1, 3, 2 };
+    atf_perf_stats_t stats;
+
+    atf_perf_stats_compute(&stats, odd, 5);
+    ATF_REQUIRE_EQ(25, stats.m_median);
+    ATF_REQUIRE_EQ(5, stats.m_mad);
+
+    atf_perf_stats_compute(&stats, even, 4);
+    ATF_REQUIRE_EQ(2.5, stats.m_median);
+    ATF_REQUIRE_EQ(1, stats.m_mad);
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(baseline_get_missing);
+ATF_TC_BODY(baseline_get_missing, tc)
+{
+    atf_perf_stats_t stats;
+    bool found;
+
+    RE(atf_perf_baseline_get("missing", "key", &found, &stats));
+    ATF_REQUIRE(!found);
+
+    atf_utils_create_file("baseline", "other 1.0 2.0\nkey2 3.0 4.0\n");
+    RE(atf_perf_baseline_get("baseline", "key", &found, &stats));
+    ATF_REQUIRE(!found);
+}
+
+ATF_TC_WITHOUT_HEAD(baseline_put_get);
+ATF_TC_BODY(baseline_put_get, tc)
+{
+    const atf_perf_stats_t first = { 100.0, 5.0 }, second = { 200.0, 7.5 };
+    atf_perf_stats_t stats;
+    bool found;
+
+    atf_utils_create_file("baseline", "# Comment\nother 1.0 2.0\n");
+
+    RE(atf_perf_baseline_put("baseline", "tc/key", &first));
+    RE(atf_perf_baseline_get("baseline", "tc/key", &found, &stats));
+    ATF_REQUIRE(found);
+    ATF_REQUIRE_EQ(100.0, stats.m_median);
+    ATF_REQUIRE_EQ(5.0, stats.m_mad);
+
+    RE(atf_perf_baseline_put("baseline", "tc/key", &second));
+    ATF_REQUIRE(atf_utils_compare_file("baseline",
+        "# Comment\nother 1.0 2.0\ntc/key 200.0 7.5\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(evaluate);
+ATF_TC_BODY(evaluate, tc)
+{
+    const atf_perf_stats_t baseline = { 1000.0, 0.0 };
+    atf_perf_stats_t stats = { 1050.0, 10.0 };
+    atf_perf_config_t config;
+    atf_dynstr_t msg;
+    bool regressed;
+
+    atf_perf_config_init(&config);
+    RE(atf_perf_evaluate(&config, "key", &stats, &regressed, &msg));
+    ATF_REQUIRE(!regressed);
+    ATF_REQUIRE(atf_utils_grep_string("no baseline configured",
+                                      atf_dynstr_cstring(&msg)));
+    atf_dynstr_fini(&msg);
+
+    config.m_baseline = "baseline";
+    RE(atf_perf_evaluate(&config, "key", &stats, &regressed, &msg));
+    ATF_REQUIRE(!regressed);
+    ATF_REQUIRE(atf_utils_grep_string("no entry in baseline",
+                                      atf_dynstr_cstring(&msg)));
+    atf_dynstr_fini(&msg);
+
+    RE(atf_perf_baseline_put("baseline", "key", &baseline));
+    RE(atf_perf_evaluate(&config, "key", &stats, &regressed, &msg));
+    ATF_REQUIRE(!regressed);
+    ATF_REQUIRE(atf_utils_grep_string("is within the limit of 1100.0 ns",
+                                      atf_dynstr_cstring(&msg)));
+    atf_dynstr_fini(&msg);
+
+    stats.m_median = 1150.0;
+    RE(atf_perf_evaluate(&config, "key", &stats, &regressed, &msg));
+    ATF_REQUIRE(regressed);
+    ATF_REQUIRE(atf_utils_grep_string("exceeds the limit of 1100.0 ns",
+                                      atf_dynstr_cstring(&msg)));
+    atf_dynstr_fini(&msg);
+
+    config.m_record = true;
+    RE(atf_perf_evaluate(&config, "key", &stats, &regressed, &msg));
+    ATF_REQUIRE(!regressed);
+    atf_dynstr_fini(&msg);
+    ATF_REQUIRE(atf_utils_compare_file("baseline", "key 1150.0 10.0\n"));
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, config_set);
+    ATF_TP_ADD_TC(tp, config_set_invalid);
+
+    ATF_TP_ADD_TC(tp, stats_compute);
+
+    ATF_TP_ADD_TC(tp, baseline_get_missing);
+    ATF_TP_ADD_TC(tp, baseline_put_get);
+    ATF_TP_ADD_TC(tp, evaluate);
+
+    return atf_no_error();
+}
@@ -30,14 +30,18 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "atf-c/defs.h"
 #include "atf-c/detail/sanity.h"
+#include "atf-c/detail/trace.h"
 #include "atf-c/error.h"
 
 /* This prototype is not in the header file because this is a private
@@ -271,7 +275,10 @@ atf_process_child_wait(atf_process_child_t *c, atf_process_status_t *s)
     atf_error_t err;
     int status;
 
-    if (waitpid(c->m_pid, &status, 0) == -1)
+    atf_trace_begin("wait", NULL);
+    const int ret = waitpid(c->m_pid, &status, 0);
+    atf_trace_end("wait");
+    if (ret == -1)
         err = atf_libc_error(errno, "Failed waiting for process %d",
                              c->m_pid);
     else {
@@ -302,6 +309,175 @@ atf_process_child_stderr(atf_process_child_t *c)
     return c->m_stderr;
 }
 
+/* ---------------------------------------------------------------------
+ * The "atf_process_capture" type.
+ * --------------------------------------------------------------------- */
+
+/* Size of the buffer used to read from the captured streams; large
+ * enough to empty a full pipe in a single call on most systems. */
+static const size_t capture_buffer_size = 64 * 1024;
+
+atf_error_t
+atf_process_capture_init(atf_process_capture_t *cap,
+                         atf_process_capture_func_t func, void *data)
+{
+    cap->m_func = func;
+    cap->m_data = data;
+    cap->m_limit = 0;
+    cap->m_timeout = -1;
+    cap->m_stdout_size = 0;
+    cap->m_stderr_size = 0;
+
+    return atf_no_error();
+}
+
+void
+atf_process_capture_fini(atf_process_capture_t *cap ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+}
+
+/* Sets the maximum amount of bytes of each stream that are passed to the
+ * capture function; anything beyond that is read and discarded so that
+ * the child never blocks on a full pipe.  Zero means no limit. */
+void
+atf_process_capture_set_limit(atf_process_capture_t *cap, const size_t limit)
+{
+    cap->m_limit = limit;
+}
+
+/* Sets the maximum time, in milliseconds, to wait for the child to close
+ * its captured streams.  A negative value means to wait forever. */
+void
+atf_process_capture_set_timeout(atf_process_capture_t *cap, const int timeout)
+{
+    cap->m_timeout = timeout;
+}
+
+bool
+atf_process_capture_truncated(const atf_process_capture_t *cap, const int fd)
+{
+    PRE(fd == STDOUT_FILENO || fd == STDERR_FILENO);
+
+    if (cap->m_limit == 0)
+        return false;
+    else if (fd == STDOUT_FILENO)
+        return cap->m_stdout_size > cap->m_limit;
+    else
+        return cap->m_stderr_size > cap->m_limit;
+}
+
+static
+atf_error_t
+capture_deliver(atf_process_capture_t *cap, const int fd, size_t *size,
+                const char *buf, const size_t length)
+{
+    size_t wanted;
+
+    if (cap->m_limit == 0)
+        wanted = length;
+    else if (*size >= cap->m_limit)
+        wanted = 0;
+    else if (length > cap->m_limit - *size)
+        wanted = cap->m_limit - *size;
+    else
+        wanted = length;
+    *size += length;
+
+    if (wanted == 0 || cap->m_func == NULL)
+        return atf_no_error();
+    return cap->m_func(fd, buf, wanted, cap->m_data);
+}
+
+static
+long
+elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 +
+        (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/* Reads the captured stdout and stderr of the child concurrently until
+ * the child closes both of them, handing the data to the capture
+ * function as it arrives.  Streams that were not captured are ignored.
+ * Returns ETIMEDOUT if the timeout expires first; the caller is then
+ * responsible for terminating the child. */
+atf_error_t
+atf_process_child_capture(atf_process_child_t *c, atf_process_capture_t *cap)
+{
+    atf_error_t err;
+    struct pollfd fds[2];
+    const int targets[2] = { STDOUT_FILENO, STDERR_FILENO };
+    size_t *sizes[2];
+    struct timespec start;
+    char *buf;
+    int i, open;
+
+    buf = malloc(capture_buffer_size);
+    if (buf == NULL)
+        return atf_no_memory_error();
+
+    fds[0].fd = c->m_stdout;
+    fds[1].fd = c->m_stderr;
+    sizes[0] = &cap->m_stdout_size;
+    sizes[1] = &cap->m_stderr_size;
+    open = 0;
+    for (i = 0; i < 2; i++) {
+        fds[i].events = POLLIN;
+        if (fds[i].fd != -1)
+            open++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    err = atf_no_error();
+    while (!atf_is_error(err) && open > 0) {
+        int timeout, ret;
+
+        if (cap->m_timeout < 0)
+            timeout = -1;
+        else {
+            const long left = cap->m_timeout - elapsed_ms(&start);
+            timeout = left < 0 ? 0 : (int)left;
+        }
+
+        ret = poll(fds, 2, timeout);
+        if (ret == -1) {
+            if (errno != EINTR)
+                err = atf_libc_error(errno, "Failed to poll the output of "
+                                     "process %d", c->m_pid);
+            continue;
+        } else if (ret == 0) {
+            err = atf_libc_error(ETIMEDOUT, "Timed out reading the output "
+                                 "of process %d", c->m_pid);
+            continue;
+        }
+
+        for (i = 0; i < 2 && !atf_is_error(err); i++) {
+            ssize_t n;
+
+            if (fds[i].fd == -1 || fds[i].revents == 0)
+                continue;
+
+            n = read(fds[i].fd, buf, capture_buffer_size);
+            if (n == -1) {
+                if (errno != EINTR && errno != EAGAIN)
+                    err = atf_libc_error(errno, "Failed to read the output "
+                                         "of process %d", c->m_pid);
+            } else if (n == 0) {
+                fds[i].fd = -1;
+                open--;
+            } else
+                err = capture_deliver(cap, targets[i], sizes[i], buf,
+                                      (size_t)n);
+        }
+    }
+
+    free(buf);
+    return err;
+}
+
 /* ---------------------------------------------------------------------
  * Free functions.
  * --------------------------------------------------------------------- */
@@ -469,8 +645,10 @@ fork_with_streams(atf_process_child_t *c,
     if (atf_is_error(err))
         goto err_outpipe;
 
+    atf_trace_begin("fork", NULL);
     pid = fork();
     if (pid == -1) {
+        atf_trace_end("fork");
         err = atf_libc_error(errno, "Failed to fork");
         goto err_errpipe;
     }
@@ -481,6 +659,7 @@ fork_with_streams(atf_process_child_t *c,
         abort();
         err = atf_no_error();
     } else {
+        atf_trace_end("fork");
         err = do_parent(c, pid, &outsp, &errsp);
         if (atf_is_error(err))
             goto err_errpipe;
@@ -601,6 +780,7 @@ do_exec(void *v)
     if (ea->m_prehook != NULL)
         ea->m_prehook();
 
+    atf_trace_instant("exec", atf_fs_path_cstring(ea->m_prog));
     const int ret = const_execvp(atf_fs_path_cstring(ea->m_prog), ea->m_argv);
     const int errnocopy = errno;
     INV(ret == -1);
@@ -642,6 +822,58 @@ out:
     return err;
 }
 
+/* Runs the given program capturing its stdout and stderr through 'cap'
+ * and waits for it.  If the capture fails (e.g. because it times out),
+ * the program is killed and the capture error is returned. */
+atf_error_t
+atf_process_exec_capture(atf_process_status_t *s,
+                         const atf_fs_path_t *prog,
+                         const char *const *argv,
+                         atf_process_capture_t *cap,
+                         void (*prehook)(void))
+{
+    atf_error_t err, capture_err;
+    atf_process_child_t c;
+    atf_process_stream_t outsb, errsb;
+    struct exec_args ea = { prog, argv, prehook };
+
+    err = atf_process_stream_init_capture(&outsb);
+    if (atf_is_error(err))
+        goto out;
+
+    err = atf_process_stream_init_capture(&errsb);
+    if (atf_is_error(err))
+        goto out_outsb;
+
+    err = atf_process_fork(&c, do_exec, &outsb, &errsb, &ea);
+    if (atf_is_error(err))
+        goto out_errsb;
+
+    capture_err = atf_process_child_capture(&c, cap);
+    if (atf_is_error(capture_err))
+        kill(atf_process_child_pid(&c), SIGKILL);
+
+again:
+    err = atf_process_child_wait(&c, s);
+    if (atf_is_error(err)) {
+        INV(atf_error_is(err, "libc") && atf_libc_error_code(err) == EINTR);
+        atf_error_free(err);
+        goto again;
+    }
+
+    if (atf_is_error(capture_err)) {
+        atf_process_status_fini(s);
+        err = capture_err;
+    }
+
+out_errsb:
+    atf_process_stream_fini(&errsb);
+out_outsb:
+    atf_process_stream_fini(&outsb);
+out:
+    return err;
+}
+
 atf_error_t
 atf_process_exec_list(atf_process_status_t *s,
                       const atf_fs_path_t *prog,
@@ -106,6 +106,37 @@ pid_t atf_process_child_pid(const atf_process_child_t *);
 int atf_process_child_stdout(atf_process_child_t *);
 int atf_process_child_stderr(atf_process_child_t *);
 
+/* ---------------------------------------------------------------------
+ * The "atf_process_capture" type.
+ * --------------------------------------------------------------------- */
+
+typedef atf_error_t (*atf_process_capture_func_t)(const int, const char *,
+                                                  const size_t, void *);
+
+struct atf_process_capture {
+    atf_process_capture_func_t m_func;
+    void *m_data;
+
+    size_t m_limit;
+    int m_timeout;
+
+    size_t m_stdout_size;
+    size_t m_stderr_size;
+};
+typedef struct atf_process_capture atf_process_capture_t;
+
+atf_error_t atf_process_capture_init(atf_process_capture_t *,
+                                     atf_process_capture_func_t, void *);
+void atf_process_capture_fini(atf_process_capture_t *);
+
+void atf_process_capture_set_limit(atf_process_capture_t *, const size_t);
+void atf_process_capture_set_timeout(atf_process_capture_t *, const int);
+bool atf_process_capture_truncated(const atf_process_capture_t *,
+                                   const int);
+
+atf_error_t atf_process_child_capture(atf_process_child_t *,
+                                      atf_process_capture_t *);
+
 /* ---------------------------------------------------------------------
  * Free functions.
  * --------------------------------------------------------------------- */
@@ -121,6 +152,11 @@ atf_error_t atf_process_exec_array(atf_process_status_t *,
                                    const atf_process_stream_t *,
                                    const atf_process_stream_t *,
                                    void (*)(void));
+atf_error_t atf_process_exec_capture(atf_process_status_t *,
+                                     const atf_fs_path_t *,
+                                     const char *const *,
+                                     atf_process_capture_t *,
+                                     void (*)(void));
 atf_error_t atf_process_exec_list(atf_process_status_t *,
                                   const atf_fs_path_t *,
                                   const atf_list_t *,
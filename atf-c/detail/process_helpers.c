@@ -63,6 +63,31 @@ h_exit_success(void)
     return EXIT_SUCCESS;
 }
 
+static
+int
+h_hang(void)
+{
+    sleep(60);
+    return EXIT_SUCCESS;
+}
+
+static
+int
+h_large_output(const char *length)
+{
+    const long total = atol(length);
+    long i;
+
+    /* Fill stderr first so that a parent reading the two streams one
+     * after the other would deadlock. */
+    for (i = 0; i < total; i++)
+        fputc('e', stderr);
+    for (i = 0; i < total; i++)
+        fputc('o', stdout);
+
+    return EXIT_SUCCESS;
+}
+
 static
 int
 h_stdout_stderr(const char *id)
@@ -101,7 +126,12 @@ main(int argc, const char *const argv[])
         exitcode = h_exit_signal();
     else if (strcmp(argv[1], "exit-success") == 0)
         exitcode = h_exit_success();
-    else if (strcmp(argv[1], "stdout-stderr") == 0) {
+    else if (strcmp(argv[1], "hang") == 0)
+        exitcode = h_hang();
+    else if (strcmp(argv[1], "large-output") == 0) {
+        check_args(argc, argv, 3);
+        exitcode = h_large_output(argv[2]);
+    } else if (strcmp(argv[1], "stdout-stderr") == 0) {
         check_args(argc, argv, 3);
         exitcode = h_stdout_stderr(argv[2]);
     } else {
@@ -883,6 +883,129 @@ check_line(int fd, const char *exp)
     free(line);
 }
 
+struct capture_counts {
+    size_t m_out;
+    size_t m_err;
+    bool m_bad_data;
+};
+
+static
+atf_error_t
+count_output(const int fd, const char *buf, const size_t length, void *data)
+{
+    struct capture_counts *counts = data;
+    const char expected = (fd == STDOUT_FILENO) ? 'o' : 'e';
+    size_t i;
+
+    for (i = 0; i < length; i++)
+        if (buf[i] != expected)
+            counts->m_bad_data = true;
+    if (fd == STDOUT_FILENO)
+        counts->m_out += length;
+    else
+        counts->m_err += length;
+    return atf_no_error();
+}
+
+static
+atf_error_t
+exec_capture(const atf_tc_t *tc, const char *helper, const char *arg,
+             atf_process_capture_t *cap, atf_process_status_t *s)
+{
+    atf_fs_path_t process_helpers;
+    const char *argv[4];
+    atf_error_t err;
+
+    get_process_helpers_path(tc, true, &process_helpers);
+
+    argv[0] = atf_fs_path_cstring(&process_helpers);
+    argv[1] = helper;
+    argv[2] = arg;
+    argv[3] = NULL;
+    printf("Executing %s %s\n", argv[0], argv[1]);
+
+    err = atf_process_exec_capture(s, &process_helpers, argv, cap, NULL);
+    atf_fs_path_fini(&process_helpers);
+    return err;
+}
+
+ATF_TC(exec_capture_large);
+ATF_TC_HEAD(exec_capture_large, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_process_exec_capture "
+                      "drains stdout and stderr concurrently");
+    atf_tc_set_md_var(tc, "timeout", "60");
+}
+ATF_TC_BODY(exec_capture_large, tc)
+{
+    struct capture_counts counts = { 0, 0, false };
+    atf_process_capture_t cap;
+    atf_process_status_t status;
+
+    RE(atf_process_capture_init(&cap, count_output, &counts));
+    RE(exec_capture(tc, "large-output", "1048576", &cap, &status));
+    ATF_CHECK(atf_process_status_exited(&status));
+    ATF_CHECK_EQ(EXIT_SUCCESS, atf_process_status_exitstatus(&status));
+    atf_process_status_fini(&status);
+
+    ATF_CHECK_EQ(1048576, counts.m_out);
+    ATF_CHECK_EQ(1048576, counts.m_err);
+    ATF_CHECK(!counts.m_bad_data);
+    ATF_CHECK(!atf_process_capture_truncated(&cap, STDOUT_FILENO));
+    ATF_CHECK(!atf_process_capture_truncated(&cap, STDERR_FILENO));
+    atf_process_capture_fini(&cap);
+}
+
+ATF_TC(exec_capture_limit);
+ATF_TC_HEAD(exec_capture_limit, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_process_exec_capture "
+                      "discards the output beyond the limit");
+}
+ATF_TC_BODY(exec_capture_limit, tc)
+{
+    struct capture_counts counts = { 0, 0, false };
+    atf_process_capture_t cap;
+    atf_process_status_t status;
+
+    RE(atf_process_capture_init(&cap, count_output, &counts));
+    atf_process_capture_set_limit(&cap, 1000);
+    RE(exec_capture(tc, "large-output", "300000", &cap, &status));
+    ATF_CHECK(atf_process_status_exited(&status));
+    ATF_CHECK_EQ(EXIT_SUCCESS, atf_process_status_exitstatus(&status));
+    atf_process_status_fini(&status);
+
+    ATF_CHECK_EQ(1000, counts.m_out);
+    ATF_CHECK_EQ(1000, counts.m_err);
+    ATF_CHECK(!counts.m_bad_data);
+    ATF_CHECK(atf_process_capture_truncated(&cap, STDOUT_FILENO));
+    ATF_CHECK(atf_process_capture_truncated(&cap, STDERR_FILENO));
+    atf_process_capture_fini(&cap);
+}
+
+ATF_TC(exec_capture_timeout);
+ATF_TC_HEAD(exec_capture_timeout, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_process_exec_capture "
+                      "kills the child when the timeout expires");
+    atf_tc_set_md_var(tc, "timeout", "30");
+}
+ATF_TC_BODY(exec_capture_timeout, tc)
+{
+    atf_process_capture_t cap;
+    atf_process_status_t status;
+    atf_error_t err;
+
+    RE(atf_process_capture_init(&cap, NULL, NULL));
+    atf_process_capture_set_timeout(&cap, 100);
+    err = exec_capture(tc, "hang", NULL, &cap, &status);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_REQUIRE_EQ(ETIMEDOUT, atf_libc_error_code(err));
+    atf_error_free(err);
+    atf_process_capture_fini(&cap);
+}
+
 ATF_TC(exec_failure);
 ATF_TC_HEAD(exec_failure, tc)
 {
@@ -1113,6 +1236,9 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, child_wait_eintr);
 
     /* Add the tests for the free functions. */
+    ATF_TP_ADD_TC(tp, exec_capture_large);
+    ATF_TP_ADD_TC(tp, exec_capture_limit);
+    ATF_TP_ADD_TC(tp, exec_capture_timeout);
     ATF_TP_ADD_TC(tp, exec_failure);
     ATF_TP_ADD_TC(tp, exec_list);
     ATF_TP_ADD_TC(tp, exec_prehook);
@@ -0,0 +1,474 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/repeat.h"
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/perf.h"
+#include "atf-c/detail/runner.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+/* The outcomes that a run can record, as the first word of its result.
+ * The last one stands for the runs that did not record any. */
+static const char *const outcomes[] = {
+    "passed", "failed", "skipped", "expected_death", "expected_exit",
+    "expected_failure", "expected_signal", "expected_timeout", "broken",
+};
+#define NOUTCOMES (sizeof(outcomes) / sizeof(outcomes[0]))
+#define BROKEN (NOUTCOMES - 1)
+
+struct samples {
+    double *m_wall;
+    double *m_cpu;
+    size_t m_count;
+    size_t m_size;
+};
+
+static
+double
+cpu_seconds(const struct rusage *ru)
+{
+    return (double)ru->ru_utime.tv_sec + (double)ru->ru_utime.tv_usec / 1e6 +
+        (double)ru->ru_stime.tv_sec + (double)ru->ru_stime.tv_usec / 1e6;
+}
+
+static
+atf_error_t
+samples_append(struct samples *s, const double wall, const double cpu)
+{
+    if (s->m_count == s->m_size) {
+        const size_t size = s->m_size == 0 ? 64 : s->m_size * 2;
+        double *wallbuf, *cpubuf;
+
+        wallbuf = realloc(s->m_wall, size * sizeof(*wallbuf));
+        if (wallbuf == NULL)
+            return atf_no_memory_error();
+        s->m_wall = wallbuf;
+
+        cpubuf = realloc(s->m_cpu, size * sizeof(*cpubuf));
+        if (cpubuf == NULL)
+            return atf_no_memory_error();
+        s->m_cpu = cpubuf;
+
+        s->m_size = size;
+    }
+
+    s->m_wall[s->m_count] = wall;
+    s->m_cpu[s->m_count] = cpu;
+    s->m_count++;
+    return atf_no_error();
+}
+
+/** Waits for a child, retrying if interrupted. */
+static
+atf_error_t
+wait_child(const pid_t pid, int *status)
+{
+    while (waitpid(pid, status, 0) == -1) {
+        if (errno != EINTR)
+            return atf_libc_error(errno, "Failed to wait for the run of "
+                                  "the test case");
+    }
+    return atf_no_error();
+}
+
+static
+atf_error_t
+spawn(pid_t *pid)
+{
+    *pid = atf_runner_fork();
+    if (*pid == -1)
+        return atf_libc_error(errno, "Failed to spawn a run of the test "
+                              "case");
+    return atf_no_error();
+}
+
+/** Runs the body once and measures the wall and CPU time it took.
+ *
+ * The CPU time is that of the terminated children of the process, which
+ * only grows by the run being waited for.
+ */
+static
+atf_error_t
+run_body(atf_repeat_body_t body, void *data, const char *resfile,
+         double *wall, double *cpu)
+{
+    struct rusage before, after;
+    atf_error_t err;
+    double start;
+    pid_t pid;
+    int status;
+
+    getrusage(RUSAGE_CHILDREN, &before);
+    start = atf_runner_monotonic_seconds();
+    err = spawn(&pid);
+    if (atf_is_error(err)) {
+        *wall = *cpu = 0.0;
+        return err;
+    } else if (pid == 0) {
+        body(data, resfile);
+        exit(EXIT_SUCCESS);
+    }
+
+    err = wait_child(pid, &status);
+    *wall = atf_runner_monotonic_seconds() - start;
+    getrusage(RUSAGE_CHILDREN, &after);
+    *cpu = cpu_seconds(&after) - cpu_seconds(&before);
+    return err;
+}
+
+static
+atf_error_t
+run_cleanup(atf_repeat_cleanup_t cleanup, void *data)
+{
+    atf_error_t err;
+    pid_t pid;
+    int status;
+
+    err = spawn(&pid);
+    if (atf_is_error(err))
+        return err;
+    else if (pid == 0) {
+        cleanup(data);
+        exit(EXIT_SUCCESS);
+    }
+
+    return wait_child(pid, &status);
+}
+
+/** Reads the result recorded by a run into last and returns its outcome. */
+static
+size_t
+read_outcome(const char *resfile, atf_dynstr_t *last)
+{
+    char buf[4096];
+    size_t i, length;
+    FILE *f;
+
+    atf_dynstr_clear(last);
+
+    f = fopen(resfile, "r");
+    if (f == NULL)
+        return BROKEN;
+    length = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[length] = '\0';
+
+    if (atf_is_error(atf_dynstr_append_fmt(last, "%s", buf)))
+        return BROKEN;
+
+    for (i = 0; i < BROKEN; i++) {
+        const size_t len = strlen(outcomes[i]);
+
+        if (strncmp(buf, outcomes[i], len) == 0 &&
+            strchr(":(\n", buf[len]) != NULL)
+            return i;
+    }
+    return BROKEN;
+}
+
+/** Prints the distribution of some run times, in milliseconds.
+ *
+ * Percentiles use the nearest-rank method.
+ */
+static
+void
+print_distribution(const char *tcname, const char *what, double *values,
+                   const size_t count)
+{
+    atf_perf_sort(values, count);
+    printf("repeat: %s: %s: min %.3f ms, p50 %.3f ms, p90 %.3f ms, "
+        "p99 %.3f ms, max %.3f ms\n", tcname, what, values[0] * 1e3,
+        values[(count * 50 + 99) / 100 - 1] * 1e3,
+        values[(count * 90 + 99) / 100 - 1] * 1e3,
+        values[(count * 99 + 99) / 100 - 1] * 1e3, values[count - 1] * 1e3);
+}
+
+static
+atf_error_t
+format_counts(atf_dynstr_t *out, const size_t *counts)
+{
+    atf_error_t err;
+    size_t i;
+
+    err = atf_dynstr_init(out);
+    for (i = 0; !atf_is_error(err) && i < NOUTCOMES; i++) {
+        if (counts[i] == 0)
+            continue;
+        err = atf_dynstr_append_fmt(out, "%s%zu %s",
+                                    atf_dynstr_length(out) == 0 ? "" : ", ",
+                                    counts[i], outcomes[i]);
+    }
+    if (atf_is_error(err))
+        atf_dynstr_fini(out);
+    return err;
+}
+
+/** Records the result of the whole series.
+ *
+ * If all runs agree on their outcome, this is the result of the last one;
+ * otherwise the series fails.
+ */
+static
+atf_error_t
+write_result(const char *resfile, const atf_dynstr_t *last,
+             const size_t *counts, const size_t runs, bool *passed)
+{
+    atf_dynstr_t summary;
+    atf_error_t err;
+    size_t i;
+    FILE *f;
+
+    err = format_counts(&summary, counts);
+    if (atf_is_error(err))
+        return err;
+
+    f = atf_runner_open_resfile(resfile);
+    if (f == NULL) {
+        err = atf_libc_error(errno, "Cannot create results file '%s'",
+                             resfile);
+        goto out;
+    }
+
+    for (i = 0; i < NOUTCOMES && counts[i] != runs; i++)
+        continue;
+    if (i < BROKEN) {
+        fprintf(f, "%s", atf_dynstr_cstring(last));
+        *passed = i != 1;
+    } else if (i == BROKEN) {
+        fprintf(f, "failed: None of the %zu runs recorded a result\n", runs);
+        *passed = false;
+    } else {
+        fprintf(f, "failed: The outcome changed across runs: %s\n",
+                atf_dynstr_cstring(&summary));
+        *passed = false;
+    }
+
+    if (atf_runner_close_resfile(f) == EOF)
+        err = atf_libc_error(errno, "Cannot write results file '%s'",
+                             resfile);
+
+out:
+    atf_dynstr_fini(&summary);
+    return err;
+}
+
+static
+atf_error_t
+report(const char *tcname, struct samples *s, const size_t *counts,
+       const double elapsed)
+{
+    atf_dynstr_t summary;
+    atf_error_t err;
+
+    err = format_counts(&summary, counts);
+    if (atf_is_error(err))
+        return err;
+
+    printf("repeat: %s: %zu runs in %.3f s: %s\n", tcname, s->m_count,
+        elapsed, atf_dynstr_cstring(&summary));
+    print_distribution(tcname, "wall time", s->m_wall, s->m_count);
+    print_distribution(tcname, "cpu time", s->m_cpu, s->m_count);
+    fflush(stdout);
+
+    atf_dynstr_fini(&summary);
+    return atf_no_error();
+}
+
+static
+bool
+parse_positive(const char *str, double *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtod(str, &end);
+    return *str != '\0' && *end == '\0' && errno == 0 && isfinite(*value) &&
+        *value > 0;
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_repeat" type.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Constructors/destructors.
+ */
+
+void
+atf_repeat_init(atf_repeat_t *r)
+{
+    r->m_max_runs = 0;
+    r->m_max_seconds = 0;
+}
+
+/*
+ * Getters.
+ */
+
+bool
+atf_repeat_enabled(const atf_repeat_t *r)
+{
+    return r->m_max_runs > 0 || r->m_max_seconds > 0;
+}
+
+/*
+ * Modifiers.
+ */
+
+bool
+atf_repeat_set_runs(atf_repeat_t *r, const char *str)
+{
+    double value;
+
+    if (!parse_positive(str, &value) || value != (size_t)value)
+        return false;
+    r->m_max_runs = (size_t)value;
+    return true;
+}
+
+bool
+atf_repeat_set_duration(atf_repeat_t *r, const char *str)
+{
+    double value;
+
+    if (!parse_positive(str, &value))
+        return false;
+    r->m_max_seconds = value;
+    return true;
+}
+
+/*
+ * Operations.
+ */
+
+/** Runs the test case until either limit is reached, at least once.
+ *
+ * Prints the outcome counts and time distributions to stdout, records the
+ * result of the series in resfile and sets passed to whether the series
+ * did not fail.
+ */
+atf_error_t
+atf_repeat_run(const atf_repeat_t *r, const char *tcname,
+               atf_repeat_body_t body, atf_repeat_cleanup_t cleanup,
+               void *data, const char *resfile, bool *passed)
+{
+    size_t counts[NOUTCOMES] = { 0 };
+    struct samples s = { NULL, NULL, 0, 0 };
+    atf_fs_path_t dir, runfile;
+    atf_dynstr_t last;
+    atf_error_t err;
+    double start;
+
+    PRE(atf_repeat_enabled(r));
+
+    err = atf_fs_path_init_fmt(&dir, "%s/atf-repeat.XXXXXX",
+                               atf_env_get_with_default("TMPDIR", "/tmp"));
+    if (atf_is_error(err))
+        goto out;
+    err = atf_fs_mkdtemp(&dir);
+    if (atf_is_error(err))
+        goto out_dir;
+
+    err = atf_fs_path_copy(&runfile, &dir);
+    if (atf_is_error(err))
+        goto out_rmdir;
+    err = atf_fs_path_append_fmt(&runfile, "result");
+    if (atf_is_error(err))
+        goto out_runfile;
+
+    err = atf_dynstr_init(&last);
+    if (atf_is_error(err))
+        goto out_runfile;
+
+    start = atf_runner_monotonic_seconds();
+    do {
+        double wall, cpu;
+
+        (void)unlink(atf_fs_path_cstring(&runfile));
+        err = run_body(body, data, atf_fs_path_cstring(&runfile), &wall,
+                       &cpu);
+        if (atf_is_error(err))
+            break;
+        counts[read_outcome(atf_fs_path_cstring(&runfile), &last)]++;
+
+        if (cleanup != NULL) {
+            err = run_cleanup(cleanup, data);
+            if (atf_is_error(err))
+                break;
+        }
+
+        err = samples_append(&s, wall, cpu);
+    } while (!atf_is_error(err) &&
+             (r->m_max_runs == 0 || s.m_count < r->m_max_runs) &&
+             (r->m_max_seconds == 0 ||
+              atf_runner_monotonic_seconds() - start < r->m_max_seconds));
+
+    if (!atf_is_error(err))
+        err = report(tcname, &s, counts,
+                     atf_runner_monotonic_seconds() - start);
+    if (!atf_is_error(err))
+        err = write_result(resfile, &last, counts, s.m_count, passed);
+
+    free(s.m_wall);
+    free(s.m_cpu);
+    atf_dynstr_fini(&last);
+out_runfile:
+    atf_fs_path_fini(&runfile);
+out_rmdir:
+    {
+        atf_error_t err2 = atf_fs_rmtree(&dir);
+        if (atf_is_error(err2)) {
+            if (atf_is_error(err))
+                atf_error_free(err2);
+            else
+                err = err2;
+        }
+    }
+out_dir:
+    atf_fs_path_fini(&dir);
+out:
+    return err;
+}
@@ -0,0 +1,69 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_REPEAT_H)
+#define ATF_C_DETAIL_REPEAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <atf-c/error_fwd.h>
+
+/* Runs a test case over and over, each time in a fresh child of the test
+ * program, and reports the distribution of the wall and CPU times of the
+ * runs and the outcomes they recorded.  Backs the -n and -d flags of the
+ * test programs of all languages. */
+
+struct atf_repeat {
+    size_t m_max_runs;
+    double m_max_seconds;
+};
+typedef struct atf_repeat atf_repeat_t;
+
+/* Runs the test case body, writing its result to the given file.  Called
+ * in the child process, which exits with success if the function
+ * returns. */
+typedef void (*atf_repeat_body_t)(void *, const char *);
+
+/* Runs the test case cleanup.  Also called in a child process, after every
+ * run of the body, and not timed. */
+typedef void (*atf_repeat_cleanup_t)(void *);
+
+/* Constructors/destructors. */
+void atf_repeat_init(atf_repeat_t *);
+
+/* Getters. */
+bool atf_repeat_enabled(const atf_repeat_t *);
+
+/* Modifiers; return false if the argument is not a positive number. */
+bool atf_repeat_set_runs(atf_repeat_t *, const char *);
+bool atf_repeat_set_duration(atf_repeat_t *, const char *);
+
+/* Operations. */
+atf_error_t atf_repeat_run(const atf_repeat_t *, const char *,
+                           atf_repeat_body_t, atf_repeat_cleanup_t, void *,
+                           const char *, bool *);
+
+#endif /* !defined(ATF_C_DETAIL_REPEAT_H) */
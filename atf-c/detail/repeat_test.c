@@ -0,0 +1,223 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/repeat.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+body_pass(void *data ATF_DEFS_ATTRIBUTE_UNUSED, const char *resfile)
+{
+    atf_utils_create_file(resfile, "passed\n");
+}
+
+/* Fails every other run, which needs a marker file because each run
+ * starts off the same state in a new process. */
+static
+void
+body_flaky(void *data ATF_DEFS_ATTRIBUTE_UNUSED, const char *resfile)
+{
+    if (access("marker", F_OK) == -1) {
+        atf_utils_create_file("marker", "%s", "");
+        atf_utils_create_file(resfile, "failed: First try\n");
+    } else {
+        unlink("marker");
+        atf_utils_create_file(resfile, "passed\n");
+    }
+}
+
+static
+void
+body_crash(void *data ATF_DEFS_ATTRIBUTE_UNUSED,
+           const char *resfile ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    abort();
+}
+
+static
+void
+cleanup_count(void *data ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    FILE *f = fopen("cleanups", "a");
+
+    if (f != NULL) {
+        fprintf(f, "x\n");
+        fclose(f);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the "atf_repeat" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(set_runs);
+ATF_TC_BODY(set_runs, tc)
+{
+    atf_repeat_t repeat;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(!atf_repeat_enabled(&repeat));
+
+    ATF_REQUIRE(atf_repeat_set_runs(&repeat, "25"));
+    ATF_REQUIRE_EQ(25, repeat.m_max_runs);
+    ATF_REQUIRE(atf_repeat_enabled(&repeat));
+
+    ATF_REQUIRE(!atf_repeat_set_runs(&repeat, ""));
+    ATF_REQUIRE(!atf_repeat_set_runs(&repeat, "0"));
+    ATF_REQUIRE(!atf_repeat_set_runs(&repeat, "-3"));
+    ATF_REQUIRE(!atf_repeat_set_runs(&repeat, "1.5"));
+    ATF_REQUIRE(!atf_repeat_set_runs(&repeat, "7x"));
+    ATF_REQUIRE_EQ(25, repeat.m_max_runs);
+}
+
+ATF_TC_WITHOUT_HEAD(set_duration);
+ATF_TC_BODY(set_duration, tc)
+{
+    atf_repeat_t repeat;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_duration(&repeat, "0.25"));
+    ATF_REQUIRE(repeat.m_max_seconds == 0.25);
+    ATF_REQUIRE(atf_repeat_enabled(&repeat));
+
+    ATF_REQUIRE(!atf_repeat_set_duration(&repeat, "0"));
+    ATF_REQUIRE(!atf_repeat_set_duration(&repeat, "-1"));
+    ATF_REQUIRE(!atf_repeat_set_duration(&repeat, "nan"));
+    ATF_REQUIRE(!atf_repeat_set_duration(&repeat, "5s"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_pass);
+ATF_TC_BODY(run_pass, tc)
+{
+    atf_repeat_t repeat;
+    bool passed;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_runs(&repeat, "5"));
+    RE(atf_repeat_run(&repeat, "the_tc", body_pass, cleanup_count, NULL,
+                      "result", &passed));
+    ATF_REQUIRE(passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "passed\n"));
+    ATF_REQUIRE(atf_utils_compare_file("cleanups", "x\nx\nx\nx\nx\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_flaky);
+ATF_TC_BODY(run_flaky, tc)
+{
+    atf_repeat_t repeat;
+    bool passed;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_runs(&repeat, "4"));
+    RE(atf_repeat_run(&repeat, "the_tc", body_flaky, NULL, NULL, "result",
+                      &passed));
+    ATF_REQUIRE(!passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "failed: The outcome "
+        "changed across runs: 2 passed, 2 failed\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_crash);
+ATF_TC_BODY(run_crash, tc)
+{
+    atf_repeat_t repeat;
+    bool passed;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_runs(&repeat, "2"));
+    RE(atf_repeat_run(&repeat, "the_tc", body_crash, NULL, NULL, "result",
+                      &passed));
+    ATF_REQUIRE(!passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "failed: None of the 2 "
+        "runs recorded a result\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_duration);
+ATF_TC_BODY(run_duration, tc)
+{
+    atf_repeat_t repeat;
+    bool passed;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_duration(&repeat, "0.2"));
+    RE(atf_repeat_run(&repeat, "the_tc", body_pass, NULL, NULL, "result",
+                      &passed));
+    ATF_REQUIRE(passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "passed\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_report);
+ATF_TC_BODY(run_report, tc)
+{
+    atf_repeat_t repeat;
+    bool passed;
+    pid_t pid;
+
+    atf_repeat_init(&repeat);
+    ATF_REQUIRE(atf_repeat_set_runs(&repeat, "3"));
+    pid = atf_utils_fork();
+    if (pid == 0) {
+        RE(atf_repeat_run(&repeat, "the_tc", body_pass, NULL, NULL,
+                          "result", &passed));
+        exit(EXIT_SUCCESS);
+    }
+    atf_utils_wait(pid, EXIT_SUCCESS, "save:out", "");
+
+    ATF_CHECK(atf_utils_grep_file("^repeat: the_tc: 3 runs in [0-9.]+ s: "
+        "3 passed$", "out"));
+    ATF_CHECK(atf_utils_grep_file("^repeat: the_tc: wall time: min [0-9.]+ "
+        "ms, p50 [0-9.]+ ms, p90 [0-9.]+ ms, p99 [0-9.]+ ms, max [0-9.]+ "
+        "ms$", "out"));
+    ATF_CHECK(atf_utils_grep_file("^repeat: the_tc: cpu time: min ", "out"));
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, set_runs);
+    ATF_TP_ADD_TC(tp, set_duration);
+    ATF_TP_ADD_TC(tp, run_pass);
+    ATF_TP_ADD_TC(tp, run_flaky);
+    ATF_TP_ADD_TC(tp, run_crash);
+    ATF_TP_ADD_TC(tp, run_duration);
+    ATF_TP_ADD_TC(tp, run_report);
+
+    return atf_no_error();
+}
@@ -0,0 +1,111 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/runner.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+/* ---------------------------------------------------------------------
+ * Test cases for the free functions.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(monotonic_seconds);
+ATF_TC_BODY(monotonic_seconds, tc)
+{
+    const double start = atf_runner_monotonic_seconds();
+
+    usleep(100000);
+    ATF_REQUIRE(atf_runner_monotonic_seconds() - start >= 0.1);
+}
+
+ATF_TC_WITHOUT_HEAD(fork__flushes);
+ATF_TC_BODY(fork__flushes, tc)
+{
+    const pid_t pid = atf_utils_fork();
+    if (pid == 0) {
+        pid_t child;
+        int status;
+
+        printf("pending\n");
+        child = atf_runner_fork();
+        if (child == 0)
+            exit(EXIT_SUCCESS);
+        exit(child != -1 && waitpid(child, &status, 0) != -1 &&
+             WIFEXITED(status) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    atf_utils_wait(pid, EXIT_SUCCESS, "pending\n", "");
+}
+
+ATF_TC_WITHOUT_HEAD(open_resfile__file);
+ATF_TC_BODY(open_resfile__file, tc)
+{
+    FILE *f;
+
+    atf_utils_create_file("result", "old contents\n");
+    f = atf_runner_open_resfile("result");
+    ATF_REQUIRE(f != NULL);
+    fprintf(f, "passed\n");
+    ATF_REQUIRE(atf_runner_close_resfile(f) == 0);
+    ATF_REQUIRE(atf_utils_compare_file("result", "passed\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(open_resfile__stdout);
+ATF_TC_BODY(open_resfile__stdout, tc)
+{
+    const pid_t pid = atf_utils_fork();
+    if (pid == 0) {
+        FILE *f;
+
+        printf("output\n");
+        fflush(stdout);
+        f = atf_runner_open_resfile("/dev/stdout");
+        if (f != stdout)
+            exit(EXIT_FAILURE);
+        fprintf(f, "passed\n");
+        exit(atf_runner_close_resfile(f) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    atf_utils_wait(pid, EXIT_SUCCESS, "output\npassed\n", "");
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, monotonic_seconds);
+    ATF_TP_ADD_TC(tp, fork__flushes);
+    ATF_TP_ADD_TC(tp, open_resfile__file);
+    ATF_TP_ADD_TC(tp, open_resfile__stdout);
+
+    return atf_no_error();
+}
@@ -60,6 +60,29 @@ out:
     return err;
 }
 
+/* Same as atf_text_for_each_word, but passes each word to 'func' as a
+ * pointer into the original string and a length, so neither the input
+ * nor the words are copied.  The words are not nul-terminated. */
+atf_error_t
+atf_text_for_each_token(const char *str, const char *sep,
+                        atf_error_t (*func)(const char *, const size_t, void *),
+                        void *data)
+{
+    atf_error_t err;
+
+    err = atf_no_error();
+    str += strspn(str, sep);
+    while (*str != '\0' && !atf_is_error(err)) {
+        const size_t length = strcspn(str, sep);
+
+        err = func(str, length, data);
+        str += length;
+        str += strspn(str, sep);
+    }
+
+    return err;
+}
+
 atf_error_t
 atf_text_format(char **dest, const char *fmt, ...)
 {
@@ -28,6 +28,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include <atf-c/detail/list.h>
 #include <atf-c/error_fwd.h>
@@ -35,6 +36,10 @@
 atf_error_t atf_text_for_each_word(const char *, const char *,
                                    atf_error_t (*)(const char *, void *),
                                    void *);
+atf_error_t atf_text_for_each_token(const char *, const char *,
+                                    atf_error_t (*)(const char *,
+                                                    const size_t, void *),
+                                    void *);
 atf_error_t atf_text_format(char **, const char *, ...);
 atf_error_t atf_text_format_ap(char **, const char *, va_list);
 atf_error_t atf_text_split(const char *, const char *, atf_list_t *);
@@ -181,6 +181,50 @@ ATF_TC_BODY(for_each_word, tc)
     }
 }
 
+static
+atf_error_t
+token_acum(const char *token, const size_t length, void *data)
+{
+    char *acum = data;
+
+    strncat(acum, token, length);
+    strcat(acum, ",");
+
+    return atf_no_error();
+}
+
+ATF_TC(for_each_token);
+ATF_TC_HEAD(for_each_token, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Checks the atf_text_for_each_token "
+                      "function");
+}
+ATF_TC_BODY(for_each_token, tc)
+{
+    char acum[1024];
+
+    strcpy(acum, "");
+    RE(atf_text_for_each_token("", " ", token_acum, acum));
+    ATF_REQUIRE_STREQ("", acum);
+
+    strcpy(acum, "");
+    RE(atf_text_for_each_token("   ", " ", token_acum, acum));
+    ATF_REQUIRE_STREQ("", acum);
+
+    strcpy(acum, "");
+    RE(atf_text_for_each_token("1 2 3", " ", token_acum, acum));
+    ATF_REQUIRE_STREQ("1,2,3,", acum);
+
+    strcpy(acum, "");
+    RE(atf_text_for_each_token("  foo  bar  ", " ", token_acum, acum));
+    ATF_REQUIRE_STREQ("foo,bar,", acum);
+
+    strcpy(acum, "");
+    RE(atf_text_for_each_token("/bin:/usr/bin.:/sbin", ":.", token_acum,
+                               acum));
+    ATF_REQUIRE_STREQ("/bin,/usr/bin,/sbin,", acum);
+}
+
 ATF_TC(format);
 ATF_TC_HEAD(format, tc)
 {
@@ -410,6 +454,7 @@ ATF_TC_BODY(to_long, tc)
 ATF_TP_ADD_TCS(tp)
 {
     ATF_TP_ADD_TC(tp, for_each_word);
+    ATF_TP_ADD_TC(tp, for_each_token);
     ATF_TP_ADD_TC(tp, format);
     ATF_TP_ADD_TC(tp, format_ap);
     ATF_TP_ADD_TC(tp, split);
@@ -35,10 +35,14 @@
 #include <unistd.h>
 
 #include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/elf.h"
 #include "atf-c/detail/env.h"
 #include "atf-c/detail/fs.h"
 #include "atf-c/detail/map.h"
+#include "atf-c/detail/repeat.h"
 #include "atf-c/detail/sanity.h"
+#include "atf-c/detail/trace.h"
+#include "atf-c/detail/watchdog.h"
 #include "atf-c/error.h"
 #include "atf-c/tc.h"
 #include "atf-c/tp.h"
@@ -141,6 +145,8 @@ struct params {
     enum tc_part m_tcpart;
     atf_fs_path_t m_resfile;
     atf_map_t m_config;
+    atf_repeat_t m_repeat;
+    atf_watchdog_t m_watchdog;
 };
 
 static
@@ -170,6 +176,8 @@ params_init(struct params *p, const char *argv0)
     p->m_do_list = false;
     p->m_tcname = NULL;
     p->m_tcpart = BODY;
+    atf_repeat_init(&p->m_repeat);
+    atf_watchdog_init(&p->m_watchdog);
 
     err = argv0_to_dir(argv0, &p->m_srcdir);
     if (atf_is_error(err))
@@ -244,6 +252,15 @@ replace_path_param(atf_fs_path_t *param, const char *value)
  * Test case listing.
  * --------------------------------------------------------------------- */
 
+static
+atf_error_t
+print_md_var(const char *name, const char *value,
+             void *data ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    printf("%s: %s\n", name, value);
+    return atf_no_error();
+}
+
 static
 void
 list_tcs(const atf_tp_t *tp)
@@ -257,29 +274,42 @@ list_tcs(const atf_tp_t *tp)
     INV(tcs != NULL);  /* Should be checked. */
     for (tcsptr = tcs; *tcsptr != NULL; tcsptr++) {
         const atf_tc_t *tc = *tcsptr;
-        char **vars = atf_tc_get_md_vars(tc);
-        char **ptr;
-
-        INV(vars != NULL);  /* Should be checked. */
+        atf_error_t err;
 
         if (tcsptr != tcs)  /* Not first. */
             printf("\n");
 
-        for (ptr = vars; *ptr != NULL; ptr += 2) {
-            if (strcmp(*ptr, "ident") == 0) {
-                printf("ident: %s\n", *(ptr + 1));
-                break;
-            }
-        }
+        /* The properties are visited in definition order, which means
+         * that 'ident' is printed first as the format requires. */
+        err = atf_tc_for_each_md_var(tc, print_md_var, NULL);
+        INV(!atf_is_error(err));
+    }
+}
 
-        for (ptr = vars; *ptr != NULL; ptr += 2) {
-            if (strcmp(*ptr, "ident") != 0) {
-                printf("%s: %s\n", *ptr, *(ptr + 1));
-            }
-        }
+/* Prints the listing that atf-embed-list(1) stored in the executable, if
+ * any, which saves running the heads of all test cases. */
+static
+atf_error_t
+list_embedded(const char *exe, bool *found)
+{
+    static const char *header = "Content-Type: application/X-atf-tp;";
+    atf_dynstr_t listing;
+    atf_error_t err;
+
+    err = atf_dynstr_init(&listing);
+    if (atf_is_error(err))
+        return err;
 
-        atf_utils_free_charpp(vars);
+    err = atf_elf_read_section(exe, ATF_ELF_LIST_SECTION, &listing, found);
+    if (!atf_is_error(err) && *found) {
+        *found = strncmp(atf_dynstr_cstring(&listing), header,
+                         strlen(header)) == 0;
+        if (*found)
+            printf("%s", atf_dynstr_cstring(&listing));
     }
+
+    atf_dynstr_fini(&listing);
+    return err;
 }
 
 /* ---------------------------------------------------------------------
@@ -334,12 +364,24 @@ process_params(int argc, char **argv, struct params *p)
     old_opterr = opterr;
     opterr = 0;
     while (!atf_is_error(err) &&
-           (ch = getopt(argc, argv, GETOPT_POSIX ":lr:s:v:")) != -1) {
+           (ch = getopt(argc, argv, GETOPT_POSIX ":d:ln:r:s:t:v:")) != -1) {
         switch (ch) {
+        case 'd':
+            if (!atf_repeat_set_duration(&p->m_repeat, optarg))
+                err = usage_error("Invalid duration `%s'; must be a "
+                                  "positive number of seconds", optarg);
+            break;
+
         case 'l':
             p->m_do_list = true;
             break;
 
+        case 'n':
+            if (!atf_repeat_set_runs(&p->m_repeat, optarg))
+                err = usage_error("Invalid number of runs `%s'; must be a "
+                                  "positive integer", optarg);
+            break;
+
         case 'r':
             err = replace_path_param(&p->m_resfile, optarg);
             break;
@@ -348,6 +390,12 @@ process_params(int argc, char **argv, struct params *p)
             err = replace_path_param(&p->m_srcdir, optarg);
             break;
 
+        case 't':
+            if (!atf_watchdog_set_grace(&p->m_watchdog, optarg))
+                err = usage_error("Invalid grace period `%s'; must be a "
+                                  "positive number of seconds", optarg);
+            break;
+
         case 'v':
             err = parse_vflag(optarg, &p->m_config);
             break;
@@ -375,8 +423,16 @@ process_params(int argc, char **argv, struct params *p)
         if (p->m_do_list) {
             if (argc > 0)
                 err = usage_error("Cannot provide test case names with -l");
+            else if (atf_repeat_enabled(&p->m_repeat))
+                err = usage_error("Cannot repeat test cases with -l");
+            else if (atf_watchdog_enabled(&p->m_watchdog))
+                err = usage_error("Cannot enforce timeouts with -l");
         } else {
-            if (argc == 0)
+            if (atf_repeat_enabled(&p->m_repeat) &&
+                atf_watchdog_enabled(&p->m_watchdog))
+                err = usage_error("Cannot enforce timeouts of repeated test "
+                                  "cases");
+            else if (argc == 0)
                 err = usage_error("Must provide a test case name");
             else if (argc == 1)
                 err = handle_tcarg(argv[0], &p->m_tcname, &p->m_tcpart);
@@ -478,6 +534,92 @@ out:
     return err;
 }
 
+/* The test case to run in a child process for -n, -d and -t. */
+struct child_data {
+    const atf_tp_t *m_tp;
+    const char *m_tcname;
+};
+
+static
+void
+child_body(void *data, const char *resfile)
+{
+    const struct child_data *cd = data;
+    atf_error_t err;
+
+    err = atf_tp_run(cd->m_tp, cd->m_tcname, resfile);
+    if (atf_is_error(err)) {
+        print_error(err);
+        atf_error_free(err);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static
+void
+child_cleanup(void *data)
+{
+    const struct child_data *cd = data;
+    atf_error_t err;
+
+    err = atf_tp_cleanup(cd->m_tp, cd->m_tcname);
+    if (atf_is_error(err)) {
+        print_error(err);
+        atf_error_free(err);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static
+atf_error_t
+repeat_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
+{
+    const atf_tc_t *tc = atf_tp_get_tc(tp, p->m_tcname);
+    struct child_data data;
+    atf_error_t err;
+    bool passed;
+
+    if (p->m_tcpart != BODY)
+        return usage_error("Cannot repeat the cleanup of a test case");
+
+    data.m_tp = tp;
+    data.m_tcname = p->m_tcname;
+    err = atf_repeat_run(&p->m_repeat, p->m_tcname, child_body,
+                         atf_tc_has_md_var(tc, "has.cleanup") ?
+                         child_cleanup : NULL, &data,
+                         atf_fs_path_cstring(&p->m_resfile), &passed);
+    if (!atf_is_error(err))
+        *exitcode = passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    return err;
+}
+
+static
+atf_error_t
+watchdog_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
+{
+    const atf_tc_t *tc = atf_tp_get_tc(tp, p->m_tcname);
+    struct child_data data;
+    atf_error_t err;
+    bool passed;
+
+    if (p->m_tcpart != BODY)
+        return usage_error("Cannot enforce the timeout of the cleanup of a "
+                           "test case");
+
+    data.m_tp = tp;
+    data.m_tcname = p->m_tcname;
+    err = atf_watchdog_run(&p->m_watchdog,
+                           atf_tc_has_md_var(tc, "timeout") ?
+                           atf_tc_get_md_var(tc, "timeout") : NULL,
+                           child_body,
+                           atf_tc_has_md_var(tc, "has.cleanup") ?
+                           child_cleanup : NULL, &data,
+                           atf_fs_path_cstring(&p->m_resfile), &passed);
+    if (!atf_is_error(err))
+        *exitcode = passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    return err;
+}
+
 static
 atf_error_t
 run_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
@@ -495,10 +637,20 @@ run_tc(const atf_tp_t *tp, struct params *p, int *exitcode)
         "__RUNNING_INSIDE_ATF_RUN"), "internal-yes-value") != 0)
     {
         print_warning("Running test cases outside of kyua(1) is unsupported");
-        print_warning("No isolation nor timeout control is being applied; you "
-                      "may get unexpected failures; see atf-test-case(4)");
+        if (atf_watchdog_enabled(&p->m_watchdog))
+            print_warning("No isolation is being applied; you may get "
+                          "unexpected failures; see atf-test-case(4)");
+        else
+            print_warning("No isolation nor timeout control is being "
+                          "applied; you may get unexpected failures; see "
+                          "atf-test-case(4)");
     }
 
+    if (atf_repeat_enabled(&p->m_repeat))
+        return repeat_tc(tp, p, exitcode);
+    else if (atf_watchdog_enabled(&p->m_watchdog))
+        return watchdog_tc(tp, p, exitcode);
+
     switch (p->m_tcpart) {
     case BODY:
         err = atf_tp_run(tp, p->m_tcname, atf_fs_path_cstring(&p->m_resfile));
@@ -543,31 +695,59 @@ controlled_main(int argc, char **argv,
     struct params p;
     atf_tp_t tp;
     char **raw_config;
+    bool configured;
 
+    atf_trace_begin("config", NULL);
     err = process_params(argc, argv, &p);
-    if (atf_is_error(err))
+    if (atf_is_error(err)) {
+        atf_trace_end("config");
         goto out;
+    }
+    configured = atf_map_size(&p.m_config) > 0;
 
     err = handle_srcdir(&p);
+    atf_trace_end("config");
     if (atf_is_error(err))
         goto out_p;
 
+    /* The heads can look at the configuration variables, so a listing
+     * computed at build time only holds if there are none. */
+    if (p.m_do_list && !configured && strchr(argv[0], '/') != NULL) {
+        bool found;
+
+        atf_trace_begin("list", NULL);
+        err = list_embedded(argv[0], &found);
+        atf_trace_end("list");
+        if (atf_is_error(err))
+            goto out_p;
+        else if (found) {
+            *exitcode = EXIT_SUCCESS;
+            goto out_p;
+        }
+    }
+
     raw_config = atf_map_to_charpp(&p.m_config);
     if (raw_config == NULL) {
         err = atf_no_memory_error();
         goto out_p;
     }
+    atf_trace_begin("register", NULL);
     err = atf_tp_init(&tp, (const char* const*)raw_config);
     atf_utils_free_charpp(raw_config);
-    if (atf_is_error(err))
+    if (atf_is_error(err)) {
+        atf_trace_end("register");
         goto out_p;
+    }
 
     err = add_tcs_hook(&tp);
+    atf_trace_end("register");
     if (atf_is_error(err))
         goto out_tp;
 
     if (p.m_do_list) {
+        atf_trace_begin("list", NULL);
         list_tcs(&tp);
+        atf_trace_end("list");
         INV(!atf_is_error(err));
         *exitcode = EXIT_SUCCESS;
     } else {
@@ -600,6 +780,8 @@ atf_tp_main(int argc, char **argv, atf_error_t (*add_tcs_hook)(atf_tp_t *))
     if (strncmp(progname, "lt-", 3) == 0)
         progname += 3;
 
+    atf_trace_process(progname);
+
     exitcode = EXIT_FAILURE; /* Silence GCC warning. */
     err = controlled_main(argc, argv, add_tcs_hook, &exitcode);
     if (atf_is_error(err)) {
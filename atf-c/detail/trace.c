@@ -0,0 +1,226 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/trace.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+/* Events are written with a single write(2) each on a descriptor opened
+ * in append mode, so that every process spawned with ATF_TRACE set,
+ * including the children of the test program, can share the file. */
+static pthread_once_t Trace_once = PTHREAD_ONCE_INIT;
+static int Trace_fd = -1;
+
+/* Trace viewers need the events of each thread to nest properly, so
+ * threads get small sequential identifiers. */
+static atomic_long Next_tid = 1;
+static _Thread_local long Tid = 0;
+
+/** Opens the trace file and starts the JSON array if it is empty.
+ *
+ * The closing bracket is never written: trace viewers accept arrays that
+ * are left open, and this lets any process keep appending to the file.
+ */
+static void
+open_trace(void)
+{
+    const char *path = getenv("ATF_TRACE");
+    struct flock fl;
+    struct stat sb;
+
+    if (path == NULL || path[0] == '\0')
+        return;
+
+    Trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (Trace_fd == -1)
+        return;
+
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    if (fcntl(Trace_fd, F_SETLKW, &fl) == -1)
+        return;
+    if (fstat(Trace_fd, &sb) != -1 && sb.st_size == 0) {
+        if (write(Trace_fd, "[\n", 2) != 2) {
+            /* Nothing we can do; events will still be appended. */
+        }
+    }
+    fl.l_type = F_UNLCK;
+    fcntl(Trace_fd, F_SETLK, &fl);
+}
+
+/* Appends a string to a buffer, escaped as a JSON string body and
+ * truncated if it does not fit. */
+static size_t
+append_escaped(char *buf, size_t len, const size_t size, const char *str)
+{
+    for (; *str != '\0'; str++) {
+        const unsigned char ch = (unsigned char)*str;
+        char esc[8];
+        size_t esclen;
+
+        if (ch == '"' || ch == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)ch;
+            esclen = 2;
+        } else if (ch < 0x20) {
+            esclen = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", ch);
+        } else {
+            esc[0] = (char)ch;
+            esclen = 1;
+        }
+
+        if (len + esclen >= size)
+            break;
+        memcpy(buf + len, esc, esclen);
+        len += esclen;
+    }
+    return len;
+}
+
+/** Writes a single event.
+ *
+ * \param ph The event type, as defined by the trace-event format.
+ * \param name The name of the event.
+ * \param argname The name of the only argument of the event, if any.
+ * \param argv The words that make up the value of the argument, which
+ *     are joined with spaces.  Can be NULL if there is no argument.
+ */
+static void
+emit(const char ph, const char *name, const char *argname,
+     const char *const *argv)
+{
+    /* Leave room for the closing of the argument and the event. */
+    char buf[4096];
+    const size_t size = sizeof(buf) - 8;
+    struct timespec ts;
+    size_t len;
+    int ret;
+
+    pthread_once(&Trace_once, open_trace);
+    if (Trace_fd == -1)
+        return;
+
+    if (Tid == 0)
+        Tid = atomic_fetch_add(&Next_tid, 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ret = snprintf(buf, size, "{\"name\":\"%s\",\"cat\":\"atf\","
+        "\"ph\":\"%c\",\"ts\":%lld.%03ld,\"pid\":%ld,\"tid\":%ld", name, ph,
+        (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000,
+        ts.tv_nsec % 1000, (long)getpid(), Tid);
+    if (ret < 0 || (size_t)ret >= size)
+        return;
+    len = (size_t)ret;
+
+    if (ph == 'i') {
+        memcpy(buf + len, ",\"s\":\"t\"", 8);
+        len += 8;
+    }
+
+    if (argv != NULL) {
+        const char *const *arg;
+
+        len += (size_t)snprintf(buf + len, size - len, ",\"args\":{\"%s\":\"",
+                                argname);
+        for (arg = argv; *arg != NULL && len < size; arg++) {
+            if (arg != argv)
+                buf[len++] = ' ';
+            len = append_escaped(buf, len, size, *arg);
+        }
+        memcpy(buf + len, "\"}", 2);
+        len += 2;
+    }
+
+    memcpy(buf + len, "},\n", 3);
+    len += 3;
+
+    if (write(Trace_fd, buf, len) != (ssize_t)len) {
+        /* Tracing must never affect the traced code; drop the event. */
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Free functions.
+ * --------------------------------------------------------------------- */
+
+bool
+atf_trace_enabled(void)
+{
+    pthread_once(&Trace_once, open_trace);
+    return Trace_fd != -1;
+}
+
+/** Names the calling process in the trace. */
+void
+atf_trace_process(const char *name)
+{
+    const char *argv[] = { name, NULL };
+
+    emit('M', "process_name", "name", argv);
+}
+
+void
+atf_trace_begin(const char *name, const char *detail)
+{
+    const char *argv[] = { detail, NULL };
+
+    emit('B', name, "detail", detail == NULL ? NULL : argv);
+}
+
+/** Begins an event whose detail is a command line. */
+void
+atf_trace_begin_argv(const char *name, const char *const *argv)
+{
+    emit('B', name, "argv", argv);
+}
+
+void
+atf_trace_end(const char *name)
+{
+    emit('E', name, NULL, NULL);
+}
+
+void
+atf_trace_instant(const char *name, const char *detail)
+{
+    const char *argv[] = { detail, NULL };
+
+    emit('i', name, "detail", detail == NULL ? NULL : argv);
+}
@@ -0,0 +1,382 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/watchdog.h"
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atf-c/defs.h"
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/env.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/runner.h"
+#include "atf-c/detail/sanity.h"
+#include "atf-c/error.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+/* The timeout of the test cases that do not set one; see
+ * atf-test-case(4). */
+static const char *const default_timeout = "300";
+
+/* The process group being watched and whether it outlived its limit.
+ * The group is killed from the signal handler itself so that the wait
+ * for it can never miss the expiration of the timer. */
+static volatile pid_t watched = -1;
+static volatile sig_atomic_t expired;
+
+static
+void
+alarm_handler(const int signo ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    if (watched != -1)
+        (void)killpg(watched, SIGKILL);
+    expired = 1;
+}
+
+static
+bool
+parse_seconds(const char *str, double *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtod(str, &end);
+    return *str != '\0' && *end == '\0' && errno == 0 && isfinite(*value) &&
+        *value >= 0;
+}
+
+static
+void
+set_timer(const double seconds)
+{
+    struct itimerval it;
+
+    memset(&it, 0, sizeof(it));
+    if (seconds > 0) {
+        it.it_value.tv_sec = (time_t)seconds;
+        it.it_value.tv_usec = (suseconds_t)
+            ((seconds - (double)it.it_value.tv_sec) * 1e6);
+        /* A zero value would disarm the timer instead. */
+        if (it.it_value.tv_sec == 0 && it.it_value.tv_usec == 0)
+            it.it_value.tv_usec = 1;
+    }
+    (void)setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/* Either the body or the cleanup of the test case. */
+struct part {
+    atf_watchdog_body_t m_body;
+    atf_watchdog_cleanup_t m_cleanup;
+    void *m_data;
+    const char *m_resfile;
+};
+
+/** Runs a part of the test case in a new process group.
+ *
+ * If limit is not zero and the part has not finished after that many
+ * seconds, its whole process group is killed and timed_out is set.
+ */
+static
+atf_error_t
+run_part(const struct part *p, const double limit, int *status,
+         bool *timed_out, double *elapsed)
+{
+    struct sigaction sa, oldsa;
+    atf_error_t err;
+    double start;
+    pid_t pid;
+
+    start = atf_runner_monotonic_seconds();
+    pid = atf_runner_fork();
+    if (pid == -1)
+        return atf_libc_error(errno, "Failed to spawn the test case");
+    else if (pid == 0) {
+        (void)setpgid(0, 0);
+        if (p->m_body != NULL)
+            p->m_body(p->m_data, p->m_resfile);
+        else
+            p->m_cleanup(p->m_data);
+        exit(EXIT_SUCCESS);
+    }
+    /* Done on both sides to ensure the group exists before the timer can
+     * fire; this one fails harmlessly if the child already ran exec. */
+    (void)setpgid(pid, pid);
+
+    expired = 0;
+    if (limit > 0) {
+        watched = pid;
+        sa.sa_handler = alarm_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;
+        (void)sigaction(SIGALRM, &sa, &oldsa);
+        set_timer(limit);
+    }
+
+    err = atf_no_error();
+    while (waitpid(pid, status, 0) == -1) {
+        if (errno != EINTR) {
+            err = atf_libc_error(errno, "Failed to wait for the test case");
+            break;
+        }
+    }
+    *elapsed = atf_runner_monotonic_seconds() - start;
+
+    if (limit > 0) {
+        set_timer(0);
+        (void)sigaction(SIGALRM, &oldsa, NULL);
+        watched = -1;
+    }
+    *timed_out = expired;
+    return err;
+}
+
+static
+bool
+exited_successfully(const int status)
+{
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static
+atf_error_t
+read_result(const char *path, atf_dynstr_t *result, bool *found)
+{
+    atf_error_t err;
+    char buf[1024];
+    size_t length;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        *found = false;
+        return atf_no_error();
+    }
+    *found = true;
+
+    err = atf_no_error();
+    while (!atf_is_error(err) && (length = fread(buf, 1, sizeof(buf), f)) > 0)
+        err = atf_dynstr_append_fmt(result, "%.*s", (int)length, buf);
+    fclose(f);
+    return err;
+}
+
+static
+atf_error_t
+write_result(const char *path, const atf_dynstr_t *result)
+{
+    FILE *f;
+
+    f = atf_runner_open_resfile(path);
+    if (f == NULL)
+        return atf_libc_error(errno, "Cannot create results file '%s'",
+                              path);
+    fprintf(f, "%s", atf_dynstr_cstring(result));
+    if (atf_runner_close_resfile(f) == EOF)
+        return atf_libc_error(errno, "Cannot write results file '%s'", path);
+    return atf_no_error();
+}
+
+/** Replaces the result of the test case with a failure. */
+static
+atf_error_t
+fail(atf_dynstr_t *result, bool *passed, const char *fmt, ...)
+{
+    atf_error_t err;
+    va_list ap;
+
+    atf_dynstr_clear(result);
+    va_start(ap, fmt);
+    err = atf_dynstr_append_ap(result, fmt, ap);
+    va_end(ap);
+    *passed = false;
+    return err;
+}
+
+/* ---------------------------------------------------------------------
+ * The "atf_watchdog" type.
+ * --------------------------------------------------------------------- */
+
+/*
+ * Constructors/destructors.
+ */
+
+void
+atf_watchdog_init(atf_watchdog_t *w)
+{
+    w->m_grace = 0;
+}
+
+/*
+ * Getters.
+ */
+
+bool
+atf_watchdog_enabled(const atf_watchdog_t *w)
+{
+    return w->m_grace > 0;
+}
+
+/*
+ * Modifiers.
+ */
+
+bool
+atf_watchdog_set_grace(atf_watchdog_t *w, const char *str)
+{
+    double value;
+
+    if (!parse_seconds(str, &value) || value == 0)
+        return false;
+    w->m_grace = value;
+    return true;
+}
+
+/*
+ * Operations.
+ */
+
+/** Runs the test case body within its timeout and then its cleanup.
+ *
+ * The timeout is the value of the timeout property of the test case, or
+ * NULL if it has none, and may have a fractional part.  A body that times
+ * out after expecting to do so has the result it recorded; any other one
+ * fails.  So does a passing test case whose cleanup does not finish
+ * cleanly within the grace period.  Records the result in resfile, unless
+ * the body crashed without recording one, and sets passed to whether the
+ * test case did not fail.
+ */
+atf_error_t
+atf_watchdog_run(const atf_watchdog_t *w, const char *timeout,
+                 atf_watchdog_body_t body, atf_watchdog_cleanup_t cleanup,
+                 void *data, const char *resfile, bool *passed)
+{
+    atf_fs_path_t dir, runfile;
+    atf_dynstr_t result;
+    atf_error_t err;
+    double limit, elapsed;
+    bool found, timed_out;
+    struct part p;
+    int status;
+
+    PRE(atf_watchdog_enabled(w));
+
+    if (timeout == NULL)
+        timeout = default_timeout;
+    if (!parse_seconds(timeout, &limit))
+        return atf_libc_error(EINVAL, "Invalid timeout `%s'; must be a "
+                              "non-negative number of seconds", timeout);
+
+    err = atf_fs_path_init_fmt(&dir, "%s/atf-watchdog.XXXXXX",
+                               atf_env_get_with_default("TMPDIR", "/tmp"));
+    if (atf_is_error(err))
+        goto out;
+    err = atf_fs_mkdtemp(&dir);
+    if (atf_is_error(err))
+        goto out_dir;
+
+    err = atf_fs_path_copy(&runfile, &dir);
+    if (atf_is_error(err))
+        goto out_rmdir;
+    err = atf_fs_path_append_fmt(&runfile, "result");
+    if (atf_is_error(err))
+        goto out_runfile;
+
+    err = atf_dynstr_init(&result);
+    if (atf_is_error(err))
+        goto out_runfile;
+
+    p.m_body = body;
+    p.m_cleanup = NULL;
+    p.m_data = data;
+    p.m_resfile = atf_fs_path_cstring(&runfile);
+    err = run_part(&p, limit, &status, &timed_out, &elapsed);
+    if (atf_is_error(err))
+        goto out_result;
+    err = read_result(atf_fs_path_cstring(&runfile), &result, &found);
+    if (atf_is_error(err))
+        goto out_result;
+
+    if (!timed_out)
+        *passed = exited_successfully(status);
+    else if (found && strncmp(atf_dynstr_cstring(&result),
+                              "expected_timeout:", 17) == 0)
+        *passed = true;
+    else {
+        err = fail(&result, passed, "failed: Test case timed out after "
+                   "%.3f s; its timeout is %s s\n", elapsed, timeout);
+        found = true;
+    }
+
+    if (!atf_is_error(err) && cleanup != NULL) {
+        p.m_body = NULL;
+        p.m_cleanup = cleanup;
+        err = run_part(&p, w->m_grace, &status, &timed_out, &elapsed);
+        if (!atf_is_error(err) && *passed) {
+            if (timed_out)
+                err = fail(&result, passed, "failed: Test case cleanup "
+                           "timed out after %.3f s\n", elapsed);
+            else if (!exited_successfully(status))
+                err = fail(&result, passed, "failed: Test case cleanup did "
+                           "not terminate successfully\n");
+        }
+    }
+
+    if (!atf_is_error(err) && found)
+        err = write_result(resfile, &result);
+
+out_result:
+    atf_dynstr_fini(&result);
+out_runfile:
+    atf_fs_path_fini(&runfile);
+out_rmdir:
+    {
+        atf_error_t err2 = atf_fs_rmtree(&dir);
+        if (atf_is_error(err2)) {
+            if (atf_is_error(err))
+                atf_error_free(err2);
+            else
+                err = err2;
+        }
+    }
+out_dir:
+    atf_fs_path_fini(&dir);
+out:
+    return err;
+}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#if !defined(ATF_C_DETAIL_WATCHDOG_H)
+#define ATF_C_DETAIL_WATCHDOG_H
+
+#include <stdbool.h>
+
+#include <atf-c/error_fwd.h>
+
+/* Runs a test case in a child process that leads a process group of its
+ * own and kills the whole group as soon as the timeout of the test case
+ * expires, then gives its cleanup a grace period to finish.  Backs the -t
+ * flag of the test programs of all languages. */
+
+struct atf_watchdog {
+    double m_grace;
+};
+typedef struct atf_watchdog atf_watchdog_t;
+
+/* Runs the test case body, writing its result to the given file.  Called
+ * in the child process, which exits with success if the function
+ * returns. */
+typedef void (*atf_watchdog_body_t)(void *, const char *);
+
+/* Runs the test case cleanup, also in a child process. */
+typedef void (*atf_watchdog_cleanup_t)(void *);
+
+/* Constructors/destructors. */
+void atf_watchdog_init(atf_watchdog_t *);
+
+/* Getters. */
+bool atf_watchdog_enabled(const atf_watchdog_t *);
+
+/* Modifiers; returns false if the argument is not a positive number. */
+bool atf_watchdog_set_grace(atf_watchdog_t *, const char *);
+
+/* Operations. */
+atf_error_t atf_watchdog_run(const atf_watchdog_t *, const char *,
+                             atf_watchdog_body_t, atf_watchdog_cleanup_t,
+                             void *, const char *, bool *);
+
+#endif /* !defined(ATF_C_DETAIL_WATCHDOG_H) */
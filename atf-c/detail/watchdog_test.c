@@ -0,0 +1,252 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include "atf-c/detail/watchdog.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/detail/test_helpers.h"
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+static
+void
+body_pass(void *data ATF_DEFS_ATTRIBUTE_UNUSED, const char *resfile)
+{
+    atf_utils_create_file(resfile, "passed\n");
+}
+
+/* Hangs after leaving behind a child that would create a file if it
+ * outlived the body by a little while. */
+static
+void
+body_hang(void *data ATF_DEFS_ATTRIBUTE_UNUSED,
+          const char *resfile ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    if (fork() == 0) {
+        usleep(300000);
+        atf_utils_create_file("survivor", "%s", "");
+        exit(EXIT_SUCCESS);
+    }
+    for (;;)
+        pause();
+}
+
+static
+void
+body_expect_timeout(void *data ATF_DEFS_ATTRIBUTE_UNUSED, const char *resfile)
+{
+    atf_utils_create_file(resfile, "expected_timeout: Hangs\n");
+    for (;;)
+        pause();
+}
+
+static
+void
+body_crash(void *data ATF_DEFS_ATTRIBUTE_UNUSED,
+           const char *resfile ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    abort();
+}
+
+static
+void
+cleanup_count(void *data ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    atf_utils_create_file("cleanups", "x\n");
+}
+
+static
+void
+cleanup_hang(void *data ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+    for (;;)
+        pause();
+}
+
+/* ---------------------------------------------------------------------
+ * Tests for the "atf_watchdog" type.
+ * --------------------------------------------------------------------- */
+
+ATF_TC_WITHOUT_HEAD(set_grace);
+ATF_TC_BODY(set_grace, tc)
+{
+    atf_watchdog_t watchdog;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(!atf_watchdog_enabled(&watchdog));
+
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "0.5"));
+    ATF_REQUIRE(watchdog.m_grace == 0.5);
+    ATF_REQUIRE(atf_watchdog_enabled(&watchdog));
+
+    ATF_REQUIRE(!atf_watchdog_set_grace(&watchdog, ""));
+    ATF_REQUIRE(!atf_watchdog_set_grace(&watchdog, "0"));
+    ATF_REQUIRE(!atf_watchdog_set_grace(&watchdog, "-2"));
+    ATF_REQUIRE(!atf_watchdog_set_grace(&watchdog, "inf"));
+    ATF_REQUIRE(!atf_watchdog_set_grace(&watchdog, "3m"));
+    ATF_REQUIRE(watchdog.m_grace == 0.5);
+}
+
+ATF_TC_WITHOUT_HEAD(run_pass);
+ATF_TC_BODY(run_pass, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    RE(atf_watchdog_run(&watchdog, "10", body_pass, cleanup_count, NULL,
+                        "result", &passed));
+    ATF_REQUIRE(passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "passed\n"));
+    ATF_REQUIRE(atf_utils_compare_file("cleanups", "x\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_unlimited);
+ATF_TC_BODY(run_unlimited, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    RE(atf_watchdog_run(&watchdog, "0", body_pass, NULL, NULL, "result",
+                        &passed));
+    ATF_REQUIRE(passed);
+    RE(atf_watchdog_run(&watchdog, NULL, body_pass, NULL, NULL, "result2",
+                        &passed));
+    ATF_REQUIRE(passed);
+    ATF_REQUIRE(atf_utils_compare_file("result2", "passed\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_timeout);
+ATF_TC_BODY(run_timeout, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    RE(atf_watchdog_run(&watchdog, "0.05", body_hang, cleanup_count, NULL,
+                        "result", &passed));
+    ATF_REQUIRE(!passed);
+    ATF_REQUIRE(atf_utils_grep_file("^failed: Test case timed out after "
+        "[0-9]+\\.[0-9]{3} s; its timeout is 0.05 s$", "result"));
+    ATF_REQUIRE(atf_utils_compare_file("cleanups", "x\n"));
+
+    usleep(500000);
+    ATF_REQUIRE_MSG(access("survivor", F_OK) == -1,
+                    "The children of the body were not killed");
+}
+
+ATF_TC_WITHOUT_HEAD(run_expect_timeout);
+ATF_TC_BODY(run_expect_timeout, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    RE(atf_watchdog_run(&watchdog, "0.05", body_expect_timeout, NULL, NULL,
+                        "result", &passed));
+    ATF_REQUIRE(passed);
+    ATF_REQUIRE(atf_utils_compare_file("result", "expected_timeout: "
+                                       "Hangs\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_cleanup_timeout);
+ATF_TC_BODY(run_cleanup_timeout, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "0.05"));
+    RE(atf_watchdog_run(&watchdog, "10", body_pass, cleanup_hang, NULL,
+                        "result", &passed));
+    ATF_REQUIRE(!passed);
+    ATF_REQUIRE(atf_utils_grep_file("^failed: Test case cleanup timed out "
+        "after [0-9]+\\.[0-9]{3} s$", "result"));
+}
+
+ATF_TC_WITHOUT_HEAD(run_crash);
+ATF_TC_BODY(run_crash, tc)
+{
+    atf_watchdog_t watchdog;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    RE(atf_watchdog_run(&watchdog, "10", body_crash, NULL, NULL, "result",
+                        &passed));
+    ATF_REQUIRE(!passed);
+    ATF_REQUIRE(access("result", F_OK) == -1);
+}
+
+ATF_TC_WITHOUT_HEAD(run_invalid_timeout);
+ATF_TC_BODY(run_invalid_timeout, tc)
+{
+    atf_watchdog_t watchdog;
+    atf_error_t err;
+    bool passed;
+
+    atf_watchdog_init(&watchdog);
+    ATF_REQUIRE(atf_watchdog_set_grace(&watchdog, "5"));
+    err = atf_watchdog_run(&watchdog, "soon", body_pass, NULL, NULL,
+                           "result", &passed);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    ATF_REQUIRE_EQ(EINVAL, atf_libc_error_code(err));
+    atf_error_free(err);
+    ATF_REQUIRE(access("result", F_OK) == -1);
+}
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_TC(tp, set_grace);
+    ATF_TP_ADD_TC(tp, run_pass);
+    ATF_TP_ADD_TC(tp, run_unlimited);
+    ATF_TP_ADD_TC(tp, run_timeout);
+    ATF_TP_ADD_TC(tp, run_expect_timeout);
+    ATF_TP_ADD_TC(tp, run_cleanup_timeout);
+    ATF_TP_ADD_TC(tp, run_crash);
+    ATF_TP_ADD_TC(tp, run_invalid_timeout);
+
+    return atf_no_error();
+}
@@ -0,0 +1,149 @@
+# Copyright (c) 2014 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Path to the installed atf-embed-list script.
+Embed_List="__ATF_EMBED_LIST__"
+
+# Copies a C test program into the work directory, where it can be
+# modified.
+copy_program()
+{
+    cp "$(atf_get_srcdir)/detail/dynstr_test" prog
+    chmod +w prog
+}
+
+atf_test_case embed
+embed_head()
+{
+    atf_set "descr" "Checks that a test program lists the same test" \
+        "cases once its listing is embedded"
+    atf_set "require.progs" "objcopy"
+}
+embed_body()
+{
+    copy_program
+    atf_check -s eq:0 -o save:expected -e empty ./prog -l
+    atf_check -s eq:0 -o empty -e empty "${Embed_List}" prog
+    atf_check -s eq:0 -o file:expected -e empty ./prog -l
+    atf_check -s eq:0 -o empty -e empty \
+        objcopy --dump-section .atf_list=listing prog
+    atf_check -s eq:0 -o file:expected -e empty cat listing
+}
+
+atf_test_case skips_heads
+skips_heads_head()
+{
+    atf_set "descr" "Checks that an embedded listing is printed without" \
+        "running the heads of the test cases"
+    atf_set "require.progs" "objcopy"
+}
+skips_heads_body()
+{
+    copy_program
+    cat >lister <<EOT
+#! /bin/sh
+echo 'Content-Type: application/X-atf-tp; version="1"'
+echo
+echo 'ident: embedded'
+EOT
+    chmod +x lister
+
+    atf_check -s eq:0 -o empty -e empty "${Embed_List}" -l ./lister prog
+    atf_check -s eq:0 -o save:stdout -e empty ./prog -l
+    atf_check -s eq:0 -o save:expected -e empty ./lister
+    atf_check -s eq:0 -o file:expected -e empty cat stdout
+
+    echo "Listing with a configuration variable runs the heads again"
+    atf_check -s eq:0 -o not-match:embedded -e empty ./prog -v foo=bar -l
+
+    echo "Listing through the PATH cannot locate the executable"
+    atf_check -s eq:0 -o save:stdout -e empty \
+        env PATH="$(pwd):${PATH}" prog -l
+    atf_check -s eq:0 -o not-match:embedded -e empty cat stdout
+}
+
+atf_test_case replace
+replace_head()
+{
+    atf_set "descr" "Checks that embedding a listing twice replaces the" \
+        "previous one"
+    atf_set "require.progs" "objcopy"
+}
+replace_body()
+{
+    copy_program
+    atf_check -s eq:0 -o save:expected -e empty ./prog -l
+    for ident in first second; do
+        printf '#! /bin/sh\necho "Content-Type: application/X-atf-tp;"\n' \
+            >lister
+        printf 'echo; echo "ident: %s"\n' "${ident}" >>lister
+        chmod +x lister
+        atf_check -s eq:0 -o empty -e empty "${Embed_List}" -l ./lister prog
+    done
+    atf_check -s eq:0 -o not-match:first -o match:'^ident: second$' \
+        -e empty ./prog -l
+    atf_check -s eq:0 -o empty -e empty "${Embed_List}" prog
+    atf_check -s eq:0 -o file:expected -e empty ./prog -l
+}
+
+atf_test_case not_a_test_program
+not_a_test_program_head()
+{
+    atf_set "descr" "Checks that the listing is validated before it is" \
+        "stored"
+    atf_set "require.progs" "objcopy"
+}
+not_a_test_program_body()
+{
+    copy_program
+    cp prog original
+    printf '#! /bin/sh\necho "hello"\n' >lister
+    chmod +x lister
+    atf_check -s eq:1 -o empty -e match:'is not an atf test program' \
+        "${Embed_List}" -l ./lister prog
+    atf_check -s eq:0 -o empty -e empty cmp prog original
+}
+
+atf_test_case usage_errors
+usage_errors_body()
+{
+    atf_check -s eq:1 -o empty -e match:'Must provide a single test program' \
+        "${Embed_List}"
+    atf_check -s eq:1 -o empty -e match:'Unknown option -z' \
+        "${Embed_List}" -z prog
+    atf_check -s eq:1 -o empty -e match:'Option -l requires an argument' \
+        "${Embed_List}" -l
+}
+
+atf_init_test_cases()
+{
+    atf_add_test_case embed
+    atf_add_test_case skips_heads
+    atf_add_test_case replace
+    atf_add_test_case not_a_test_program
+    atf_add_test_case usage_errors
+}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
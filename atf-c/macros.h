@@ -97,6 +97,51 @@
 #define ATF_TC_CLEANUP_NAME(tc) \
     (atfu_ ## tc ## _cleanup)
 
+/* Shared by ATF_BENCH and ATF_BENCH_WITHOUT_HEAD.  Takes the already-pasted
+ * 'atfu_<name>' prefix so that a benchmark name that happens to be a macro is
+ * not expanded; 'head' is the statement that runs the user head, if any. */
+#define ATFU_BENCH(ident, prefix, head) \
+    static void prefix ## _bench(const atf_tc_t *, const size_t); \
+    static void \
+    prefix ## _bench_head(atf_tc_t *atfu_tc) \
+    { \
+        atf_tc_set_md_var(atfu_tc, "X-type", "benchmark"); \
+        head; \
+    } \
+    static void \
+    prefix ## _body(const atf_tc_t *atfu_tc) \
+    { \
+        atf_tc_run_bench(atfu_tc, prefix ## _bench); \
+    } \
+    static atf_tc_t prefix ## _tc; \
+    static atf_tc_pack_t prefix ## _tc_pack = { \
+        .m_ident = ident, \
+        .m_head = prefix ## _bench_head, \
+        .m_body = prefix ## _body, \
+        .m_cleanup = NULL, \
+    }
+
+#define ATF_BENCH_WITHOUT_HEAD(bm) \
+    ATFU_BENCH(#bm, atfu_ ## bm, (void)0)
+
+#define ATF_BENCH(bm) \
+    static void atfu_ ## bm ## _head(atf_tc_t *); \
+    ATFU_BENCH(#bm, atfu_ ## bm, atfu_ ## bm ## _head(atfu_tc))
+
+#define ATF_BENCH_HEAD(bm, tcptr) \
+    static \
+    void \
+    atfu_ ## bm ## _head(atf_tc_t *tcptr ATF_DEFS_ATTRIBUTE_UNUSED)
+
+#define ATF_BENCH_BODY(bm, tcptr, iters) \
+    static \
+    void \
+    atfu_ ## bm ## _bench(const atf_tc_t *tcptr ATF_DEFS_ATTRIBUTE_UNUSED, \
+                         const size_t iters)
+
+#define ATF_BENCH_BODY_NAME(bm) \
+    (atfu_ ## bm ## _bench)
+
 #define ATF_TP_ADD_TCS(tps) \
     static atf_error_t atfu_tp_add_tcs(atf_tp_t *); \
     int atf_tp_main(int, char **, atf_error_t (*)(atf_tp_t *)); \
@@ -127,6 +172,45 @@
             return atfu_err; \
     } while (0)
 
+#define ATF_TP_ADD_BENCH(tp, bm) \
+    ATF_TP_ADD_TC(tp, bm)
+
+#define ATF_REQUIRE_PERF(name, statement) \
+    do { \
+        atf_tc_perf_t atfu_perf; \
+        for (atf_tc_perf_begin(&atfu_perf, name); \
+             atf_tc_perf_next(&atfu_perf); ) { \
+            statement; \
+        } \
+        atf_tc_perf_end(&atfu_perf, __FILE__, __LINE__, true); \
+    } while (0)
+
+#define ATF_CHECK_PERF(name, statement) \
+    do { \
+        atf_tc_perf_t atfu_perf; \
+        for (atf_tc_perf_begin(&atfu_perf, name); \
+             atf_tc_perf_next(&atfu_perf); ) { \
+            statement; \
+        } \
+        atf_tc_perf_end(&atfu_perf, __FILE__, __LINE__, false); \
+    } while (0)
+
+#define ATF_REQUIRE_MAX_ALLOCS(max, statement) \
+    do { \
+        atf_tc_alloc_t atfu_alloc; \
+        atf_tc_alloc_begin(&atfu_alloc); \
+        statement; \
+        atf_tc_alloc_end(&atfu_alloc, max, __FILE__, __LINE__, true); \
+    } while (0)
+
+#define ATF_CHECK_MAX_ALLOCS(max, statement) \
+    do { \
+        atf_tc_alloc_t atfu_alloc; \
+        atf_tc_alloc_begin(&atfu_alloc); \
+        statement; \
+        atf_tc_alloc_end(&atfu_alloc, max, __FILE__, __LINE__, false); \
+    } while (0)
+
 #define ATF_REQUIRE_MSG(expression, fmt, ...) \
     do { \
         if (!(expression)) \
@@ -100,3 +100,15 @@ ATF_TC_BODY(TEST_MACRO_3, tc) { if (tc != NULL) {} }
 atf_tc_t *test_name_3 = &ATF_TC_NAME(TEST_MACRO_3);
 atf_tc_pack_t *test_pack_3 = &ATF_TC_PACK_NAME(TEST_MACRO_3);
 void (*body_3)(const atf_tc_t *) = ATF_TC_BODY_NAME(TEST_MACRO_3);
+#define TEST_MACRO_4 invalid + name
+#define TEST_MACRO_5 invalid + name
+ATF_BENCH(TEST_MACRO_4);
+ATF_BENCH_HEAD(TEST_MACRO_4, tc) { if (tc != NULL) {} }
+ATF_BENCH_BODY(TEST_MACRO_4, tc, n) { if (tc != NULL && n > 0) {} }
+atf_tc_t *test_name_4 = &ATF_TC_NAME(TEST_MACRO_4);
+atf_tc_pack_t *test_pack_4 = &ATF_TC_PACK_NAME(TEST_MACRO_4);
+atf_tc_bench_t bench_4 = ATF_BENCH_BODY_NAME(TEST_MACRO_4);
+ATF_BENCH_WITHOUT_HEAD(TEST_MACRO_5);
+ATF_BENCH_BODY(TEST_MACRO_5, tc, n) { if (tc != NULL && n > 0) {} }
+atf_tc_t *test_name_5 = &ATF_TC_NAME(TEST_MACRO_5);
+atf_tc_pack_t *test_pack_5 = &ATF_TC_PACK_NAME(TEST_MACRO_5);
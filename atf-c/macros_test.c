@@ -831,6 +831,123 @@ ATF_TC_BODY(msg_embedded_fmt, tc)
     }
 }
 
+ATF_BENCH(h_bench);
+ATF_BENCH_HEAD(h_bench, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper benchmark");
+}
+ATF_BENCH_BODY(h_bench, tc, iters)
+{
+    volatile size_t sum = 0;
+    size_t i;
+
+    ATF_CHECK(iters > 0);
+    for (i = 0; i < iters; i++)
+        sum += i;
+}
+
+ATF_TC(bench);
+ATF_TC_HEAD(bench, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the ATF_BENCH macros");
+}
+ATF_TC_BODY(bench, tc)
+{
+    atf_tc_t *bm = &ATF_TC_NAME(h_bench);
+    const char *const config[] = { "bench.time_ms", "1", "bench.runs", "3",
+                                   NULL };
+
+    RE(atf_tc_init_pack(bm, &ATF_TC_PACK_NAME(h_bench), config));
+    ATF_CHECK_STREQ("benchmark", atf_tc_get_md_var(bm, "X-type"));
+    ATF_CHECK_STREQ("Helper benchmark", atf_tc_get_md_var(bm, "descr"));
+    run_h_tc(bm, "output", "error", "result");
+    atf_tc_fini(bm);
+
+    ATF_CHECK(atf_utils_grep_file("^passed$", "result"));
+    ATF_CHECK(atf_utils_grep_file("^bench: h_bench: [0-9]+ iterations x 3 "
+        "runs; per iteration: min [0-9.]+ ns, median [0-9.]+ ns, "
+        "p99 [0-9.]+ ns; [0-9]+ iterations/s$", "output"));
+}
+
+ATF_TC(h_perf);
+ATF_TC_HEAD(h_perf, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+}
+ATF_TC_BODY(h_perf, tc)
+{
+    volatile size_t sum = 0;
+    size_t i;
+
+    ATF_REQUIRE_PERF("loop", for (i = 0; i < 1000; i++) sum += i);
+    create_ctl_file("after");
+}
+
+ATF_TC(perf);
+ATF_TC_HEAD(perf, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the ATF_REQUIRE_PERF macro");
+}
+ATF_TC_BODY(perf, tc)
+{
+    atf_tc_t *h = &ATF_TC_NAME(h_perf);
+    const char *const config[] = { "perf.baseline", "base",
+                                   "perf.samples", "3", NULL };
+
+    RE(atf_tc_init_pack(h, &ATF_TC_PACK_NAME(h_perf), config));
+    run_h_tc(h, "output", "error", "result");
+    ATF_CHECK(atf_utils_grep_file("^passed$", "result"));
+    ATF_CHECK(atf_utils_grep_file("^perf: h_perf/loop: median [0-9.]+ ns, "
+        "deviation [0-9.]+ ns; no entry in base$", "output"));
+    ATF_CHECK(exists("after"));
+
+    atf_utils_create_file("base", "h_perf/loop 1000000000000.0 0.0\n");
+    run_h_tc(h, "output", "error", "result");
+    ATF_CHECK(atf_utils_grep_file("^passed$", "result"));
+    ATF_CHECK(atf_utils_grep_file("^perf: h_perf/loop: .* is within ",
+                                  "output"));
+
+    atf_utils_create_file("base", "h_perf/loop 0.0 0.0\n");
+    ATF_REQUIRE(unlink("after") != -1);
+    run_h_tc(h, "output", "error", "result");
+    ATF_CHECK(atf_utils_grep_file("^failed: .*macros_test.c:[0-9]+: "
+        "Performance regression: h_perf/loop: .* exceeds ", "result"));
+    ATF_CHECK(!exists("after"));
+    atf_tc_fini(h);
+}
+
+ATF_TC(h_max_allocs);
+ATF_TC_HEAD(h_max_allocs, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+}
+ATF_TC_BODY(h_max_allocs, tc)
+{
+    ATF_REQUIRE_MAX_ALLOCS(1, create_ctl_file("inside"));
+    create_ctl_file("after");
+}
+
+ATF_TC(max_allocs);
+ATF_TC_HEAD(max_allocs, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that ATF_REQUIRE_MAX_ALLOCS "
+                      "fails when the allocator hooks are not linked in");
+}
+ATF_TC_BODY(max_allocs, tc)
+{
+    atf_tc_t *h = &ATF_TC_NAME(h_max_allocs);
+
+    RE(atf_tc_init_pack(h, &ATF_TC_PACK_NAME(h_max_allocs), NULL));
+    run_h_tc(h, "output", "error", "result");
+    atf_tc_fini(h);
+
+    ATF_CHECK(atf_utils_grep_file("^failed: An allocation budget needs "
+        "allocation tracking; link the test program against "
+        "libatf-c-alloc$", "result"));
+    ATF_CHECK(!exists("inside"));
+    ATF_CHECK(!exists("after"));
+}
+
 /* ---------------------------------------------------------------------
  * Tests cases for the header file.
  * --------------------------------------------------------------------- */
@@ -885,6 +1002,10 @@ ATF_TP_ADD_TCS(tp)
 
     ATF_TP_ADD_TC(tp, msg_embedded_fmt);
 
+    ATF_TP_ADD_TC(tp, bench);
+    ATF_TP_ADD_TC(tp, perf);
+    ATF_TP_ADD_TC(tp, max_allocs);
+
     /* Add the test cases for the header file. */
     ATF_TP_ADD_TC(tp, use);
     ATF_TP_ADD_TC(tp, detect_unused_tests);
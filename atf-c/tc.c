@@ -31,20 +31,27 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "atf-c/defs.h"
+#include "atf-c/detail/alloc.h"
+#include "atf-c/detail/counters.h"
 #include "atf-c/detail/env.h"
 #include "atf-c/detail/fs.h"
 #include "atf-c/detail/map.h"
+#include "atf-c/detail/perf.h"
 #include "atf-c/detail/sanity.h"
 #include "atf-c/detail/text.h"
+#include "atf-c/detail/trace.h"
 #include "atf-c/error.h"
 
 /* ---------------------------------------------------------------------
@@ -60,20 +67,65 @@ enum expect_type {
     EXPECT_TIMEOUT,
 };
 
+/* A check failure raised by a thread other than the one running the test
+ * case.  These are queued in a lock-free stack and printed later on by the
+ * main thread so that workers never contend on stderr. */
+struct failure {
+    struct failure *next;
+    char line[];
+};
+
+/* A location that raised check failures.  Failures are keyed by file and
+ * line when known; all the others share a single site without a file so
+ * that failures with varying messages cannot exhaust the table. */
+struct site {
+    const char *file;
+    size_t line;
+    atomic_size_t count;
+};
+
+#define SITES_SIZE 256
+
+/* The fields that can be updated from any thread are atomic.  The rest
+ * belong to the thread running the test case; in particular, expectations
+ * must be set before spawning any threads that raise failures. */
 struct context {
     const atf_tc_t *tc;
     const char *resfile;
     int resfilefd;
-    size_t fail_count;
+    atomic_size_t fail_count;
 
     enum expect_type expect;
     atf_dynstr_t expect_reason;
     size_t expect_previous_fail_count;
-    size_t expect_fail_count;
+    atomic_size_t expect_fail_count;
     int expect_exitcode;
     int expect_signo;
+
+    _Atomic(struct failure *) failures;
+    atomic_flag terminating;
+
+    long max_reported;
+    _Atomic(struct site *) sites[SITES_SIZE];
+
+    /* Counters around the body, stopped when the result is known. */
+    bool counting;
+    atf_counters_t counters;
+
+    /* Whether the body has an open event in the trace. */
+    bool tracing_body;
+
+    /* Allocation totals when profiling of the body started. */
+    bool profiling_alloc;
+    atf_alloc_stats_t alloc_start;
 };
 
+/* Whether the calling thread is the one that invoked atf_tc_run. */
+static _Thread_local bool In_main_thread = false;
+
+/* Whether the calling thread is the one terminating the test case. */
+static _Thread_local bool Terminating_thread = false;
+
 static void context_init(struct context *, const atf_tc_t *, const char *);
 static void context_set_resfile(struct context *, const char *);
 static void context_close_resfile(struct context *);
@@ -91,6 +143,16 @@ static void expected_failure(struct context *, atf_dynstr_t *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
 static void fail_requirement(struct context *, atf_dynstr_t *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
+static void begin_termination(struct context *);
+static void log_failure(struct context *, const char *, const char *,
+                        const char *);
+static void flush_failures(struct context *);
+static bool should_report(struct context *, const char *, const size_t);
+static void report_suppressed(struct context *);
+static void report_counters(struct context *);
+static void report_alloc_profile(struct context *);
+static void fail_check_at(struct context *, const char *, const size_t,
+                          atf_dynstr_t *);
 static void fail_check(struct context *, atf_dynstr_t *);
 static void pass(struct context *)
     ATF_DEFS_ATTRIBUTE_NORETURN;
@@ -100,10 +162,14 @@ static void format_reason_ap(atf_dynstr_t *, const char *, const size_t,
                              const char *, va_list);
 static void format_reason_fmt(atf_dynstr_t *, const char *, const size_t,
                               const char *, ...);
+static void fail_requirement_at(struct context *, const char *,
+                                const size_t, atf_dynstr_t *)
+    ATF_DEFS_ATTRIBUTE_NORETURN;
 static void errno_test(struct context *, const char *, const size_t,
                        const int, const char *, const bool,
-                       void (*)(struct context *, atf_dynstr_t *));
-static atf_error_t check_prog_in_dir(const char *, void *);
+                       void (*)(struct context *, const char *, const size_t,
+                                atf_dynstr_t *));
+static atf_error_t check_prog_in_dir(const char *, const size_t, void *);
 static atf_error_t check_prog(struct context *, const char *);
 
 /* No prototype in header for this one, it's a little sketchy (internal). */
@@ -112,17 +178,26 @@ void atf_tc_set_resultsfile(const char *);
 static void
 context_init(struct context *ctx, const atf_tc_t *tc, const char *resfile)
 {
+    size_t i;
 
     ctx->tc = tc;
     ctx->resfilefd = -1;
     context_set_resfile(ctx, resfile);
-    ctx->fail_count = 0;
+    atomic_init(&ctx->fail_count, 0);
     ctx->expect = EXPECT_PASS;
     check_fatal_error(atf_dynstr_init(&ctx->expect_reason));
     ctx->expect_previous_fail_count = 0;
-    ctx->expect_fail_count = 0;
+    atomic_init(&ctx->expect_fail_count, 0);
     ctx->expect_exitcode = 0;
     ctx->expect_signo = 0;
+    atomic_init(&ctx->failures, NULL);
+    atomic_flag_clear(&ctx->terminating);
+    ctx->max_reported = 0;
+    for (i = 0; i < SITES_SIZE; i++)
+        atomic_init(&ctx->sites[i], NULL);
+    ctx->counting = false;
+    ctx->tracing_body = false;
+    ctx->profiling_alloc = false;
 }
 
 static void
@@ -251,6 +326,8 @@ create_resfile(struct context *ctx, const char *result, const int arg,
 {
     atf_error_t err;
 
+    flush_failures(ctx);
+
     /*
      * We'll attempt to truncate the results file, but only if it's not pointed
      * at stdout/stderr.  We could just blindly ftruncate() here, but it may
@@ -259,10 +336,12 @@ create_resfile(struct context *ctx, const char *result, const int arg,
      * but it will also redirect the results directly to some file and we'll
      * have no issue here.
      */
+    atf_trace_begin("results", result);
     if (ctx->resfilefd != STDOUT_FILENO && ctx->resfilefd != STDERR_FILENO &&
         ftruncate(ctx->resfilefd, 0) != -1)
         lseek(ctx->resfilefd, 0, SEEK_SET);
     err = write_resfile(ctx->resfilefd, result, arg, reason);
+    atf_trace_end("results");
 
     if (reason != NULL)
         atf_dynstr_fini(reason);
@@ -292,6 +371,10 @@ error_in_expect(struct context *ctx, const char *fmt, ...)
 static void
 validate_expect(struct context *ctx)
 {
+    if (!In_main_thread)
+        error_in_expect(ctx, "Expectations can only be changed from the "
+            "thread running the test case");
+
     if (ctx->expect == EXPECT_DEATH) {
         error_in_expect(ctx, "Test case was expected to terminate abruptly "
             "but it continued execution");
@@ -316,9 +399,38 @@ validate_expect(struct context *ctx)
         UNREACHABLE;
 }
 
+/** Ensures that only one thread reports the final result.
+ *
+ * Any other thread trying to terminate the test case at the same time
+ * waits for the winner to exit the process.  This is reentrant so that
+ * the winner can go through several of the functions below.
+ */
+static void
+begin_termination(struct context *ctx)
+{
+    if (Terminating_thread)
+        return;
+
+    if (atomic_flag_test_and_set(&ctx->terminating)) {
+        for (;;)
+            pause();
+    }
+    Terminating_thread = true;
+
+    if (ctx->tracing_body && In_main_thread) {
+        atf_trace_end("body");
+        ctx->tracing_body = false;
+    }
+    report_counters(ctx);
+    report_alloc_profile(ctx);
+    flush_failures(ctx);
+    report_suppressed(ctx);
+}
+
 static void
 expected_failure(struct context *ctx, atf_dynstr_t *reason)
 {
+    begin_termination(ctx);
     check_fatal_error(atf_dynstr_prepend_fmt(reason, "%s: ",
         atf_dynstr_cstring(&ctx->expect_reason)));
     create_resfile(ctx, "expected_failure", -1, reason);
@@ -329,6 +441,7 @@ expected_failure(struct context *ctx, atf_dynstr_t *reason)
 static void
 fail_requirement(struct context *ctx, atf_dynstr_t *reason)
 {
+    begin_termination(ctx);
     if (ctx->expect == EXPECT_FAIL) {
         expected_failure(ctx, reason);
     } else if (ctx->expect == EXPECT_PASS) {
@@ -342,28 +455,222 @@ fail_requirement(struct context *ctx, atf_dynstr_t *reason)
     UNREACHABLE;
 }
 
+/* Adapts fail_requirement to the callbacks that know the location of the
+ * failure. */
 static void
-fail_check(struct context *ctx, atf_dynstr_t *reason)
+fail_requirement_at(struct context *ctx, const char *file, const size_t line,
+                    atf_dynstr_t *reason)
+{
+    (void)file;
+    (void)line;
+    fail_requirement(ctx, reason);
+}
+
+/** Reports a check failure.
+ *
+ * The main thread prints it right away, as it always did.  Other threads
+ * push it to the context's failure stack instead, which flush_failures
+ * drains in order.  If the record cannot be allocated, the line is printed
+ * directly: it may interleave with others but is never lost.
+ */
+static void
+log_failure(struct context *ctx, const char *prefix, const char *expect,
+            const char *reason)
+{
+    struct failure *f;
+    size_t length;
+
+    if (In_main_thread) {
+        flush_failures(ctx);
+        if (expect != NULL)
+            fprintf(stderr, "%s%s: %s\n", prefix, expect, reason);
+        else
+            fprintf(stderr, "%s%s\n", prefix, reason);
+        return;
+    }
+
+    length = strlen(prefix) + (expect != NULL ? strlen(expect) + 2 : 0) +
+        strlen(reason) + 1;
+    f = malloc(sizeof(*f) + length);
+    if (f == NULL) {
+        fprintf(stderr, "%s%s\n", prefix, reason);
+        return;
+    }
+    if (expect != NULL)
+        snprintf(f->line, length, "%s%s: %s", prefix, expect, reason);
+    else
+        snprintf(f->line, length, "%s%s", prefix, reason);
+
+    f->next = atomic_load(&ctx->failures);
+    while (!atomic_compare_exchange_weak(&ctx->failures, &f->next, f))
+        continue; /* f->next now holds the new head; retry. */
+}
+
+/** Prints and releases all failures queued by other threads so far. */
+static void
+flush_failures(struct context *ctx)
+{
+    struct failure *f, *reversed;
+
+    /* Take the whole stack at once and reverse it to recover the order in
+     * which failures were raised. */
+    f = atomic_exchange(&ctx->failures, NULL);
+    reversed = NULL;
+    while (f != NULL) {
+        struct failure *next = f->next;
+        f->next = reversed;
+        reversed = f;
+        f = next;
+    }
+
+    while (reversed != NULL) {
+        struct failure *next = reversed->next;
+        fprintf(stderr, "%s\n", reversed->line);
+        free(reversed);
+        reversed = next;
+    }
+}
+
+static size_t
+hash_string(const char *str)
+{
+    size_t h = 2166136261u;
+
+    for (; *str != '\0'; str++)
+        h = (h ^ (unsigned char)*str) * 16777619u;
+    return h;
+}
+
+static bool
+site_matches(const struct site *site, const char *file, const size_t line)
+{
+    if (file != NULL)
+        return site->file != NULL && site->line == line &&
+            strcmp(site->file, file) == 0;
+    else
+        return site->file == NULL;
+}
+
+/** Looks up the record of a failure site, creating it if necessary.
+ *
+ * Records are published with a compare-and-swap on an open-addressed table
+ * so that concurrent failures never block each other.  Returns NULL if the
+ * table is full or memory is exhausted.
+ */
+static struct site *
+find_site(struct context *ctx, const char *file, const size_t line)
+{
+    const size_t h = file != NULL ? hash_string(file) ^ (line * 31) : 0;
+    struct site *fresh = NULL;
+    size_t i;
+
+    for (i = 0; i < SITES_SIZE; i++) {
+        _Atomic(struct site *) *slot = &ctx->sites[(h + i) % SITES_SIZE];
+        struct site *site = atomic_load(slot);
+
+        if (site == NULL) {
+            if (fresh == NULL) {
+                fresh = malloc(sizeof(*fresh));
+                if (fresh == NULL)
+                    return NULL;
+                fresh->file = file;
+                fresh->line = line;
+                atomic_init(&fresh->count, 0);
+            }
+            if (atomic_compare_exchange_strong(slot, &site, fresh))
+                return fresh;
+            /* Somebody else took the slot; site now holds its record. */
+        }
+        if (site_matches(site, file, line)) {
+            free(fresh);
+            return site;
+        }
+    }
+
+    free(fresh);
+    return NULL;
+}
+
+/** Decides whether a check failure has to be printed.
+ *
+ * Only the first max_reported failures of every site are printed; the rest
+ * are just counted so that report_suppressed can summarize them.
+ */
+static bool
+should_report(struct context *ctx, const char *file, const size_t line)
+{
+    struct site *site;
+
+    if (ctx->max_reported == 0)
+        return true;
+
+    site = find_site(ctx, file, line);
+    if (site == NULL)
+        return true;
+    return atomic_fetch_add(&site->count, 1) < (size_t)ctx->max_reported;
+}
+
+static void
+report_suppressed(struct context *ctx)
+{
+    size_t i;
+
+    if (ctx->max_reported == 0)
+        return;
+
+    for (i = 0; i < SITES_SIZE; i++) {
+        const struct site *site = atomic_load(&ctx->sites[i]);
+        size_t count;
+
+        if (site == NULL)
+            continue;
+        count = atomic_load(&site->count);
+        if (count <= (size_t)ctx->max_reported)
+            continue;
+
+        count -= ctx->max_reported;
+        if (site->file != NULL)
+            fprintf(stderr, "*** %zu more check failures at %s:%zu were not "
+                "reported\n", count, site->file, site->line);
+        else
+            fprintf(stderr, "*** %zu more check failures without a location "
+                "were not reported\n", count);
+    }
+}
+
+static void
+fail_check_at(struct context *ctx, const char *file, const size_t line,
+              atf_dynstr_t *reason)
 {
+    const char *text = atf_dynstr_cstring(reason);
+
     if (ctx->expect == EXPECT_FAIL) {
-        fprintf(stderr, "*** Expected check failure: %s: %s\n",
-            atf_dynstr_cstring(&ctx->expect_reason),
-            atf_dynstr_cstring(reason));
-        ctx->expect_fail_count++;
+        if (should_report(ctx, file, line))
+            log_failure(ctx, "*** Expected check failure: ",
+                        atf_dynstr_cstring(&ctx->expect_reason), text);
+        atomic_fetch_add(&ctx->expect_fail_count, 1);
     } else if (ctx->expect == EXPECT_PASS) {
-        fprintf(stderr, "*** Check failed: %s\n", atf_dynstr_cstring(reason));
-        ctx->fail_count++;
+        if (should_report(ctx, file, line))
+            log_failure(ctx, "*** Check failed: ", NULL, text);
+        atomic_fetch_add(&ctx->fail_count, 1);
     } else {
         error_in_expect(ctx, "Test case raised a failure but was not "
-            "expecting one; reason was %s", atf_dynstr_cstring(reason));
+            "expecting one; reason was %s", text);
     }
 
     atf_dynstr_fini(reason);
 }
 
+static void
+fail_check(struct context *ctx, atf_dynstr_t *reason)
+{
+    fail_check_at(ctx, NULL, 0, reason);
+}
+
 static void
 pass(struct context *ctx)
 {
+    begin_termination(ctx);
     if (ctx->expect == EXPECT_FAIL) {
         error_in_expect(ctx, "Test case was expecting a failure but got "
             "a pass instead");
@@ -381,6 +688,7 @@ pass(struct context *ctx)
 static void
 skip(struct context *ctx, atf_dynstr_t *reason)
 {
+    begin_termination(ctx);
     create_resfile(ctx, "skipped", -1, reason);
     context_close_resfile(ctx);
     exit(EXIT_SUCCESS);
@@ -439,7 +747,8 @@ static void
 errno_test(struct context *ctx, const char *file, const size_t line,
            const int exp_errno, const char *expr_str,
            const bool expr_result,
-           void (*fail_func)(struct context *, atf_dynstr_t *))
+           void (*fail_func)(struct context *, const char *, const size_t,
+                             atf_dynstr_t *))
 {
     const int actual_errno = errno;
 
@@ -449,14 +758,14 @@ errno_test(struct context *ctx, const char *file, const size_t line,
 
             format_reason_fmt(&reason, file, line, "Expected errno %d, got %d, "
                 "in %s", exp_errno, actual_errno, expr_str);
-            fail_func(ctx, &reason);
+            fail_func(ctx, file, line, &reason);
         }
     } else {
         atf_dynstr_t reason;
 
         format_reason_fmt(&reason, file, line, "Expected true value in %s",
             expr_str);
-        fail_func(ctx, &reason);
+        fail_func(ctx, file, line, &reason);
     }
 }
 
@@ -466,7 +775,7 @@ struct prog_found_pair {
 };
 
 static atf_error_t
-check_prog_in_dir(const char *dir, void *data)
+check_prog_in_dir(const char *dir, const size_t length, void *data)
 {
     struct prog_found_pair *pf = data;
     atf_error_t err;
@@ -476,7 +785,8 @@ check_prog_in_dir(const char *dir, void *data)
     else {
         atf_fs_path_t p;
 
-        err = atf_fs_path_init_fmt(&p, "%s/%s", dir, pf->prog);
+        err = atf_fs_path_init_fmt(&p, "%.*s/%s", (int)length, dir,
+                                   pf->prog);
         if (atf_is_error(err))
             goto out_p;
 
@@ -537,7 +847,7 @@ check_prog(struct context *ctx, const char *prog)
 
         pf.prog = prog;
         pf.found = false;
-        err = atf_text_for_each_word(path, ":", check_prog_in_dir, &pf);
+        err = atf_text_for_each_token(path, ":", check_prog_in_dir, &pf);
         if (atf_is_error(err))
             goto out_bp;
 
@@ -617,8 +927,11 @@ atf_tc_init(atf_tc_t *tc, const char *ident, atf_tc_head_t head,
     }
 
     /* XXX Should the head be able to return error codes? */
-    if (tc->pimpl->m_head != NULL)
+    if (tc->pimpl->m_head != NULL) {
+        atf_trace_begin("head", ident);
         tc->pimpl->m_head(tc);
+        atf_trace_end("head");
+    }
 
     if (strcmp(atf_tc_get_md_var(tc, "ident"), ident) != 0) {
         report_fatal_error("Test case head modified the read-only 'ident' "
@@ -794,6 +1107,28 @@ atf_tc_has_md_var(const atf_tc_t *tc, const char *name)
     return !atf_equal_map_citer_map_citer(iter, end);
 }
 
+/* Calls 'func' with the name and value of every meta-data property of
+ * the test case, without copying them, in the order in which they were
+ * first defined; this means that 'ident' always comes first.  Iteration
+ * stops at the first error returned by 'func'. */
+atf_error_t
+atf_tc_for_each_md_var(const atf_tc_t *tc,
+                       atf_error_t (*func)(const char *, const char *, void *),
+                       void *data)
+{
+    atf_error_t err;
+    atf_map_citer_t iter;
+
+    err = atf_no_error();
+    atf_map_for_each_c(iter, &tc->pimpl->m_vars) {
+        err = func(atf_map_citer_key(iter), atf_map_citer_data(iter), data);
+        if (atf_is_error(err))
+            break;
+    }
+
+    return err;
+}
+
 /*
  * Modifiers.
  */
@@ -883,7 +1218,7 @@ _atf_tc_fail_check(struct context *ctx, const char *file, const size_t line,
     format_reason_ap(&reason, file, line, fmt, ap2);
     va_end(ap2);
 
-    fail_check(ctx, &reason);
+    fail_check_at(ctx, file, line, &reason);
 }
 
 static void
@@ -932,7 +1267,8 @@ _atf_tc_check_errno(struct context *ctx, const char *file, const size_t line,
                     const int exp_errno, const char *expr_str,
                     const bool expr_result)
 {
-    errno_test(ctx, file, line, exp_errno, expr_str, expr_result, fail_check);
+    errno_test(ctx, file, line, exp_errno, expr_str, expr_result,
+        fail_check_at);
 }
 
 static void
@@ -941,7 +1277,7 @@ _atf_tc_require_errno(struct context *ctx, const char *file, const size_t line,
                       const bool expr_result)
 {
     errno_test(ctx, file, line, exp_errno, expr_str, expr_result,
-        fail_requirement);
+        fail_requirement_at);
 }
 
 static void
@@ -964,7 +1300,7 @@ _atf_tc_expect_fail(struct context *ctx, const char *reason, va_list ap)
     va_copy(ap2, ap);
     check_fatal_error(atf_dynstr_init_ap(&ctx->expect_reason, reason, ap2));
     va_end(ap2);
-    ctx->expect_previous_fail_count = ctx->expect_fail_count;
+    ctx->expect_previous_fail_count = atomic_load(&ctx->expect_fail_count);
 }
 
 static void
@@ -1046,26 +1382,532 @@ _atf_tc_set_resultsfile(struct context *ctx, const char *file)
 
 static struct context Current;
 
+/** Gets a tunable of the test case runner, or NULL if not set.
+ *
+ * The configuration variable takes precedence over the X- metadata
+ * property, so that any test case can be tuned from the command line.
+ */
+static const char *
+runner_value(struct context *ctx, const char *name)
+{
+    const atf_tc_t *tc = ctx->tc;
+    char mdname[64];
+
+    snprintf(mdname, sizeof(mdname), "X-%s", name);
+    if (atf_tc_has_config_var(tc, name))
+        return atf_tc_get_config_var(tc, name);
+    else if (atf_tc_has_md_var(tc, mdname))
+        return atf_tc_get_md_var(tc, mdname);
+    else
+        return NULL;
+}
+
+/** Gets a numeric tunable of the test case runner.
+ *
+ * Values below min fail the test case.
+ */
+static long
+runner_param(struct context *ctx, const char *name, const long defval,
+             const long min)
+{
+    const char *value = runner_value(ctx, name);
+    atf_error_t err;
+    long l;
+
+    if (value == NULL)
+        return defval;
+
+    err = atf_text_to_long(value, &l);
+    if (atf_is_error(err) || l < min) {
+        atf_dynstr_t reason;
+
+        if (atf_is_error(err))
+            atf_error_free(err);
+        format_reason_fmt(&reason, NULL, 0, "Invalid value '%s' for %s; "
+            "must be an integer greater than or equal to %ld", value, name,
+            min);
+        fail_requirement(ctx, &reason);
+    }
+    return l;
+}
+
+struct stress {
+    const atf_tc_t *tc;
+    long iterations;
+
+    /* Start barrier: workers wait until all of them have been spawned. */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    long threads;
+    long ready;
+};
+
+static void *
+stress_worker(void *v)
+{
+    struct stress *st = v;
+    long i;
+
+    pthread_mutex_lock(&st->mutex);
+    st->ready++;
+    if (st->ready >= st->threads)
+        pthread_cond_broadcast(&st->cond);
+    else {
+        while (st->ready < st->threads)
+            pthread_cond_wait(&st->cond, &st->mutex);
+    }
+    pthread_mutex_unlock(&st->mutex);
+
+    for (i = 0; i < st->iterations; i++)
+        st->tc->pimpl->m_body(st->tc);
+    return NULL;
+}
+
+/** Runs the body from several threads at once, several times each.
+ *
+ * Failures raised by the workers are aggregated through the context as
+ * usual and the result is computed once all of them are done.
+ */
+static void
+run_stress(struct context *ctx, const long threads, const long iterations)
+{
+    struct stress st;
+    pthread_t *tids;
+    long i, created;
+    int ret;
+
+    tids = malloc(threads * sizeof(*tids));
+    if (tids == NULL)
+        check_fatal_error(atf_no_memory_error());
+
+    st.tc = ctx->tc;
+    st.iterations = iterations;
+    pthread_mutex_init(&st.mutex, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    st.threads = threads;
+    st.ready = 0;
+
+    ret = 0;
+    for (created = 0; created < threads; created++) {
+        ret = pthread_create(&tids[created], NULL, stress_worker, &st);
+        if (ret != 0)
+            break;
+    }
+    if (ret != 0) {
+        /* Release the workers spawned so far before giving up. */
+        pthread_mutex_lock(&st.mutex);
+        st.threads = created;
+        pthread_cond_broadcast(&st.cond);
+        pthread_mutex_unlock(&st.mutex);
+    }
+
+    for (i = 0; i < created; i++)
+        pthread_join(tids[i], NULL);
+
+    pthread_cond_destroy(&st.cond);
+    pthread_mutex_destroy(&st.mutex);
+    free(tids);
+
+    if (ret != 0) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, NULL, 0, "Failed to spawn stress thread "
+            "%ld of %ld: %s", created + 1, threads, strerror(ret));
+        fail_requirement(ctx, &reason);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Benchmarks.
+ * --------------------------------------------------------------------- */
+
+static double
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** Runs a benchmark body once and returns the elapsed time in nanoseconds. */
+static double
+time_bench(const atf_tc_t *tc, atf_tc_bench_t bench, const size_t iters)
+{
+    const double start = monotonic_ns();
+
+    bench(tc, iters);
+    return monotonic_ns() - start;
+}
+
+/** Finds the number of iterations that makes a run last at least target
+ * nanoseconds.
+ *
+ * The count grows geometrically, aiming a bit past the target to converge
+ * quickly, but never more than 100-fold in one step so that a body whose
+ * first iterations are unusually fast cannot make the next run endless.
+ */
+static size_t
+calibrate_bench(const atf_tc_t *tc, atf_tc_bench_t bench, const double target)
+{
+    size_t iters = 1;
+
+    for (;;) {
+        const double elapsed = time_bench(tc, bench, iters);
+        double next;
+
+        if (elapsed >= target || iters >= SIZE_MAX / 100)
+            break;
+
+        next = elapsed > 0 ? iters * target * 1.2 / elapsed : iters * 100.0;
+        if (next < iters * 2.0)
+            next = iters * 2.0;
+        else if (next > iters * 100.0)
+            next = iters * 100.0;
+        iters = (size_t)next;
+    }
+
+    return iters;
+}
+
+static void
+_atf_tc_run_bench(struct context *ctx, atf_tc_bench_t bench)
+{
+    const long time_ms = runner_param(ctx, "bench.time_ms", 50, 1);
+    const long runs = runner_param(ctx, "bench.runs", 10, 1);
+    double *samples, median;
+    size_t iters;
+    long i;
+
+    samples = malloc(runs * sizeof(*samples));
+    if (samples == NULL)
+        check_fatal_error(atf_no_memory_error());
+
+    iters = calibrate_bench(ctx->tc, bench, time_ms * 1e6);
+    for (i = 0; i < runs; i++)
+        samples[i] = time_bench(ctx->tc, bench, iters) / iters;
+    atf_perf_sort(samples, runs);
+
+    /* Percentiles use the nearest-rank method. */
+    median = samples[(runs - 1) / 2];
+    printf("bench: %s: %zu iterations x %ld runs; per iteration: "
+        "min %.1f ns, median %.1f ns, p99 %.1f ns; %.0f iterations/s\n",
+        atf_tc_get_ident(ctx->tc), iters, runs, samples[0], median,
+        samples[(runs * 99 + 99) / 100 - 1], median > 0 ? 1e9 / median : 0);
+    fflush(stdout);
+
+    free(samples);
+}
+
+/* ---------------------------------------------------------------------
+ * Performance checks.
+ * --------------------------------------------------------------------- */
+
+static void
+fail_with_error(struct context *ctx, const char *file, const size_t line,
+                atf_error_t err)
+{
+    atf_dynstr_t reason;
+    char buf[1024];
+
+    atf_error_format(err, buf, sizeof(buf));
+    atf_error_free(err);
+    format_reason_fmt(&reason, file, line, "%s", buf);
+    fail_requirement(ctx, &reason);
+}
+
+/** Reads the perf.* configuration variables. */
+static void
+perf_config(struct context *ctx, atf_perf_config_t *config)
+{
+    static const char *const names[] = {
+        "perf.baseline", "perf.record", "perf.tolerance", NULL
+    };
+    const char *const *name;
+
+    atf_perf_config_init(config);
+    for (name = names; *name != NULL; name++) {
+        if (atf_tc_has_config_var(ctx->tc, *name)) {
+            atf_error_t err = atf_perf_config_set(config, *name,
+                atf_tc_get_config_var(ctx->tc, *name));
+            if (atf_is_error(err))
+                fail_with_error(ctx, NULL, 0, err);
+        }
+    }
+    config->m_samples = runner_param(ctx, "perf.samples", config->m_samples,
+                                     1);
+}
+
+static void
+_atf_tc_perf_begin(struct context *ctx, atf_tc_perf_t *perf,
+                   const char *name)
+{
+    atf_perf_config_t config;
+
+    if (name[0] == '\0' || strpbrk(name, " \t\n") != NULL) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, NULL, 0, "Invalid name '%s' for a "
+            "performance check; must not be empty nor contain spaces", name);
+        fail_requirement(ctx, &reason);
+    }
+
+    perf_config(ctx, &config);
+    perf->m_name = name;
+    perf->m_total = config.m_samples;
+    perf->m_count = -1;
+    perf->m_samples = malloc(perf->m_total * sizeof(*perf->m_samples));
+    if (perf->m_samples == NULL)
+        check_fatal_error(atf_no_memory_error());
+}
+
+/** Compares the samples of a measurement against the baseline.
+ *
+ * Measurements that do not regress are just reported to stdout so that
+ * they can be collected to seed a baseline.
+ */
+static void
+_atf_tc_perf_end(struct context *ctx, atf_tc_perf_t *perf, const char *file,
+                 const size_t line, const bool fatal)
+{
+    atf_perf_config_t config;
+    atf_perf_stats_t stats;
+    atf_dynstr_t key, msg;
+    atf_error_t err;
+    bool regressed;
+
+    /* The statement may have broken out of the sampling loop. */
+    if (perf->m_count < 1) {
+        free(perf->m_samples);
+        fail_with_error(ctx, file, line, atf_libc_error(EINVAL, "No samples "
+            "taken for performance check '%s'", perf->m_name));
+    }
+
+    perf_config(ctx, &config);
+    atf_perf_stats_compute(&stats, perf->m_samples, perf->m_count);
+    free(perf->m_samples);
+
+    check_fatal_error(atf_dynstr_init_fmt(&key, "%s/%s",
+        atf_tc_get_ident(ctx->tc), perf->m_name));
+    err = atf_perf_evaluate(&config, atf_dynstr_cstring(&key), &stats,
+                            &regressed, &msg);
+    atf_dynstr_fini(&key);
+    if (atf_is_error(err))
+        fail_with_error(ctx, file, line, err);
+
+    if (!regressed) {
+        printf("perf: %s\n", atf_dynstr_cstring(&msg));
+        fflush(stdout);
+        atf_dynstr_fini(&msg);
+    } else {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, file, line, "Performance regression: %s",
+                          atf_dynstr_cstring(&msg));
+        atf_dynstr_fini(&msg);
+        if (fatal)
+            fail_requirement(ctx, &reason);
+        else
+            fail_check_at(ctx, file, line, &reason);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Performance counters.
+ * --------------------------------------------------------------------- */
+
+/** Starts the counters listed in perf.counters, if any. */
+static void
+start_counters(struct context *ctx)
+{
+    const char *spec = runner_value(ctx, "perf.counters");
+    atf_error_t err;
+
+    if (spec == NULL || spec[0] == '\0')
+        return;
+
+    err = atf_counters_init(&ctx->counters, spec);
+    if (atf_is_error(err)) {
+        atf_dynstr_t reason;
+        char buf[1024];
+
+        atf_error_format(err, buf, sizeof(buf));
+        atf_error_free(err);
+        format_reason_fmt(&reason, NULL, 0, "Invalid value '%s' for "
+            "perf.counters: %s", spec, buf);
+        fail_requirement(ctx, &reason);
+    }
+    ctx->counting = true;
+    atf_counters_start(&ctx->counters);
+}
+
+/** Stops the counters and prints their values.
+ *
+ * This happens before the result is written so that the counts cover
+ * the body only.  They go to stdout because the results file is limited
+ * to the result itself.
+ */
+static void
+report_counters(struct context *ctx)
+{
+    atf_dynstr_t out;
+
+    if (!ctx->counting)
+        return;
+    ctx->counting = false;
+
+    atf_counters_stop(&ctx->counters);
+    check_fatal_error(atf_counters_format(&ctx->counters, &out));
+    atf_counters_fini(&ctx->counters);
+    printf("counters: %s\n", atf_dynstr_cstring(&out));
+    fflush(stdout);
+    atf_dynstr_fini(&out);
+}
+
+/* ---------------------------------------------------------------------
+ * Allocation tracking.
+ * --------------------------------------------------------------------- */
+
+static void
+require_alloc_hooks(struct context *ctx, const char *what)
+{
+    if (!atf_alloc_available()) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, NULL, 0, "%s needs allocation tracking; "
+            "link the test program against libatf-c-alloc", what);
+        fail_requirement(ctx, &reason);
+    }
+}
+
+/** Starts profiling the allocations of the body if profile.alloc is set. */
+static void
+start_alloc_profile(struct context *ctx)
+{
+    const char *value = runner_value(ctx, "profile.alloc");
+    atf_error_t err;
+    bool enabled;
+
+    if (value == NULL)
+        return;
+
+    err = atf_text_to_bool(value, &enabled);
+    if (atf_is_error(err)) {
+        atf_dynstr_t reason;
+
+        atf_error_free(err);
+        format_reason_fmt(&reason, NULL, 0, "Invalid value '%s' for "
+            "profile.alloc; must be a boolean", value);
+        fail_requirement(ctx, &reason);
+    }
+    if (!enabled)
+        return;
+
+    require_alloc_hooks(ctx, "profile.alloc");
+    atf_alloc_get_stats(&ctx->alloc_start);
+    atf_alloc_profile_start();
+    ctx->profiling_alloc = true;
+}
+
+/** Prints the allocations made by the body and their top call sites.
+ *
+ * Like the counters, these go to stdout before the result is written.
+ */
+static void
+report_alloc_profile(struct context *ctx)
+{
+    atf_alloc_stats_t stats;
+    atf_dynstr_t sites;
+    long long peak;
+
+    if (!ctx->profiling_alloc)
+        return;
+    ctx->profiling_alloc = false;
+
+    atf_alloc_profile_stop();
+    atf_alloc_get_stats(&stats);
+    peak = atf_alloc_profile_peak();
+
+    check_fatal_error(atf_alloc_format_sites(&sites, 5));
+    printf("alloc: %llu allocations, %llu bytes, peak %lld bytes live; top "
+        "sites: %s\n", stats.m_count - ctx->alloc_start.m_count,
+        stats.m_bytes - ctx->alloc_start.m_bytes, peak,
+        atf_dynstr_cstring(&sites));
+    fflush(stdout);
+    atf_dynstr_fini(&sites);
+}
+
+static void
+_atf_tc_alloc_begin(struct context *ctx, atf_tc_alloc_t *alloc)
+{
+    atf_alloc_stats_t stats;
+
+    require_alloc_hooks(ctx, "An allocation budget");
+    atf_alloc_get_stats(&stats);
+    alloc->m_count = stats.m_count;
+    alloc->m_bytes = stats.m_bytes;
+}
+
+static void
+_atf_tc_alloc_end(struct context *ctx, const atf_tc_alloc_t *alloc,
+                  const unsigned long long max, const char *file,
+                  const size_t line, const bool fatal)
+{
+    atf_alloc_stats_t stats;
+    unsigned long long count;
+
+    atf_alloc_get_stats(&stats);
+    count = stats.m_count - alloc->m_count;
+    if (count > max) {
+        atf_dynstr_t reason;
+
+        format_reason_fmt(&reason, file, line, "%llu allocations (%llu "
+            "bytes) exceed the budget of %llu", count,
+            stats.m_bytes - alloc->m_bytes, max);
+        if (fatal)
+            fail_requirement(ctx, &reason);
+        else
+            fail_check_at(ctx, file, line, &reason);
+    }
+}
+
 atf_error_t
 atf_tc_run(const atf_tc_t *tc, const char *resfile)
 {
-    context_init(&Current, tc, resfile);
+    size_t fail_count, expect_fail_count;
+    long threads, iterations;
 
-    tc->pimpl->m_body(tc);
+    context_init(&Current, tc, resfile);
+    In_main_thread = true;
+
+    Current.max_reported = runner_param(&Current, "max_reported_failures",
+                                        100, 0);
+    threads = runner_param(&Current, "stress.threads", 1, 1);
+    iterations = runner_param(&Current, "stress.iterations", 1, 1);
+    start_counters(&Current);
+    start_alloc_profile(&Current);
+    atf_trace_begin("body", atf_tc_get_ident(tc));
+    Current.tracing_body = true;
+    if (threads == 1 && iterations == 1)
+        tc->pimpl->m_body(tc);
+    else
+        run_stress(&Current, threads, iterations);
 
     validate_expect(&Current);
 
-    if (Current.fail_count > 0) {
+    fail_count = atomic_load(&Current.fail_count);
+    expect_fail_count = atomic_load(&Current.expect_fail_count);
+    if (fail_count > 0) {
         atf_dynstr_t reason;
 
-        format_reason_fmt(&reason, NULL, 0, "%d checks failed; see output for "
-            "more details", Current.fail_count);
+        format_reason_fmt(&reason, NULL, 0, "%zu checks failed; see output "
+            "for more details", fail_count);
         fail_requirement(&Current, &reason);
-    } else if (Current.expect_fail_count > 0) {
+    } else if (expect_fail_count > 0) {
         atf_dynstr_t reason;
 
-        format_reason_fmt(&reason, NULL, 0, "%d checks failed as expected; "
-            "see output for more details", Current.expect_fail_count);
+        format_reason_fmt(&reason, NULL, 0, "%zu checks failed as expected; "
+            "see output for more details", expect_fail_count);
         expected_failure(&Current, &reason);
     } else {
         pass(&Current);
@@ -1077,8 +1919,11 @@ atf_tc_run(const atf_tc_t *tc, const char *resfile)
 atf_error_t
 atf_tc_cleanup(const atf_tc_t *tc)
 {
-    if (tc->pimpl->m_cleanup != NULL)
+    if (tc->pimpl->m_cleanup != NULL) {
+        atf_trace_begin("cleanup", atf_tc_get_ident(tc));
         tc->pimpl->m_cleanup(tc);
+        atf_trace_end("cleanup");
+    }
     return atf_no_error(); /* XXX */
 }
 
@@ -1262,6 +2107,63 @@ atf_tc_expect_timeout(const char *reason, ...)
     va_end(ap);
 }
 
+void
+atf_tc_run_bench(const atf_tc_t *tc, atf_tc_bench_t bench)
+{
+    PRE(Current.tc == tc);
+
+    _atf_tc_run_bench(&Current, bench);
+}
+
+void
+atf_tc_perf_begin(atf_tc_perf_t *perf, const char *name)
+{
+    PRE(Current.tc != NULL);
+
+    _atf_tc_perf_begin(&Current, perf, name);
+}
+
+bool
+atf_tc_perf_next(atf_tc_perf_t *perf)
+{
+    const double now = monotonic_ns();
+
+    if (perf->m_count >= 0)
+        perf->m_samples[perf->m_count] = now - perf->m_start;
+    perf->m_count++;
+    if (perf->m_count == perf->m_total)
+        return false;
+
+    perf->m_start = monotonic_ns();
+    return true;
+}
+
+void
+atf_tc_perf_end(atf_tc_perf_t *perf, const char *file, const size_t line,
+                const bool fatal)
+{
+    PRE(Current.tc != NULL);
+
+    _atf_tc_perf_end(&Current, perf, file, line, fatal);
+}
+
+void
+atf_tc_alloc_begin(atf_tc_alloc_t *alloc)
+{
+    PRE(Current.tc != NULL);
+
+    _atf_tc_alloc_begin(&Current, alloc);
+}
+
+void
+atf_tc_alloc_end(const atf_tc_alloc_t *alloc, const unsigned long long max,
+                 const char *file, const size_t line, const bool fatal)
+{
+    PRE(Current.tc != NULL);
+
+    _atf_tc_alloc_end(&Current, alloc, max, file, line, fatal);
+}
+
 /* Internal! */
 void
 atf_tc_set_resultsfile(const char *file)
@@ -37,6 +37,7 @@ struct atf_tc;
 typedef void (*atf_tc_head_t)(struct atf_tc *);
 typedef void (*atf_tc_body_t)(const struct atf_tc *);
 typedef void (*atf_tc_cleanup_t)(const struct atf_tc *);
+typedef void (*atf_tc_bench_t)(const struct atf_tc *, const size_t);
 
 /* ---------------------------------------------------------------------
  * The "atf_tc_pack" type.
@@ -54,6 +55,33 @@ struct atf_tc_pack {
 };
 typedef const struct atf_tc_pack atf_tc_pack_t;
 
+/* ---------------------------------------------------------------------
+ * The "atf_tc_perf" type.
+ * --------------------------------------------------------------------- */
+
+/* State of a measurement of ATF_CHECK_PERF or ATF_REQUIRE_PERF; internal
+ * to macros.h. */
+struct atf_tc_perf {
+    const char *m_name;
+    double *m_samples;
+    long m_count;
+    long m_total;
+    double m_start;
+};
+typedef struct atf_tc_perf atf_tc_perf_t;
+
+/* ---------------------------------------------------------------------
+ * The "atf_tc_alloc" type.
+ * --------------------------------------------------------------------- */
+
+/* Allocations counted when ATF_CHECK_MAX_ALLOCS or ATF_REQUIRE_MAX_ALLOCS
+ * started; internal to macros.h. */
+struct atf_tc_alloc {
+    unsigned long long m_count;
+    unsigned long long m_bytes;
+};
+typedef struct atf_tc_alloc atf_tc_alloc_t;
+
 /* ---------------------------------------------------------------------
  * The "atf_tc" type.
  * --------------------------------------------------------------------- */
@@ -87,6 +115,10 @@ const char *atf_tc_get_md_var(const atf_tc_t *, const char *);
 char **atf_tc_get_md_vars(const atf_tc_t *);
 bool atf_tc_has_config_var(const atf_tc_t *, const char *);
 bool atf_tc_has_md_var(const atf_tc_t *, const char *);
+atf_error_t atf_tc_for_each_md_var(const atf_tc_t *,
+                                   atf_error_t (*)(const char *, const char *,
+                                                   void *),
+                                   void *);
 
 /* Modifiers. */
 atf_error_t atf_tc_set_md_var(atf_tc_t *, const char *, const char *, ...);
@@ -123,6 +155,13 @@ void atf_tc_expect_timeout(const char *, ...)
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(1, 2);
 
 /* To be run from test case bodies only; internal to macros.h. */
+void atf_tc_run_bench(const atf_tc_t *, atf_tc_bench_t);
+void atf_tc_perf_begin(atf_tc_perf_t *, const char *);
+bool atf_tc_perf_next(atf_tc_perf_t *);
+void atf_tc_perf_end(atf_tc_perf_t *, const char *, const size_t, const bool);
+void atf_tc_alloc_begin(atf_tc_alloc_t *);
+void atf_tc_alloc_end(const atf_tc_alloc_t *, const unsigned long long,
+                      const char *, const size_t, const bool);
 void atf_tc_fail_check(const char *, const size_t, const char *, ...)
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(3, 4);
 void atf_tc_fail_requirement(const char *, const size_t, const char *, ...)
@@ -25,6 +25,7 @@
 
 #include "atf-c/tc.h"
 
+#include <errno.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -126,6 +127,64 @@ ATF_TC_BODY(vars, tcin)
     atf_tc_fini(&tc);
 }
 
+static
+atf_error_t
+append_md_var(const char *name, const char *value, void *data)
+{
+    char *buf = data;
+
+    strcat(buf, name);
+    strcat(buf, "=");
+    strcat(buf, value);
+    strcat(buf, ";");
+    return atf_no_error();
+}
+
+static
+atf_error_t
+stop_md_var(const char *name, const char *value, void *data)
+{
+    size_t *count = data;
+
+    (*count)++;
+    if (strcmp(name, "ident") != 0 && strcmp(value, "Test value") == 0)
+        return atf_libc_error(EINVAL, "Stop");
+    return atf_no_error();
+}
+
+ATF_TC(for_each_md_var);
+ATF_TC_HEAD(for_each_md_var, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests the atf_tc_for_each_md_var "
+                      "function");
+}
+ATF_TC_BODY(for_each_md_var, tcin)
+{
+    atf_tc_t tc;
+    atf_error_t err;
+    char buf[1024];
+    size_t count;
+
+    RE(atf_tc_init(&tc, "test1", ATF_TC_HEAD_NAME(test_var),
+                   ATF_TC_BODY_NAME(empty), NULL, NULL));
+    RE(atf_tc_set_md_var(&tc, "another-var", "Test value"));
+    RE(atf_tc_set_md_var(&tc, "test-var", "Overriden"));
+
+    buf[0] = '\0';
+    RE(atf_tc_for_each_md_var(&tc, append_md_var, buf));
+    ATF_REQUIRE_STREQ("ident=test1;test-var=Overriden;"
+                      "another-var=Test value;", buf);
+
+    count = 0;
+    err = atf_tc_for_each_md_var(&tc, stop_md_var, &count);
+    ATF_REQUIRE(atf_is_error(err));
+    ATF_REQUIRE(atf_error_is(err, "libc"));
+    atf_error_free(err);
+    ATF_REQUIRE_EQ(3, count);
+
+    atf_tc_fini(&tc);
+}
+
 ATF_TC(config);
 ATF_TC_HEAD(config, tc)
 {
@@ -174,6 +233,7 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, init);
     ATF_TP_ADD_TC(tp, init_pack);
     ATF_TP_ADD_TC(tp, vars);
+    ATF_TP_ADD_TC(tp, for_each_md_var);
     ATF_TP_ADD_TC(tp, config);
 
     /* Add the test cases for the free functions. */
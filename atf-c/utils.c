@@ -23,15 +23,35 @@
  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
 
+/* glibc only declares copy_file_range(2) when GNU extensions are enabled,
+ * which must happen before any system header is pulled in. */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "atf-c/utils.h"
 
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+#if defined(HAVE_SYS_PIDFD_H)
+#include <sys/pidfd.h>
+#endif
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
 #include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <regex.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +64,114 @@
 /* No prototype in header for this one, it's a little sketchy (internal). */
 void atf_tc_set_resultsfile(const char *);
 
+/** Size of the blocks in which to process files when copying or comparing
+ * them by conventional means. */
+static const size_t file_block_size = 128 * 1024;
+
+/** Size of the buffer of a line reader created by the public constructor. */
+static const size_t linereader_size = 64 * 1024;
+
+/** Size of the buffer of the line reader used by atf_utils_readline().
+ *
+ * This is kept small because the caller may invoke atf_utils_readline()
+ * once per line and we have to give back whatever we read in excess. */
+static const size_t readline_size = 256;
+
+/** Initializes a line reader with a specific buffer size.
+ *
+ * \param reader The line reader to initialize.
+ * \param fd The file descriptor from which to read lines.
+ * \param size Initial size of the buffer, which grows to accommodate longer
+ *     lines. */
+static void
+linereader_init_size(atf_utils_linereader_t *reader, const int fd,
+                     const size_t size)
+{
+    reader->m_fd = fd;
+    reader->m_buffer = malloc(size);
+    ATF_REQUIRE(reader->m_buffer != NULL);
+    reader->m_size = size;
+    reader->m_begin = 0;
+    reader->m_end = 0;
+    reader->m_eof = false;
+}
+
+/** Reads more data into the buffer of a line reader.
+ *
+ * Discards the already-consumed data and grows the buffer if it is full.
+ * One byte is always left available past the read data to nul-terminate a
+ * last line that lacks a newline character.
+ *
+ * \param reader The line reader to fill. */
+static void
+linereader_fill(atf_utils_linereader_t *reader)
+{
+    if (reader->m_begin > 0) {
+        memmove(reader->m_buffer, reader->m_buffer + reader->m_begin,
+                reader->m_end - reader->m_begin);
+        reader->m_end -= reader->m_begin;
+        reader->m_begin = 0;
+    }
+
+    if (reader->m_end + 1 >= reader->m_size) {
+        char *buffer = realloc(reader->m_buffer, reader->m_size * 2);
+        ATF_REQUIRE(buffer != NULL);
+        reader->m_buffer = buffer;
+        reader->m_size *= 2;
+    }
+
+    ssize_t count;
+    do {
+        count = read(reader->m_fd, reader->m_buffer + reader->m_end,
+                     reader->m_size - reader->m_end - 1);
+    } while (count == -1 && errno == EINTR);
+    ATF_REQUIRE(count != -1);
+
+    if (count == 0)
+        reader->m_eof = true;
+    else
+        reader->m_end += count;
+}
+
+/** Reads a line of arbitrary length one byte at a time.
+ *
+ * This is the fallback of atf_utils_readline() for descriptors that cannot
+ * be rewound, in which case we must not consume anything past the newline.
+ *
+ * \param fd The descriptor from which to read the line.
+ *
+ * \return A pointer to the read line, which must be released with free(), or
+ * NULL if there was nothing to read from the file. */
+static char *
+readline_unbuffered(const int fd)
+{
+    size_t size = readline_size;
+    size_t length = 0;
+    char *line = malloc(size);
+    ATF_REQUIRE(line != NULL);
+
+    char ch;
+    ssize_t cnt;
+    while ((cnt = read(fd, &ch, sizeof(ch))) == sizeof(ch) && ch != '\n') {
+        if (length + 1 == size) {
+            char *grown = realloc(line, size * 2);
+            ATF_REQUIRE(grown != NULL);
+            line = grown;
+            size *= 2;
+        }
+        line[length++] = ch;
+    }
+    ATF_REQUIRE(cnt != -1);
+
+    if (cnt == 0 && length == 0) {
+        free(line);
+        return NULL;
+    } else {
+        line[length] = '\0';
+        return line;
+    }
+}
+
 /** Allocate a filename to be used by atf_utils_{fork,wait}.
  *
  * In case of a failure, marks the calling test as failed when in_parent is
@@ -72,6 +200,393 @@ init_out_filename(atf_dynstr_t *name, const pid_t pid, const char *suffix,
     }
 }
 
+/** Checks if an error means that a zero-copy mechanism is not supported.
+ *
+ * \param error The errno value reported by the mechanism.
+ *
+ * \return True if the caller should fall back to a different mechanism. */
+static bool
+is_unsupported_copy(const int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL ||
+        error == EOPNOTSUPP || error == ENOTSUP;
+}
+
+/** Copies the rest of a file with copy_file_range(2).
+ *
+ * \param input The descriptor to read from.
+ * \param output The descriptor to write to.
+ * \param destination Name of the destination file, for error reporting.
+ *
+ * \return True if the copy is complete; false if the rest of the file has to
+ * be copied by other means. */
+static bool
+copy_with_copy_file_range(const int input, const int output,
+                          const char *destination)
+{
+#if defined(HAVE_COPY_FILE_RANGE)
+    ssize_t length;
+    while ((length = copy_file_range(input, NULL, output, NULL,
+                                     SSIZE_MAX, 0)) > 0)
+        continue;
+    if (length == -1 && is_unsupported_copy(errno))
+        return false;
+    ATF_REQUIRE_MSG(length != -1, "Failed to copy to %s: %s", destination,
+                    strerror(errno));
+    return true;
+#else
+    (void)input;
+    (void)output;
+    (void)destination;
+    return false;
+#endif
+}
+
+/** Copies the rest of a file with sendfile(2).
+ *
+ * \param input The descriptor to read from.
+ * \param output The descriptor to write to.
+ * \param destination Name of the destination file, for error reporting.
+ *
+ * \return True if the copy is complete; false if the rest of the file has to
+ * be copied by other means. */
+static bool
+copy_with_sendfile(const int input, const int output, const char *destination)
+{
+#if defined(HAVE_SYS_SENDFILE_H)
+    ssize_t length;
+    while ((length = sendfile(output, input, NULL, INT_MAX)) > 0)
+        continue;
+    if (length == -1 && is_unsupported_copy(errno))
+        return false;
+    ATF_REQUIRE_MSG(length != -1, "Failed to copy to %s: %s", destination,
+                    strerror(errno));
+    return true;
+#else
+    (void)input;
+    (void)output;
+    (void)destination;
+    return false;
+#endif
+}
+
+/** Copies the rest of a file with read(2) and write(2).
+ *
+ * \param input The descriptor to read from.
+ * \param output The descriptor to write to.
+ * \param source Name of the source file, for error reporting.
+ * \param destination Name of the destination file, for error reporting. */
+static void
+copy_with_read_write(const int input, const int output, const char *source,
+                     const char *destination)
+{
+    char *buffer = malloc(file_block_size);
+    ATF_REQUIRE(buffer != NULL);
+
+    ssize_t length;
+    while ((length = read(input, buffer, file_block_size)) > 0)
+        ATF_REQUIRE_MSG(write(output, buffer, length) == length,
+                        "Failed to write to %s during copy", destination);
+    ATF_REQUIRE_MSG(length != -1, "Failed to read from %s during copy", source);
+
+    free(buffer);
+}
+
+/** Reports the offset at which two buffers differ.
+ *
+ * \param name Name of the file being compared.
+ * \param offset Offset of the buffers within the file.
+ * \param actual Contents of the file.
+ * \param expected Expected contents of the file.
+ * \param length Number of bytes to compare.
+ *
+ * \return True if the buffers match; false otherwise. */
+static bool
+compare_block(const char *name, const size_t offset, const char *actual,
+              const char *expected, const size_t length)
+{
+    if (memcmp(actual, expected, length) == 0)
+        return true;
+
+    size_t i = 0;
+    while (actual[i] == expected[i])
+        i++;
+    printf("File %s differs from the expected contents at byte %zu\n", name,
+           offset + i);
+    return false;
+}
+
+/** Compares the rest of a file against the given golden contents.
+ *
+ * \param name Name of the file being compared.
+ * \param fd Descriptor of the file being compared.
+ * \param contents Expected contents of the file.
+ * \param length Length of contents.
+ *
+ * \return True if the file matches the contents; false otherwise. */
+static bool
+compare_with_read(const char *name, const int fd, const char *contents,
+                  const size_t length)
+{
+    char *buffer = malloc(file_block_size);
+    ATF_REQUIRE(buffer != NULL);
+
+    bool matches = true;
+    size_t offset = 0;
+    ssize_t count = 0;
+    while (matches && (count = read(fd, buffer, file_block_size)) > 0) {
+        if ((size_t)count > length - offset) {
+            matches = compare_block(name, offset, buffer, contents + offset,
+                                    length - offset);
+            if (matches)
+                printf("File %s is longer than the expected %zu bytes\n",
+                       name, length);
+            matches = false;
+        } else {
+            matches = compare_block(name, offset, buffer, contents + offset,
+                                    count);
+            offset += count;
+        }
+    }
+    ATF_REQUIRE_MSG(!matches || count != -1, "Failed to read from %s", name);
+    if (matches && offset < length) {
+        printf("File %s is shorter than the expected %zu bytes\n", name,
+               length);
+        matches = false;
+    }
+
+    free(buffer);
+    return matches;
+}
+
+/** Output of a subprocess captured in memory. */
+struct capture {
+    char *m_data;
+    size_t m_length;
+    size_t m_size;
+};
+
+/** Subprocess spawned by atf_utils_fork_many and not yet waited for. */
+struct piped_child {
+    pid_t m_pid;
+    /* Non-blocking read ends of the stdout and stderr pipes; -1 once they
+     * hit EOF. */
+    int m_fds[2];
+    struct capture m_output[2];
+    /* Becomes readable when the subprocess exits; -1 if unsupported. */
+    int m_pidfd;
+    /* Whether the subprocess has been reaped and, if so, how it exited. */
+    bool m_exited;
+    int m_status;
+};
+
+/** Subprocesses spawned by atf_utils_fork_many and not yet waited for. */
+static struct piped_child *piped_children = NULL;
+static size_t piped_children_count = 0;
+static size_t piped_children_size = 0;
+
+/** Upper bound, in milliseconds, of the time between checks for the exit
+ * of the spawned subprocesses that have no process descriptor.  Their
+ * pipes cannot tell because they may be held open by other processes, such
+ * as the descendants of the subprocesses. */
+static const int piped_children_poll_ms = 10;
+
+/** Reads whatever is available from a pipe into a capture buffer.
+ *
+ * \param fd The pipe to read from.  Must be non-blocking.
+ * \param capture The buffer into which to append the data.
+ *
+ * \return False if the pipe reached EOF; true otherwise, which includes the
+ * case of a pipe without pending data. */
+static bool
+capture_read(const int fd, struct capture *capture)
+{
+    for (;;) {
+        if (capture->m_size - capture->m_length < 4096) {
+            const size_t size = capture->m_size == 0 ? 8192 :
+                capture->m_size * 2;
+            char *data = realloc(capture->m_data, size);
+            ATF_REQUIRE(data != NULL);
+            capture->m_data = data;
+            capture->m_size = size;
+        }
+
+        ssize_t count;
+        do {
+            count = read(fd, capture->m_data + capture->m_length,
+                         capture->m_size - capture->m_length);
+        } while (count == -1 && errno == EINTR);
+        if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        ATF_REQUIRE(count != -1);
+        if (count == 0)
+            return false;
+
+        capture->m_length += count;
+    }
+}
+
+/** Reads the pending output of a subprocess without waiting for more.
+ *
+ * \param child The subprocess whose pipes to read from. */
+static void
+capture_drain(struct piped_child *child)
+{
+    for (size_t i = 0; i < 2; i++) {
+        if (child->m_fds[i] != -1 &&
+            !capture_read(child->m_fds[i], &child->m_output[i])) {
+            close(child->m_fds[i]);
+            child->m_fds[i] = -1;
+        }
+    }
+}
+
+/** Prints a captured output to stdout.
+ *
+ * \param capture The output to print.
+ * \param prefix A string to be prepended to every printed line. */
+static void
+capture_print(const struct capture *capture, const char *prefix)
+{
+    const char *iter = capture->m_data;
+    const char *end = capture->m_data + capture->m_length;
+    while (iter < end) {
+        const char *newline = memchr(iter, '\n', end - iter);
+        const char *next = newline == NULL ? end : newline + 1;
+        printf("%s%.*s", prefix, (int)(next - iter), iter);
+        iter = next;
+    }
+}
+
+/** Validates a captured output against its expected value.
+ *
+ * \param capture The output to validate.
+ * \param expected The expected contents, or the name of the file into which
+ *     to store the output if prefixed by "save:".
+ * \param name The name of the output, for error reporting purposes.
+ * \param pid The process that generated the output. */
+static void
+capture_check(const struct capture *capture, const char *expected,
+              const char *name, const pid_t pid)
+{
+    const char *save_prefix = "save:";
+    const size_t save_prefix_length = strlen(save_prefix);
+
+    if (strlen(expected) > save_prefix_length &&
+        strncmp(expected, save_prefix, save_prefix_length) == 0) {
+        const char *path = expected + save_prefix_length;
+        const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                            0644);
+        ATF_REQUIRE_MSG(fd != -1, "Cannot create file %s", path);
+        ATF_REQUIRE_MSG(capture->m_length == 0 ||
+                        write(fd, capture->m_data, capture->m_length) ==
+                        (ssize_t)capture->m_length,
+                        "Failed to write to %s", path);
+        close(fd);
+    } else {
+        ATF_REQUIRE_MSG(capture->m_length == strlen(expected) &&
+                        memcmp(capture->m_data, expected,
+                               capture->m_length) == 0,
+                        "The %s of subprocess %d does not match", name,
+                        (int)pid);
+    }
+}
+
+/** Looks up a subprocess spawned by atf_utils_fork_many.
+ *
+ * \param pid The process to look for.
+ *
+ * \return The subprocess or NULL if it has already been waited for or if it
+ * was not spawned by atf_utils_fork_many. */
+static struct piped_child *
+find_piped_child(const pid_t pid)
+{
+    for (size_t i = 0; i < piped_children_count; i++) {
+        if (piped_children[i].m_pid == pid)
+            return &piped_children[i];
+    }
+    return NULL;
+}
+
+/** Forgets about a subprocess spawned by atf_utils_fork_many.
+ *
+ * \param child The subprocess to remove from the registry. */
+static void
+remove_piped_child(struct piped_child *child)
+{
+    for (size_t i = 0; i < 2; i++) {
+        if (child->m_fds[i] != -1)
+            close(child->m_fds[i]);
+        free(child->m_output[i].m_data);
+    }
+    if (child->m_pidfd != -1)
+        close(child->m_pidfd);
+
+    *child = piped_children[--piped_children_count];
+    if (piped_children_count == 0) {
+        free(piped_children);
+        piped_children = NULL;
+        piped_children_size = 0;
+    }
+}
+
+/** Waits until a spawned subprocess exits or has output, or for a while.
+ *
+ * All pending pipes are drained, not only the ones of the subprocesses the
+ * caller is interested in, to prevent any of them from blocking on a full
+ * pipe.  Completion is detected from the exit of the subprocesses and not
+ * from the closing of their pipes, which may outlive them. */
+static void
+drain_piped_children(void)
+{
+    struct pollfd *pfds = malloc(sizeof(*pfds) * piped_children_count * 3);
+    ATF_REQUIRE(pfds != NULL);
+
+    nfds_t nfds = 0;
+    int timeout = -1;
+    for (size_t i = 0; i < piped_children_count; i++) {
+        const struct piped_child *child = &piped_children[i];
+        int fds[3] = { child->m_fds[0], child->m_fds[1], -1 };
+
+        if (!child->m_exited) {
+            if (child->m_pidfd != -1)
+                fds[2] = child->m_pidfd;
+            else
+                timeout = piped_children_poll_ms;
+        }
+        for (size_t j = 0; j < 3; j++) {
+            if (fds[j] != -1) {
+                pfds[nfds].fd = fds[j];
+                pfds[nfds].events = POLLIN;
+                pfds[nfds].revents = 0;
+                nfds++;
+            }
+        }
+    }
+
+    const int ret = poll(pfds, nfds, timeout);
+    ATF_REQUIRE(ret != -1 || errno == EINTR);
+    free(pfds);
+
+    for (size_t i = 0; i < piped_children_count; i++) {
+        struct piped_child *child = &piped_children[i];
+
+        capture_drain(child);
+        if (!child->m_exited) {
+            pid_t pid;
+            do {
+                pid = waitpid(child->m_pid, &child->m_status, WNOHANG);
+            } while (pid == -1 && errno == EINTR);
+            ATF_REQUIRE(pid != -1);
+            child->m_exited = pid == child->m_pid;
+            if (child->m_exited && child->m_pidfd != -1) {
+                close(child->m_pidfd);
+                child->m_pidfd = -1;
+            }
+        }
+    }
+}
+
 /** Searches for a regexp in a string.
  *
  * \param regex The regexp to look for.
@@ -148,22 +663,36 @@ atf_utils_compare_file(const char *name, const char *contents)
     const int fd = open(name, O_RDONLY | O_CLOEXEC);
     ATF_REQUIRE_MSG(fd != -1, "Cannot open %s", name);
 
-    const char *pos = contents;
-    ssize_t remaining = strlen(contents);
+    const size_t length = strlen(contents);
 
-    char buffer[1024];
-    ssize_t count;
-    while ((count = read(fd, buffer, sizeof(buffer))) > 0 &&
-           count <= remaining) {
-        if (memcmp(pos, buffer, count) != 0) {
-            close(fd);
-            return false;
-        }
-        remaining -= count;
-        pos += count;
+    struct stat sb;
+    ATF_REQUIRE_MSG(fstat(fd, &sb) != -1, "Cannot stat %s", name);
+    if (!S_ISREG(sb.st_mode)) {
+        const bool matches = compare_with_read(name, fd, contents, length);
+        close(fd);
+        return matches;
+    }
+
+    if ((size_t)sb.st_size != length) {
+        printf("File %s has %jd bytes but %zu were expected\n", name,
+               (intmax_t)sb.st_size, length);
+        close(fd);
+        return false;
+    } else if (length == 0) {
+        close(fd);
+        return true;
+    }
+
+    bool matches;
+    void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        matches = compare_with_read(name, fd, contents, length);
+    else {
+        matches = compare_block(name, 0, data, contents, length);
+        munmap(data, length);
     }
     close(fd);
-    return count == 0 && remaining == 0;
+    return matches;
 }
 
 /** Copies a file.
@@ -182,16 +711,17 @@ atf_utils_copy_file(const char *source, const char *destination)
     ATF_REQUIRE_MSG(output != -1, "Failed to open destination file during "
                     "copy (%s)", destination);
 
-    char buffer[1024];
-    ssize_t length;
-    while ((length = read(input, buffer, sizeof(buffer))) > 0)
-        ATF_REQUIRE_MSG(write(output, buffer, length) == length,
-                        "Failed to write to %s during copy", destination);
-    ATF_REQUIRE_MSG(length != -1, "Failed to read from %s during copy", source);
-
     struct stat sb;
     ATF_REQUIRE_MSG(fstat(input, &sb) != -1,
                     "Failed to stat source file %s during copy", source);
+
+    /* Special files, such as those in procfs, may report a bogus size that
+     * makes the zero-copy mechanisms stop early. */
+    if (!S_ISREG(sb.st_mode) ||
+        (!copy_with_copy_file_range(input, output, destination) &&
+         !copy_with_sendfile(input, output, destination)))
+        copy_with_read_write(input, output, source, destination);
+
     ATF_REQUIRE_MSG(fchmod(output, sb.st_mode) != -1,
                     "Failed to chmod destination file %s during copy",
                     destination);
@@ -275,6 +805,80 @@ atf_utils_fork(void)
     return pid;
 }
 
+/** Spawns subprocesses and captures their output in memory.
+ *
+ * Use the atf_utils_wait_any() function to wait for the completion of the
+ * spawned subprocesses and validate their exit conditions.  The output of
+ * the subprocesses goes through pipes that are drained while waiting, so
+ * the subprocesses can run concurrently and produce any amount of output.
+ *
+ * \param count Number of subprocesses to spawn.
+ * \param [out] pids Array of count elements that receives the PIDs of the
+ *     spawned subprocesses.  Only set in the parent.
+ *
+ * \return The index of the subprocess in pids, which is in the range [0,
+ * count), in the new children; count in the parent.  Does not return in
+ * error conditions. */
+size_t
+atf_utils_fork_many(const size_t count, pid_t *pids)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    if (piped_children_count + count > piped_children_size) {
+        const size_t size = piped_children_count + count;
+        struct piped_child *children = realloc(piped_children,
+                                               sizeof(*children) * size);
+        ATF_REQUIRE(children != NULL);
+        piped_children = children;
+        piped_children_size = size;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int outfds[2], errfds[2];
+        ATF_REQUIRE(pipe(outfds) != -1);
+        ATF_REQUIRE(pipe(errfds) != -1);
+
+        const pid_t pid = fork();
+        if (pid == -1)
+            atf_tc_fail("fork failed");
+
+        if (pid == 0) {
+            while (piped_children_count > 0)
+                remove_piped_child(&piped_children[0]);
+
+            close(outfds[0]);
+            close(errfds[0]);
+            if (dup2(outfds[1], STDOUT_FILENO) == -1)
+                err(EXIT_FAILURE, "Cannot redirect to fd %d", STDOUT_FILENO);
+            if (dup2(errfds[1], STDERR_FILENO) == -1)
+                err(EXIT_FAILURE, "Cannot redirect to fd %d", STDERR_FILENO);
+            close(outfds[1]);
+            close(errfds[1]);
+            return i;
+        }
+
+        close(outfds[1]);
+        close(errfds[1]);
+        ATF_REQUIRE(fcntl(outfds[0], F_SETFL, O_NONBLOCK) != -1);
+        ATF_REQUIRE(fcntl(errfds[0], F_SETFL, O_NONBLOCK) != -1);
+
+        struct piped_child *child = &piped_children[piped_children_count++];
+        memset(child, 0, sizeof(*child));
+        child->m_pid = pid;
+        child->m_fds[0] = outfds[0];
+        child->m_fds[1] = errfds[0];
+#if defined(HAVE_PIDFD_OPEN)
+        child->m_pidfd = pidfd_open(pid, 0);
+#else
+        child->m_pidfd = -1;
+#endif
+
+        pids[i] = pid;
+    }
+    return count;
+}
+
 void
 atf_utils_reset_resultsfile(void)
 {
@@ -311,21 +915,33 @@ atf_utils_grep_file(const char *regex, const char *file, ...)
     va_list ap;
     atf_dynstr_t formatted;
     atf_error_t error;
+    regex_t preg;
 
     va_start(ap, file);
     error = atf_dynstr_init_ap(&formatted, regex, ap);
     va_end(ap);
     ATF_REQUIRE(!atf_is_error(error));
 
+    printf("Looking for '%s' in file '%s'\n", atf_dynstr_cstring(&formatted),
+           file);
+    ATF_REQUIRE(regcomp(&preg, atf_dynstr_cstring(&formatted),
+                        REG_EXTENDED) == 0);
+
     ATF_REQUIRE((fd = open(file, O_RDONLY | O_CLOEXEC)) != -1);
+    atf_utils_linereader_t reader;
+    atf_utils_linereader_init(&reader, fd);
     bool found = false;
-    char *line = NULL;
-    while (!found && (line = atf_utils_readline(fd)) != NULL) {
-        found = grep_string(atf_dynstr_cstring(&formatted), line);
-        free(line);
+    const char *line;
+    while (!found &&
+           (line = atf_utils_linereader_next(&reader, NULL)) != NULL) {
+        const int res = regexec(&preg, line, 0, NULL, 0);
+        ATF_REQUIRE(res == 0 || res == REG_NOMATCH);
+        found = res == 0;
     }
+    atf_utils_linereader_fini(&reader);
     close(fd);
 
+    regfree(&preg);
     atf_dynstr_fini(&formatted);
 
     return found;
@@ -358,7 +974,77 @@ atf_utils_grep_string(const char *regex, const char *str, ...)
     return res;
 }
 
+/** Initializes a buffered line reader.
+ *
+ * The reader consumes data from the descriptor in large blocks, so the
+ * caller should not read from it directly until the reader is finalized.
+ *
+ * \param reader The line reader to initialize.
+ * \param fd The descriptor from which to read lines.  Ownership is not
+ *     transferred to the reader. */
+void
+atf_utils_linereader_init(atf_utils_linereader_t *reader, const int fd)
+{
+    linereader_init_size(reader, fd, linereader_size);
+}
+
+/** Releases the resources held by a line reader.
+ *
+ * \param reader The line reader to finalize.  The descriptor it was reading
+ *     from is not closed. */
+void
+atf_utils_linereader_fini(atf_utils_linereader_t *reader)
+{
+    free(reader->m_buffer);
+}
+
+/** Gets the next line from a line reader.
+ *
+ * \param reader The line reader from which to get the line.
+ * \param [out] length If not NULL, set to the length of the returned line.
+ *
+ * \return A pointer to the nul-terminated line, without its newline
+ * character, or NULL if there is nothing else to read.  The line lives in
+ * the reader's buffer and is only valid until the next call to this
+ * function or until the reader is finalized. */
+const char *
+atf_utils_linereader_next(atf_utils_linereader_t *reader, size_t *length)
+{
+    size_t scanned = reader->m_begin;
+    for (;;) {
+        char *newline = memchr(reader->m_buffer + scanned, '\n',
+                               reader->m_end - scanned);
+        if (newline != NULL) {
+            char *line = reader->m_buffer + reader->m_begin;
+            *newline = '\0';
+            if (length != NULL)
+                *length = newline - line;
+            reader->m_begin = newline + 1 - reader->m_buffer;
+            return line;
+        } else if (reader->m_eof) {
+            if (reader->m_begin == reader->m_end)
+                return NULL;
+
+            char *line = reader->m_buffer + reader->m_begin;
+            reader->m_buffer[reader->m_end] = '\0';
+            if (length != NULL)
+                *length = reader->m_end - reader->m_begin;
+            reader->m_begin = reader->m_end;
+            return line;
+        }
+
+        scanned = reader->m_end - reader->m_begin;
+        linereader_fill(reader);
+        scanned += reader->m_begin;
+    }
+}
+
 /** Reads a line of arbitrary length.
+ *
+ * On descriptors that can be rewound, such as those of regular files, this
+ * reads in blocks and gives back any excess data so that subsequent reads
+ * from the descriptor start right after the returned line.  Otherwise, the
+ * line is read one byte at a time.
  *
  * \param fd The descriptor from which to read the line.
  *
@@ -367,26 +1053,27 @@ atf_utils_grep_string(const char *regex, const char *str, ...)
 char *
 atf_utils_readline(const int fd)
 {
-    char ch;
-    ssize_t cnt;
-    atf_dynstr_t temp;
-    atf_error_t error;
-
-    error = atf_dynstr_init(&temp);
-    ATF_REQUIRE(!atf_is_error(error));
-
-    while ((cnt = read(fd, &ch, sizeof(ch))) == sizeof(ch) &&
-           ch != '\n') {
-        error = atf_dynstr_append_fmt(&temp, "%c", ch);
-        ATF_REQUIRE(!atf_is_error(error));
+    if (lseek(fd, 0, SEEK_CUR) == -1)
+        return readline_unbuffered(fd);
+
+    atf_utils_linereader_t reader;
+    linereader_init_size(&reader, fd, readline_size);
+
+    char *copy = NULL;
+    size_t length;
+    const char *line = atf_utils_linereader_next(&reader, &length);
+    if (line != NULL) {
+        copy = malloc(length + 1);
+        ATF_REQUIRE(copy != NULL);
+        memcpy(copy, line, length + 1);
     }
-    ATF_REQUIRE(cnt != -1);
 
-    if (cnt == 0 && atf_dynstr_length(&temp) == 0) {
-        atf_dynstr_fini(&temp);
-        return NULL;
-    } else
-        return atf_dynstr_fini_disown(&temp);
+    const size_t excess = reader.m_end - reader.m_begin;
+    if (excess > 0)
+        ATF_REQUIRE(lseek(fd, -(off_t)excess, SEEK_CUR) != -1);
+
+    atf_utils_linereader_fini(&reader);
+    return copy;
 }
 
 /** Redirects a file descriptor to a file.
@@ -466,3 +1153,56 @@ atf_utils_wait(const pid_t pid, const int exitstatus, const char *expout,
     ATF_REQUIRE(unlink(atf_dynstr_cstring(&out_name)) != -1);
     ATF_REQUIRE(unlink(atf_dynstr_cstring(&err_name)) != -1);
 }
+
+/** Waits for any of a set of subprocesses and validates its exit condition.
+ *
+ * \param pids The processes to be waited for.  Must have been started by
+ *     atf_utils_fork_many().
+ * \param count Number of elements in pids.
+ * \param expect Array of count elements with the expected exit status and
+ *     contents of stdout and stderr of each subprocess in pids.  Either of
+ *     the expected outputs can be prefixed by "save:" to store the output
+ *     in a file instead of validating it.
+ *
+ * A subprocess is done once it exits, even if the pipes of its output are
+ * still held open by other processes, such as its descendants.
+ *
+ * \return The PID of the subprocess that was waited for, or -1 if all the
+ * subprocesses in pids have already been waited for. */
+pid_t
+atf_utils_wait_any(const pid_t *pids, const size_t count,
+                   const atf_utils_wait_expect_t *expect)
+{
+    for (;;) {
+        bool pending = false;
+        for (size_t i = 0; i < count; i++) {
+            struct piped_child *child = find_piped_child(pids[i]);
+            if (child == NULL)
+                continue;
+
+            if (child->m_exited) {
+                const int status = child->m_status;
+                capture_drain(child);
+
+                capture_print(&child->m_output[0], "subprocess stdout: ");
+                capture_print(&child->m_output[1], "subprocess stderr: ");
+
+                ATF_REQUIRE(WIFEXITED(status));
+                ATF_REQUIRE_EQ(expect[i].m_exitstatus, WEXITSTATUS(status));
+
+                capture_check(&child->m_output[0], expect[i].m_stdout,
+                              "stdout", pids[i]);
+                capture_check(&child->m_output[1], expect[i].m_stderr,
+                              "stderr", pids[i]);
+
+                remove_piped_child(child);
+                return pids[i];
+            }
+            pending = true;
+        }
+        if (!pending)
+            return -1;
+
+        drain_piped_children();
+    }
+}
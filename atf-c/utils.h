@@ -27,10 +27,30 @@
 #define ATF_C_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <unistd.h>
 
 #include <atf-c/defs.h>
 
+/* Buffered reader of the lines of a file descriptor. */
+struct atf_utils_linereader {
+    int m_fd;
+    char *m_buffer;
+    size_t m_size;
+    size_t m_begin;
+    size_t m_end;
+    bool m_eof;
+};
+typedef struct atf_utils_linereader atf_utils_linereader_t;
+
+/* Expected outcome of a subprocess spawned by atf_utils_fork_many. */
+struct atf_utils_wait_expect {
+    int m_exitstatus;
+    const char *m_stdout;
+    const char *m_stderr;
+};
+typedef struct atf_utils_wait_expect atf_utils_wait_expect_t;
+
 void atf_utils_cat_file(const char *, const char *);
 bool atf_utils_compare_file(const char *, const char *);
 void atf_utils_copy_file(const char *, const char *);
@@ -38,14 +58,20 @@ void atf_utils_create_file(const char *, const char *, ...)
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(2, 3);
 bool atf_utils_file_exists(const char *);
 pid_t atf_utils_fork(void);
+size_t atf_utils_fork_many(const size_t, pid_t *);
 void atf_utils_free_charpp(char **);
 bool atf_utils_grep_file(const char *, const char *, ...)
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(1, 3);
 bool atf_utils_grep_string(const char *, const char *, ...)
     ATF_DEFS_ATTRIBUTE_FORMAT_PRINTF(1, 3);
+void atf_utils_linereader_init(atf_utils_linereader_t *, const int);
+void atf_utils_linereader_fini(atf_utils_linereader_t *);
+const char *atf_utils_linereader_next(atf_utils_linereader_t *, size_t *);
 char *atf_utils_readline(int);
 void atf_utils_redirect(const int, const char *);
 void atf_utils_wait(const pid_t, const int, const char *, const char *);
+pid_t atf_utils_wait_any(const pid_t *, const size_t,
+                         const atf_utils_wait_expect_t *);
 void atf_utils_reset_resultsfile(void);
 
 #endif /* !defined(ATF_C_UTILS_H) */
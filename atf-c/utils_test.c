@@ -29,10 +29,12 @@
 #include <sys/wait.h>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <atf-c.h>
@@ -184,6 +186,22 @@ ATF_TC_BODY(compare_file__long__not_match, tc)
     ATF_REQUIRE(!atf_utils_compare_file("test.txt", long_contents));
 }
 
+ATF_TC_WITHOUT_HEAD(compare_file__reports_difference);
+ATF_TC_BODY(compare_file__reports_difference, tc)
+{
+    atf_utils_create_file("test.txt", "%s", "abcdefgh");
+    atf_utils_redirect(STDOUT_FILENO, "captured.txt");
+    ATF_REQUIRE(!atf_utils_compare_file("test.txt", "abcdeXgh"));
+    ATF_REQUIRE(!atf_utils_compare_file("test.txt", "abc"));
+    fflush(stdout);
+    close(STDOUT_FILENO);
+
+    ATF_REQUIRE(atf_utils_grep_file("test.txt differs .* at byte 5",
+                                    "captured.txt"));
+    ATF_REQUIRE(atf_utils_grep_file("test.txt has 8 bytes but 3 were",
+                                    "captured.txt"));
+}
+
 ATF_TC_WITHOUT_HEAD(copy_file__empty);
 ATF_TC_BODY(copy_file__empty, tc)
 {
@@ -205,6 +223,26 @@ ATF_TC_BODY(copy_file__some_contents, tc)
     ATF_REQUIRE(atf_utils_compare_file("dest.txt", "This is a\ntest file\n"));
 }
 
+ATF_TC_WITHOUT_HEAD(copy_file__large);
+ATF_TC_BODY(copy_file__large, tc)
+{
+    const size_t length = 3 * 1024 * 1024 + 7;
+    char *contents = malloc(length + 1);
+    ATF_REQUIRE(contents != NULL);
+    for (size_t i = 0; i < length; i++)
+        contents[i] = 'a' + (i % 26);
+    contents[length] = '\0';
+    atf_utils_create_file("src.txt", "%s", contents);
+
+    atf_utils_copy_file("src.txt", "dest.txt");
+    ATF_REQUIRE(atf_utils_compare_file("dest.txt", contents));
+
+    contents[length - 1] = '\0';
+    ATF_REQUIRE(!atf_utils_compare_file("dest.txt", contents));
+
+    free(contents);
+}
+
 ATF_TC_WITHOUT_HEAD(create_file);
 ATF_TC_BODY(create_file, tc)
 {
@@ -258,6 +296,168 @@ ATF_TC_BODY(fork, tc)
     atf_dynstr_fini(&out_name);
 }
 
+ATF_TC_WITHOUT_HEAD(fork_many__wait_any);
+ATF_TC_BODY(fork_many__wait_any, tc)
+{
+    int fds[4][2];
+    pid_t pids[4];
+    size_t i;
+    char ch;
+
+    /* Each child waits for a byte on its own pipe before exiting, which
+     * lets the parent pick the order in which they finish. */
+    for (i = 0; i < 4; i++)
+        ATF_REQUIRE(pipe(fds[i]) != -1);
+
+    i = atf_utils_fork_many(4, pids);
+    if (i < 4) {
+        ATF_REQUIRE_EQ(1, read(fds[i][0], &ch, 1));
+        fprintf(stdout, "Child %zu stdout\n", i);
+        fprintf(stderr, "Child %zu stderr\n", i);
+        exit(10 + i);
+    }
+    ATF_REQUIRE_EQ(4, i);
+    for (i = 0; i < 4; i++)
+        close(fds[i][0]);
+
+    const atf_utils_wait_expect_t expect[4] = {
+        { 10, "Child 0 stdout\n", "Child 0 stderr\n" },
+        { 11, "Child 1 stdout\n", "Child 1 stderr\n" },
+        { 12, "Child 2 stdout\n", "Child 2 stderr\n" },
+        { 13, "save:child3.txt", "Child 3 stderr\n" },
+    };
+    /* Release the children in the reverse order of creation. */
+    for (i = 4; i > 0; i--) {
+        ATF_REQUIRE_EQ(1, write(fds[i - 1][1], "x", 1));
+        close(fds[i - 1][1]);
+        ATF_REQUIRE_EQ(pids[i - 1], atf_utils_wait_any(pids, 4, expect));
+    }
+    ATF_REQUIRE_EQ(-1, atf_utils_wait_any(pids, 4, expect));
+
+    ATF_REQUIRE(atf_utils_compare_file("child3.txt", "Child 3 stdout\n"));
+}
+
+ATF_TC_WITHOUT_HEAD(fork_many__large_output);
+ATF_TC_BODY(fork_many__large_output, tc)
+{
+    const size_t length = 1024 * 1024;
+    char *output = malloc(length + 1);
+    ATF_REQUIRE(output != NULL);
+    memset(output, 'x', length);
+    output[length] = '\0';
+
+    pid_t pids[2];
+    const size_t i = atf_utils_fork_many(2, pids);
+    if (i < 2) {
+        /* Fill stderr first: this would block if stdout were read first. */
+        fprintf(stderr, "%s", output);
+        fprintf(stdout, "%s", output);
+        exit(EXIT_SUCCESS);
+    }
+
+    atf_utils_wait_expect_t expect[2] = {
+        { EXIT_SUCCESS, "save:out0.txt", "save:err0.txt" },
+        { EXIT_SUCCESS, "save:out1.txt", "save:err1.txt" },
+    };
+    ATF_REQUIRE(atf_utils_wait_any(pids, 2, expect) != -1);
+    ATF_REQUIRE(atf_utils_wait_any(pids, 2, expect) != -1);
+    ATF_REQUIRE_EQ(-1, atf_utils_wait_any(pids, 2, expect));
+
+    ATF_REQUIRE(atf_utils_compare_file("out0.txt", output));
+    ATF_REQUIRE(atf_utils_compare_file("err0.txt", output));
+    ATF_REQUIRE(atf_utils_compare_file("out1.txt", output));
+    ATF_REQUIRE(atf_utils_compare_file("err1.txt", output));
+
+    free(output);
+}
+
+ATF_TC(fork_many__background_output);
+ATF_TC_HEAD(fork_many__background_output, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Tests that atf_utils_wait_any returns "
+                      "once the child exits even if a process it left behind "
+                      "still holds its output open");
+    atf_tc_set_md_var(tc, "timeout", "20");
+}
+ATF_TC_BODY(fork_many__background_output, tc)
+{
+    pid_t pid;
+    if (atf_utils_fork_many(1, &pid) == 0) {
+        printf("Started\n");
+        fflush(stdout);
+        exit(system("sleep 60 & echo $! >sleep.pid") == 0 ?
+             EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    const atf_utils_wait_expect_t expect = {
+        EXIT_SUCCESS, "Started\n", ""
+    };
+    const time_t start = time(NULL);
+    ATF_REQUIRE_EQ(pid, atf_utils_wait_any(&pid, 1, &expect));
+    ATF_CHECK(time(NULL) - start < 30);
+
+    FILE *f = fopen("sleep.pid", "r");
+    ATF_REQUIRE(f != NULL);
+    int sleep_pid;
+    ATF_REQUIRE_EQ(1, fscanf(f, "%d", &sleep_pid));
+    fclose(f);
+    kill(sleep_pid, SIGTERM);
+}
+
+ATF_TC_WITHOUT_HEAD(fork_many__closed_streams);
+ATF_TC_BODY(fork_many__closed_streams, tc)
+{
+    int fds[2];
+    ATF_REQUIRE(pipe(fds) != -1);
+
+    /* The first child closes its streams but keeps running until told
+     * otherwise, which must not delay the report of the second one. */
+    pid_t pids[2];
+    const size_t i = atf_utils_fork_many(2, pids);
+    if (i == 0) {
+        char ch;
+        close(STDOUT_FILENO);
+        close(STDERR_FILENO);
+        exit(read(fds[0], &ch, 1) == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else if (i == 1)
+        exit(EXIT_SUCCESS);
+    close(fds[0]);
+
+    const atf_utils_wait_expect_t expect[2] = {
+        { EXIT_SUCCESS, "", "" },
+        { EXIT_SUCCESS, "", "" },
+    };
+    ATF_REQUIRE_EQ(pids[1], atf_utils_wait_any(pids, 2, expect));
+    ATF_REQUIRE_EQ(1, write(fds[1], "x", 1));
+    close(fds[1]);
+    ATF_REQUIRE_EQ(pids[0], atf_utils_wait_any(pids, 2, expect));
+}
+
+ATF_TC_WITHOUT_HEAD(fork_many__invalid_stdout);
+ATF_TC_BODY(fork_many__invalid_stdout, tc)
+{
+    const pid_t control = fork();
+    ATF_REQUIRE(control != -1);
+    if (control == 0) {
+        pid_t pid;
+        if (atf_utils_fork_many(1, &pid) == 0) {
+            fprintf(stdout, "Some output\n");
+            exit(EXIT_SUCCESS);
+        }
+        const atf_utils_wait_expect_t expect = {
+            EXIT_SUCCESS, "Some output foo\n", ""
+        };
+        atf_utils_reset_resultsfile();
+        atf_utils_wait_any(&pid, 1, &expect);
+        exit(EXIT_SUCCESS);
+    } else {
+        int status;
+        ATF_REQUIRE(waitpid(control, &status, 0) != -1);
+        ATF_REQUIRE(WIFEXITED(status));
+        ATF_REQUIRE_EQ(EXIT_FAILURE, WEXITSTATUS(status));
+    }
+}
+
 ATF_TC_WITHOUT_HEAD(free_charpp__empty);
 ATF_TC_BODY(free_charpp__empty, tc)
 {
@@ -306,6 +506,92 @@ ATF_TC_BODY(grep_string, tc)
     ATF_CHECK(!atf_utils_grep_string("aaaaa", str));
 }
 
+ATF_TC_WITHOUT_HEAD(linereader__none);
+ATF_TC_BODY(linereader__none, tc)
+{
+    atf_utils_create_file("empty.txt", "%s", "");
+
+    const int fd = open("empty.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+    atf_utils_linereader_t reader;
+    atf_utils_linereader_init(&reader, fd);
+    ATF_REQUIRE(atf_utils_linereader_next(&reader, NULL) == NULL);
+    ATF_REQUIRE(atf_utils_linereader_next(&reader, NULL) == NULL);
+    atf_utils_linereader_fini(&reader);
+    close(fd);
+}
+
+ATF_TC_WITHOUT_HEAD(linereader__some);
+ATF_TC_BODY(linereader__some, tc)
+{
+    atf_utils_create_file("test.txt", "First line\n\nThird line\nLast");
+
+    const int fd = open("test.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+    atf_utils_linereader_t reader;
+    atf_utils_linereader_init(&reader, fd);
+
+    const char *line;
+    size_t length;
+
+    line = atf_utils_linereader_next(&reader, &length);
+    ATF_REQUIRE_STREQ("First line", line);
+    ATF_REQUIRE_EQ(10, length);
+
+    line = atf_utils_linereader_next(&reader, &length);
+    ATF_REQUIRE_STREQ("", line);
+    ATF_REQUIRE_EQ(0, length);
+
+    line = atf_utils_linereader_next(&reader, NULL);
+    ATF_REQUIRE_STREQ("Third line", line);
+
+    line = atf_utils_linereader_next(&reader, &length);
+    ATF_REQUIRE_STREQ("Last", line);
+    ATF_REQUIRE_EQ(4, length);
+
+    ATF_REQUIRE(atf_utils_linereader_next(&reader, NULL) == NULL);
+
+    atf_utils_linereader_fini(&reader);
+    close(fd);
+}
+
+ATF_TC_WITHOUT_HEAD(linereader__long_lines);
+ATF_TC_BODY(linereader__long_lines, tc)
+{
+    const size_t long_length = 200 * 1024;
+    char *long_line = malloc(long_length + 1);
+    ATF_REQUIRE(long_line != NULL);
+    memset(long_line, 'a', long_length);
+    long_line[long_length] = '\0';
+
+    const int wfd = open("test.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ATF_REQUIRE(wfd != -1);
+    for (size_t i = 0; i < 3; i++) {
+        ATF_REQUIRE(write(wfd, "short\n", 6) == 6);
+        ATF_REQUIRE(write(wfd, long_line, long_length) ==
+                    (ssize_t)long_length);
+        ATF_REQUIRE(write(wfd, "\n", 1) == 1);
+    }
+    close(wfd);
+
+    const int fd = open("test.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+    atf_utils_linereader_t reader;
+    atf_utils_linereader_init(&reader, fd);
+    for (size_t i = 0; i < 3; i++) {
+        size_t length;
+        ATF_REQUIRE_STREQ("short", atf_utils_linereader_next(&reader, NULL));
+        ATF_REQUIRE(strcmp(long_line,
+                           atf_utils_linereader_next(&reader, &length)) == 0);
+        ATF_REQUIRE_EQ(long_length, length);
+    }
+    ATF_REQUIRE(atf_utils_linereader_next(&reader, NULL) == NULL);
+    atf_utils_linereader_fini(&reader);
+    close(fd);
+
+    free(long_line);
+}
+
 ATF_TC_WITHOUT_HEAD(readline__none);
 ATF_TC_BODY(readline__none, tc)
 {
@@ -346,6 +632,59 @@ ATF_TC_BODY(readline__some, tc)
     close(fd);
 }
 
+ATF_TC_WITHOUT_HEAD(readline__keeps_offset);
+ATF_TC_BODY(readline__keeps_offset, tc)
+{
+    atf_utils_create_file("test.txt", "First line\nSecond line\nrest");
+
+    const int fd = open("test.txt", O_RDONLY);
+    ATF_REQUIRE(fd != -1);
+
+    char *line = atf_utils_readline(fd);
+    ATF_REQUIRE_STREQ("First line", line);
+    free(line);
+
+    char buffer[7];
+    ATF_REQUIRE_EQ(6, read(fd, buffer, 6));
+    buffer[6] = '\0';
+    ATF_REQUIRE_STREQ("Second", buffer);
+
+    line = atf_utils_readline(fd);
+    ATF_REQUIRE_STREQ(" line", line);
+    free(line);
+
+    close(fd);
+}
+
+ATF_TC_WITHOUT_HEAD(readline__pipe);
+ATF_TC_BODY(readline__pipe, tc)
+{
+    int fds[2];
+    ATF_REQUIRE(pipe(fds) != -1);
+    ATF_REQUIRE_EQ(22, write(fds[1], "First line\nSecond\nrest", 22));
+    close(fds[1]);
+
+    char *line = atf_utils_readline(fds[0]);
+    ATF_REQUIRE_STREQ("First line", line);
+    free(line);
+
+    char buffer[5];
+    ATF_REQUIRE_EQ(4, read(fds[0], buffer, 4));
+    buffer[4] = '\0';
+    ATF_REQUIRE_STREQ("Seco", buffer);
+
+    line = atf_utils_readline(fds[0]);
+    ATF_REQUIRE_STREQ("nd", line);
+    free(line);
+
+    line = atf_utils_readline(fds[0]);
+    ATF_REQUIRE_STREQ("rest", line);
+    free(line);
+
+    ATF_REQUIRE(atf_utils_readline(fds[0]) == NULL);
+    close(fds[0]);
+}
+
 ATF_TC_WITHOUT_HEAD(redirect__stdout);
 ATF_TC_BODY(redirect__stdout, tc)
 {
@@ -536,15 +875,22 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, compare_file__short__not_match);
     ATF_TP_ADD_TC(tp, compare_file__long__match);
     ATF_TP_ADD_TC(tp, compare_file__long__not_match);
+    ATF_TP_ADD_TC(tp, compare_file__reports_difference);
 
     ATF_TP_ADD_TC(tp, copy_file__empty);
     ATF_TP_ADD_TC(tp, copy_file__some_contents);
+    ATF_TP_ADD_TC(tp, copy_file__large);
 
     ATF_TP_ADD_TC(tp, create_file);
 
     ATF_TP_ADD_TC(tp, file_exists);
 
     ATF_TP_ADD_TC(tp, fork);
+    ATF_TP_ADD_TC(tp, fork_many__wait_any);
+    ATF_TP_ADD_TC(tp, fork_many__large_output);
+    ATF_TP_ADD_TC(tp, fork_many__background_output);
+    ATF_TP_ADD_TC(tp, fork_many__closed_streams);
+    ATF_TP_ADD_TC(tp, fork_many__invalid_stdout);
 
     ATF_TP_ADD_TC(tp, free_charpp__empty);
     ATF_TP_ADD_TC(tp, free_charpp__some);
@@ -552,8 +898,14 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, grep_file);
     ATF_TP_ADD_TC(tp, grep_string);
 
+    ATF_TP_ADD_TC(tp, linereader__none);
+    ATF_TP_ADD_TC(tp, linereader__some);
+    ATF_TP_ADD_TC(tp, linereader__long_lines);
+
     ATF_TP_ADD_TC(tp, readline__none);
     ATF_TP_ADD_TC(tp, readline__some);
+    ATF_TP_ADD_TC(tp, readline__keeps_offset);
+    ATF_TP_ADD_TC(tp, readline__pipe);
 
     ATF_TP_ADD_TC(tp, redirect__stdout);
     ATF_TP_ADD_TC(tp, redirect__stderr);
@@ -44,6 +44,13 @@ extern "C" {
 #include <memory>
 #include <utility>
 
+extern "C" {
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/perf.h"
+#include "atf-c/detail/trace.h"
+#include "atf-c/error.h"
+}
+
 #include "atf-c++/check.hpp"
 #include "atf-c++/detail/application.hpp"
 #include "atf-c++/detail/auto_array.hpp"
@@ -108,7 +115,7 @@ struct output_check {
 };
 
 class temp_file : public std::ostream {
-    std::auto_ptr< atf::fs::path > m_path;
+    std::unique_ptr< atf::fs::path > m_path;
     int m_fd;
 
 public:
@@ -414,7 +421,7 @@ flatten_argv(char* const* argv)
 }
 
 static
-std::auto_ptr< atf::check::check_result >
+std::unique_ptr< atf::check::check_result >
 execute(const char* const* argv)
 {
     // TODO: This should go to stderr... but fixing it now may be hard as test
@@ -430,7 +437,7 @@ execute(const char* const* argv)
 }
 
 static
-std::auto_ptr< atf::check::check_result >
+std::unique_ptr< atf::check::check_result >
 execute_with_shell(char* const* argv)
 {
     const std::string cmd = flatten_argv(argv);
@@ -791,10 +798,16 @@ class atf_check : public atf::application::app {
     std::vector< output_check > m_stdout_checks;
     std::vector< output_check > m_stderr_checks;
 
+    std::string m_perf_name;
+    std::list< std::string > m_perf_values;
+    atf_perf_config_t m_perf_config;
+
     static const char* m_description;
 
     bool run_output_checks(const atf::check::check_result&,
                            const std::string&) const;
+    bool run_checks(void) const;
+    int run_duration_checks(void) const;
 
     std::string specific_args(void) const;
     options_set specific_options(void) const;
@@ -816,6 +829,7 @@ atf_check::atf_check(void) :
     m_rflag(false),
     m_xflag(false)
 {
+    atf_perf_config_init(&m_perf_config);
 }
 
 bool
@@ -835,6 +849,57 @@ atf_check::run_output_checks(const atf::check::check_result& r,
     }
 }
 
+bool
+atf_check::run_checks(void)
+    const
+{
+    atf_trace_begin("checks", NULL);
+    std::unique_ptr< atf::check::check_result > r =
+        m_xflag ? execute_with_shell(m_argv) : execute(m_argv);
+
+    const bool ok = run_status_checks(m_status_checks, *r) &&
+        run_output_checks(*r, "stderr") &&
+        run_output_checks(*r, "stdout");
+    atf_trace_end("checks");
+    return ok;
+}
+
+//!
+//! \brief Runs the command several times and checks its duration.
+//!
+//! Every run goes through the regular checks.  The median duration of the
+//! runs is then compared against the baseline given by the perf.*
+//! settings, or recorded into it.
+//!
+int
+atf_check::run_duration_checks(void)
+    const
+{
+    std::vector< double > samples;
+    for (long i = 0; i < m_perf_config.m_samples; i++) {
+        const useconds_t start = get_monotonic_useconds();
+        const bool ok = run_checks();
+        samples.push_back((get_monotonic_useconds() - start) * 1000.0);
+        if (!ok)
+            return EXIT_FAILURE;
+    }
+
+    atf_perf_stats_t stats;
+    atf_perf_stats_compute(&stats, &samples[0], samples.size());
+
+    atf_dynstr_t msg;
+    bool regressed;
+    atf_error_t err = atf_perf_evaluate(&m_perf_config, m_perf_name.c_str(),
+                                        &stats, &regressed, &msg);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+
+    std::cerr << (regressed ? "Performance regression: " : "perf: ")
+              << atf_dynstr_cstring(&msg) << "\n";
+    atf_dynstr_fini(&msg);
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 std::string
 atf_check::specific_args(void)
     const
@@ -860,6 +925,10 @@ atf_check::specific_options(void)
     opts.insert(option('r', "timeout[:interval]", "Repeat failed check until "
                 "the timeout expires."));
     opts.insert(option('x', "", "Execute command as a shell command"));
+    opts.insert(option('d', "name", "Time the command under the given name "
+                "and compare its duration against the baseline"));
+    opts.insert(option('D', "var=value", "Set a perf.* variable for the "
+                "duration check"));
 
     return opts;
 }
@@ -889,6 +958,30 @@ atf_check::process_option(int ch, const char* arg)
         m_xflag = true;
         break;
 
+    case 'd':
+        if (std::strlen(arg) == 0 || std::strpbrk(arg, " \t\n") != NULL)
+            throw atf::application::usage_error("Invalid name for the "
+                "duration check");
+        m_perf_name = arg;
+        break;
+
+    case 'D': {
+        const char* eq = std::strchr(arg, '=');
+        if (eq == NULL)
+            throw atf::application::usage_error("-D requires an argument "
+                "of the form var=value");
+        m_perf_values.push_back(eq + 1);
+        atf_error_t err = atf_perf_config_set(&m_perf_config,
+            std::string(arg, eq - arg).c_str(), m_perf_values.back().c_str());
+        if (atf_is_error(err)) {
+            char buf[1024];
+            atf_error_format(err, buf, sizeof(buf));
+            atf_error_free(err);
+            throw atf::application::usage_error("%s", buf);
+        }
+        break;
+    }
+
     default:
         UNREACHABLE;
     }
@@ -900,6 +993,8 @@ atf_check::main(void)
     if (m_argc < 1)
         throw atf::application::usage_error("No command specified");
 
+    atf_trace_process("atf-check");
+
     int status = EXIT_FAILURE;
 
     if (m_status_checks.empty())
@@ -914,16 +1009,14 @@ atf_check::main(void)
     if (m_stderr_checks.empty())
         m_stderr_checks.push_back(output_check(oc_empty, false, ""));
 
-    do {
-        std::auto_ptr< atf::check::check_result > r =
-            m_xflag ? execute_with_shell(m_argv) : execute(m_argv);
+    if (!m_perf_name.empty()) {
+        if (m_rflag)
+            throw atf::application::usage_error("Cannot combine -d and -r");
+        return run_duration_checks();
+    }
 
-        if ((run_status_checks(m_status_checks, *r) == false) ||
-            (run_output_checks(*r, "stderr") == false) ||
-            (run_output_checks(*r, "stdout") == false))
-            status = EXIT_FAILURE;
-        else
-            status = EXIT_SUCCESS;
+    do {
+        status = run_checks() ? EXIT_SUCCESS : EXIT_FAILURE;
 
         if (m_rflag && status == EXIT_FAILURE) {
             if (timo_expired(m_timo))
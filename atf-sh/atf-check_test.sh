@@ -389,6 +389,64 @@ stdin_body()
         atf_fail "atf-check does not seem to respect stdin"
 }
 
+atf_test_case dflag
+dflag_head()
+{
+    atf_set "descr" "Tests for the -d option"
+}
+dflag_body()
+{
+    atf_check -s eq:0 -o ignore -e match:'^perf: key: .*; recorded in base' \
+        ${Atf_Check} -d key -D perf.baseline=base -D perf.record=true \
+        -D perf.samples=2 true
+    atf_check -s eq:0 -o ignore -e empty grep '^key [0-9.]* [0-9.]*$' base
+
+    echo 'key 1000000000000.0 0.0' >base
+    atf_check -s eq:0 -o ignore -e match:'^perf: key: median .* is within' \
+        ${Atf_Check} -d key -D perf.baseline=base true
+
+    echo 'key 0.0 0.0' >base
+    atf_check -s eq:1 -o ignore \
+        -e match:'^Performance regression: key: median .* exceeds' \
+        ${Atf_Check} -d key -D perf.baseline=base true
+
+    atf_check -s eq:1 -o ignore -e ignore \
+        ${Atf_Check} -d key -D perf.baseline=base -s eq:1 true
+
+    atf_check -s eq:1 -o ignore -e match:'Cannot combine -d and -r' \
+        ${Atf_Check} -d key -r 1 true
+    atf_check -s eq:1 -o ignore -e match:'Invalid name' \
+        ${Atf_Check} -d 'a b' true
+    atf_check -s eq:1 -o ignore -e match:'perf.samples' \
+        ${Atf_Check} -d key -D perf.samples=0 true
+}
+
+atf_test_case trace
+trace_head()
+{
+    atf_set "descr" "Tests that ATF_TRACE records the commands run by" \
+            "atf-check and their subprocesses"
+}
+trace_body()
+{
+    atf_check -s eq:0 -o ignore -e ignore env ATF_TRACE="$(pwd)/trace.json" \
+        ${Atf_Check} -o inline:'a "b"\n' echo 'a "b"'
+
+    atf_check -o inline:"[\n" head -n 1 trace.json
+    atf_check -o ignore grep -F '"args":{"name":"atf-check"}' trace.json
+    atf_check -o ignore grep -F '"args":{"argv":"echo a \"b\""}' trace.json
+    for name in checks check fork wait; do
+        atf_check -o ignore grep -F "\"name\":\"${name}\",\"cat\":\"atf\"" \
+            trace.json
+    done
+
+    # The command is executed by a child, which records itself.
+    parent="$(sed -n '/"process_name"/s/.*"pid":\([0-9]*\).*/\1/p' trace.json)"
+    child="$(sed -n '/"name":"exec"/s/.*"pid":\([0-9]*\).*/\1/p' trace.json)"
+    [ -n "${child}" ] || atf_fail "No exec event in the trace"
+    [ "${parent}" != "${child}" ] || atf_fail "exec not traced in the child"
+}
+
 atf_test_case invalid_umask
 invalid_umask_head()
 {
@@ -435,6 +493,9 @@ atf_init_test_cases()
 
     atf_add_test_case stdin
 
+    atf_add_test_case dflag
+    atf_add_test_case trace
+
     atf_add_test_case invalid_umask
 }
 
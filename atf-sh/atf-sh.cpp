@@ -23,17 +23,38 @@
 // OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
 extern "C" {
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <unistd.h>
 }
 
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+extern "C" {
+#include "atf-c/detail/repeat.h"
+#include "atf-c/detail/watchdog.h"
+#include "atf-c/error.h"
+}
 
 #include "atf-c++/detail/application.hpp"
 #include "atf-c++/detail/env.hpp"
+#include "atf-c++/detail/exceptions.hpp"
 #include "atf-c++/detail/fs.hpp"
 #include "atf-c++/detail/sanity.hpp"
 
@@ -54,9 +75,175 @@ fix_plain_name(const char *filename)
         return std::string(filename);
 }
 
+static
+std::string
+format_elapsed(const struct timespec& start, const struct timespec& now)
+{
+    long sec = now.tv_sec - start.tv_sec;
+    long nsec = now.tv_nsec - start.tv_nsec;
+    if (nsec < 0) {
+        sec--;
+        nsec += 1000000000L;
+    }
+
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%ld.%06ld", sec, nsec / 1000);
+    return buffer;
+}
+
+//!
+//! \brief Writes the trace of a profiled test program.
+//!
+//! Reads phase markers, one per line, from the given descriptor and stores
+//! them in the trace file prefixed by the time elapsed since start.
+//! Markers are timestamped on arrival rather than by the shell, which has
+//! no portable high-resolution clock and would otherwise need to spawn
+//! date(1) for every event.
+//!
+//! The shell cannot mark the descriptor close-on-exec, so the commands
+//! run by the test case inherit it and may outlive the test program.
+//! Recording therefore stops once the given parent process is gone
+//! instead of waiting for all writers to close the descriptor.
+//!
+static
+void
+record_profile(const int fd, const std::string& path,
+               const struct timespec& start, const pid_t parent)
+{
+    std::ofstream os(path.c_str());
+    if (!os) {
+        std::cerr << "atf-sh: ERROR: Cannot create profile file '" << path
+                  << "'\n";
+        return;
+    }
+
+    std::string pending, timestamp;
+    char buffer[4096];
+    bool orphaned = false;
+    for (;;) {
+        if (!orphaned) {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            const int ready = ::poll(&pfd, 1, 100);
+            if (ready == -1 && errno != EINTR)
+                break;
+            else if (ready <= 0) {
+                if (::getppid() == parent)
+                    continue;
+                // Collect whatever the test program wrote before exiting.
+                orphaned = true;
+                (void)::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            }
+        }
+
+        const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+        if (count == -1 && errno == EINTR)
+            continue;
+        else if (count <= 0)
+            break;
+
+        struct timespec now;
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        timestamp = format_elapsed(start, now);
+
+        pending.append(buffer, count);
+        std::string::size_type pos;
+        while ((pos = pending.find('\n')) != std::string::npos) {
+            os << timestamp << ' ' << pending.substr(0, pos) << '\n';
+            pending.erase(0, pos + 1);
+        }
+        os.flush();
+    }
+    if (!pending.empty())
+        os << timestamp << ' ' << pending << '\n';
+}
+
+//!
+//! \brief Writes a phase marker to the process recording the trace.
+//!
+static
+void
+write_marker(const int fd, const char* marker)
+{
+    std::size_t done = 0;
+    const std::size_t length = std::strlen(marker);
+    while (done < length) {
+        const ssize_t count = ::write(fd, marker + done, length - done);
+        if (count == -1 && errno == EINTR)
+            continue;
+        else if (count <= 0)
+            throw std::runtime_error(std::string("Cannot write to the "
+                                                 "profiler: ") +
+                                     std::strerror(errno));
+        done += count;
+    }
+}
+
+//!
+//! \brief Lets the shell about to be executed inherit the profile pipe.
+//!
+static
+void
+inherit_profile_fd(const int fd)
+{
+    if (fd != -1)
+        (void)::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+}
+
+//!
+//! \brief Spawns the process that records the trace of the test program.
+//!
+//! \return The descriptor to which phase markers have to be written.  It
+//! is close-on-exec; see inherit_profile_fd.
+//!
+static
+int
+start_profiler(const std::string& path)
+{
+    struct timespec start;
+    if (::clock_gettime(CLOCK_MONOTONIC, &start) == -1)
+        throw std::runtime_error(std::string("clock_gettime failed: ") +
+                                 std::strerror(errno));
+
+    int fds[2];
+    if (::pipe(fds) == -1)
+        throw std::runtime_error(std::string("Cannot create profile pipe: ") +
+                                 std::strerror(errno));
+    (void)::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    (void)::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    const pid_t parent = ::getpid();
+    const pid_t pid = ::fork();
+    if (pid == -1)
+        throw std::runtime_error(std::string("Cannot spawn profiler: ") +
+                                 std::strerror(errno));
+    else if (pid == 0) {
+        ::close(fds[1]);
+
+        // Do not keep our caller's stdin and stdout open in case it is
+        // waiting for them to be closed to know that we are done.
+        const int null_fd = ::open("/dev/null", O_RDWR);
+        if (null_fd != -1) {
+            ::dup2(null_fd, STDIN_FILENO);
+            ::dup2(null_fd, STDOUT_FILENO);
+            if (null_fd > STDERR_FILENO)
+                ::close(null_fd);
+        }
+
+        record_profile(fds[0], path, start, parent);
+        std::exit(EXIT_SUCCESS);
+    }
+
+    ::close(fds[0]);
+    write_marker(fds[1], "exec begin\n");
+    return fds[1];
+}
+
 static
 std::string*
-construct_script(const char* filename)
+construct_script(const char* filename, const int profile_fd,
+                 const bool warned)
 {
     const std::string libexecdir = atf::env::get(
         "ATF_LIBEXECDIR", ATF_LIBEXECDIR);
@@ -67,22 +254,39 @@ construct_script(const char* filename)
     std::string* command = new std::string();
     command->reserve(512);
     (*command) += ("Atf_Check='" + libexecdir + "/atf-check' ; " +
-                   "Atf_Shell='" + shell + "' ; " +
-                   ". " + pkgdatadir + "/libatf-sh.subr ; " +
-                   ". " + fix_plain_name(filename) + " ; " +
-                   "main \"${@}\"");
+                   "Atf_Shell='" + shell + "' ; ");
+    if (warned)
+        (*command) += "Atf_Warned=true ; ";
+    if (profile_fd == -1) {
+        (*command) += (". " + pkgdatadir + "/libatf-sh.subr ; " +
+                       ". " + fix_plain_name(filename) + " ; ");
+    } else {
+        std::ostringstream fd;
+        fd << profile_fd;
+        (*command) += ("Atf_Profile_Fd=" + fd.str() + " ; " +
+                       "echo 'exec end' >&" + fd.str() + " ; " +
+                       "echo 'library begin' >&" + fd.str() + " ; " +
+                       ". " + pkgdatadir + "/libatf-sh.subr ; " +
+                       "_atf_profile library end ; " +
+                       "_atf_profile script begin ; " +
+                       ". " + fix_plain_name(filename) + " ; " +
+                       "_atf_profile script end ; ");
+    }
+    (*command) += "main \"${@}\"";
     return command;
 }
 
 static
 const char**
 construct_argv(const std::string& shell, const int interpreter_argc,
-               const char* const* interpreter_argv)
+               const char* const* interpreter_argv, const int profile_fd,
+               const bool warned = false)
 {
     PRE(interpreter_argc >= 1);
     PRE(interpreter_argv[0] != NULL);
 
-    const std::string* script = construct_script(interpreter_argv[0]);
+    const std::string* script = construct_script(interpreter_argv[0],
+                                                 profile_fd, warned);
 
     const int count = 4 + (interpreter_argc - 1) + 1;
     const char** argv = new const char*[count];
@@ -99,6 +303,303 @@ construct_argv(const std::string& shell, const int interpreter_argc,
     return argv;
 }
 
+//!
+//! \brief A test case of a shell test program to run in child processes.
+//!
+//! The shell has no clock to time the runs of a test case with nor to
+//! enforce its timeout, so -n, -d and -t are handled here instead of by
+//! the shell library and every run starts a new shell.
+//!
+struct child_data {
+    std::string m_shell;
+    std::string m_script;
+    std::vector< std::string > m_args;
+    std::string m_tcname;
+    int m_profile_fd;
+};
+
+static
+void
+exec_run(const child_data& data, const std::vector< std::string >& args)
+{
+    std::vector< const char* > argv;
+    argv.push_back(data.m_script.c_str());
+    for (std::vector< std::string >::const_iterator iter = args.begin();
+         iter != args.end(); iter++)
+        argv.push_back((*iter).c_str());
+    argv.push_back(NULL);
+
+    const char** shell_argv = construct_argv(data.m_shell, argv.size() - 1,
+                                             &argv[0], data.m_profile_fd,
+                                             true);
+    inherit_profile_fd(data.m_profile_fd);
+    (void)execv(data.m_shell.c_str(), const_cast< char** >(shell_argv));
+    std::cerr << "Failed to execute " << data.m_shell << ": "
+              << std::strerror(errno) << "\n";
+    std::exit(EXIT_FAILURE);
+}
+
+static
+void
+child_body(void* raw_data, const char* resfile)
+{
+    const child_data& data = *static_cast< const child_data* >(raw_data);
+
+    std::vector< std::string > args(data.m_args);
+    args.push_back("-r");
+    args.push_back(resfile);
+    args.push_back(data.m_tcname);
+    exec_run(data, args);
+}
+
+static
+void
+child_cleanup(void* raw_data)
+{
+    const child_data& data = *static_cast< const child_data* >(raw_data);
+
+    std::vector< std::string > args(data.m_args);
+    args.push_back(data.m_tcname + ":cleanup");
+    exec_run(data, args);
+}
+
+//!
+//! \brief Extracts the -n, -d and -t flags from the arguments of a test
+//! program.
+//!
+//! \return False if the test case does not have to be run from here, or if
+//! the arguments are invalid, in which case the shell library reports it.
+//!
+static
+bool
+parse_child_flags(const int argc, char* const* argv, atf_repeat_t& repeat,
+                  atf_watchdog_t& watchdog, child_data& data,
+                  std::string& resfile)
+{
+    std::string optstr;
+#if defined(HAVE_GNU_GETOPT)
+    optstr += '+';
+#endif
+    optstr += ":d:ln:r:s:t:v:";
+
+    bool lflag = false, valid = true;
+    int ch;
+    const int old_opterr = ::opterr;
+    ::opterr = 0;
+    while (valid && (ch = ::getopt(argc, argv, optstr.c_str())) != -1) {
+        switch (ch) {
+        case 'd':
+            if (!atf_repeat_set_duration(&repeat, ::optarg))
+                throw atf::application::usage_error("Invalid duration `%s'; "
+                    "must be a positive number of seconds", ::optarg);
+            break;
+
+        case 'l':
+            lflag = true;
+            break;
+
+        case 'n':
+            if (!atf_repeat_set_runs(&repeat, ::optarg))
+                throw atf::application::usage_error("Invalid number of "
+                    "runs `%s'; must be a positive integer", ::optarg);
+            break;
+
+        case 'r':
+            resfile = ::optarg;
+            break;
+
+        case 't':
+            if (!atf_watchdog_set_grace(&watchdog, ::optarg))
+                throw atf::application::usage_error("Invalid grace period "
+                    "`%s'; must be a positive number of seconds", ::optarg);
+            break;
+
+        case ':':
+        case '?':
+            valid = false;
+            break;
+
+        default:
+            data.m_args.push_back(std::string("-") + static_cast< char >(ch));
+            data.m_args.push_back(::optarg);
+        }
+    }
+    const int operands = argc - ::optind;
+    const std::string tcarg = operands == 1 ? argv[::optind] : "";
+
+    ::opterr = old_opterr;
+    ::optind = 1;
+#if defined(HAVE_OPTRESET)
+    ::optreset = 1;
+#endif
+
+    const bool repeated = atf_repeat_enabled(&repeat);
+    const bool watched = atf_watchdog_enabled(&watchdog);
+    if (!valid || (!repeated && !watched))
+        return false;
+    if (lflag)
+        throw atf::application::usage_error(repeated ?
+            "Cannot repeat test cases with -l" :
+            "Cannot enforce timeouts with -l");
+    if (repeated && watched)
+        throw atf::application::usage_error("Cannot enforce timeouts of "
+                                            "repeated test cases");
+    if (operands != 1)
+        return false;
+
+    const std::string::size_type pos = tcarg.find(':');
+    if (pos != std::string::npos && tcarg.substr(pos + 1) == "cleanup")
+        throw atf::application::usage_error(repeated ?
+            "Cannot repeat the cleanup of a test case" :
+            "Cannot enforce the timeout of the cleanup of a test case");
+    data.m_tcname = tcarg.substr(0, pos);
+    return true;
+}
+
+//!
+//! \brief Reads the metadata of the test case to run by listing the test
+//! program.
+//!
+//! \return False if the test program does not define the test case.
+//!
+static
+bool
+read_metadata(const child_data& data,
+              std::map< std::string, std::string >& md)
+{
+    int fds[2];
+    if (::pipe(fds) == -1)
+        throw std::runtime_error(std::string("Cannot create pipe: ") +
+                                 std::strerror(errno));
+
+    std::cout.flush();
+    std::cerr.flush();
+    const pid_t pid = ::fork();
+    if (pid == -1)
+        throw std::runtime_error(std::string("Cannot list the test "
+                                             "program: ") +
+                                 std::strerror(errno));
+    else if (pid == 0) {
+        ::close(fds[0]);
+        if (::dup2(fds[1], STDOUT_FILENO) == -1)
+            std::exit(EXIT_FAILURE);
+        ::close(fds[1]);
+
+        child_data listing(data);
+        listing.m_profile_fd = -1;
+        std::vector< std::string > args(data.m_args);
+        args.push_back("-l");
+        exec_run(listing, args);
+    }
+    ::close(fds[1]);
+
+    std::string output;
+    char buffer[4096];
+    for (;;) {
+        const ssize_t count = ::read(fds[0], buffer, sizeof(buffer));
+        if (count == -1 && errno == EINTR)
+            continue;
+        else if (count <= 0)
+            break;
+        output.append(buffer, count);
+    }
+    ::close(fds[0]);
+
+    int status;
+    while (::waitpid(pid, &status, 0) == -1 && errno == EINTR)
+        continue;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        return false;
+
+    // The properties of each test case follow its 'ident' up to the next
+    // one; see atf-test-program(1).
+    bool found = false, current = false;
+    std::istringstream is(output);
+    std::string line;
+    while (std::getline(is, line)) {
+        const std::string::size_type pos = line.find(": ");
+        if (pos == std::string::npos)
+            continue;
+        const std::string name = line.substr(0, pos);
+        const std::string value = line.substr(pos + 2);
+        if (name == "ident") {
+            current = value == data.m_tcname;
+            found = found || current;
+        } else if (current)
+            md[name] = value;
+    }
+    return found;
+}
+
+static
+void
+warn_unsupported(const child_data& data, const bool watched)
+{
+    if (atf::env::get("__RUNNING_INSIDE_ATF_RUN", "") ==
+        "internal-yes-value")
+        return;
+
+    const std::string name = atf::fs::path(data.m_script).leaf_name();
+    std::cerr << name << ": WARNING: Running test cases outside of "
+        "kyua(1) is unsupported\n";
+    if (watched)
+        std::cerr << name << ": WARNING: No isolation is being applied; "
+            "you may get unexpected failures; see atf-test-case(4)\n";
+    else
+        std::cerr << name << ": WARNING: No isolation nor timeout control "
+            "is being applied; you may get unexpected failures; see "
+            "atf-test-case(4)\n";
+}
+
+static
+int
+repeat_tc(const atf_repeat_t& repeat, child_data& data,
+          const std::string& resfile)
+{
+    warn_unsupported(data, false);
+
+    bool passed;
+    atf_error_t err = atf_repeat_run(&repeat, data.m_tcname.c_str(),
+                                     child_body, child_cleanup, &data,
+                                     resfile.c_str(), &passed);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//!
+//! \brief Runs the body of a test case within its timeout as requested by
+//! -t.
+//!
+//! \return False if the test program does not define the test case.
+//!
+static
+bool
+watchdog_tc(const atf_watchdog_t& watchdog, child_data& data,
+            const std::string& resfile, int& exitcode)
+{
+    std::map< std::string, std::string > md;
+    if (!read_metadata(data, md))
+        return false;
+    warn_unsupported(data, true);
+
+    const bool has_cleanup = md["has.cleanup"] == "true";
+    const std::map< std::string, std::string >::const_iterator timeout =
+        md.find("timeout");
+
+    bool passed;
+    atf_error_t err = atf_watchdog_run(&watchdog,
+                                       timeout != md.end() ?
+                                       (*timeout).second.c_str() : NULL,
+                                       child_body,
+                                       has_cleanup ? child_cleanup : NULL,
+                                       &data, resfile.c_str(), &passed);
+    if (atf_is_error(err))
+        atf::throw_atf_error(err);
+    exitcode = passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    return true;
+}
+
 } // anonymous namespace
 
 // ------------------------------------------------------------------------
@@ -167,10 +668,39 @@ atf_sh::main(void)
         throw std::runtime_error("The test program '" + script.str() + "' "
                                  "does not exist");
 
-    const char** argv = construct_argv(m_shell.str(), m_argc, m_argv);
+    int profile_fd = -1;
+    const std::string profile = atf::env::get("ATF_SH_PROFILE", "");
+    if (!profile.empty())
+        profile_fd = start_profiler(profile);
+
+    atf_repeat_t repeat;
+    atf_repeat_init(&repeat);
+    atf_watchdog_t watchdog;
+    atf_watchdog_init(&watchdog);
+    child_data data;
+    std::string resfile = "/dev/stdout";
+    if (parse_child_flags(m_argc, m_argv, repeat, watchdog, data, resfile)) {
+        data.m_shell = m_shell.str();
+        data.m_script = m_argv[0];
+        data.m_profile_fd = profile_fd;
+        if (atf_repeat_enabled(&repeat))
+            return repeat_tc(repeat, data, resfile);
+
+        int exitcode;
+        if (watchdog_tc(watchdog, data, resfile, exitcode))
+            return exitcode;
+
+        // Let the shell library report why the test case cannot be run.
+        child_body(&data, resfile.c_str());
+        UNREACHABLE;
+    }
+
+    const char** argv = construct_argv(m_shell.str(), m_argc, m_argv,
+                                       profile_fd);
     // Don't bother keeping track of the memory allocated by construct_argv:
     // we are going to exec or die immediately.
 
+    inherit_profile_fd(profile_fd);
     const int ret = execv(m_shell.c_str(), const_cast< char** >(argv));
     INV(ret == -1);
     std::cerr << "Failed to execute " << m_shell.str() << ": "
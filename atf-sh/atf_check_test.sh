@@ -207,6 +207,28 @@ flush_stdout_on_death_body()
         || atf_fail 'Second command not in output'
 }
 
+atf_test_case duration
+duration_head()
+{
+    atf_set "descr" "Verifies that atf_check_duration works"
+}
+duration_body()
+{
+    h="$(atf_get_srcdir)/misc_helpers -s $(atf_get_srcdir)"
+
+    atf_check -s eq:0 -o ignore -e ignore -x \
+        "${h} -v perf.baseline=base -v perf.record=true" \
+        "-v perf.samples=2 atf_check_duration"
+    atf_check -s eq:0 -o ignore -e empty \
+        grep '^atf_check_duration/quick [0-9.]* [0-9.]*$' base
+
+    echo 'atf_check_duration/quick 0.0 0.0' >base
+    atf_check -s eq:1 -o ignore -e match:'Performance regression' -x \
+        "${h} -r resfile -v perf.baseline=base atf_check_duration"
+    atf_check -s eq:0 -o ignore -e empty grep '^failed: atf-check failed' \
+        resfile
+}
+
 atf_init_test_cases()
 {
     atf_add_test_case info_ok
@@ -216,6 +238,7 @@ atf_init_test_cases()
     atf_add_test_case null_stderr
     atf_add_test_case equal
     atf_add_test_case flush_stdout_on_death
+    atf_add_test_case duration
 }
 
 # vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
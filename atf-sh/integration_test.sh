@@ -147,6 +147,44 @@ EOF
         "${ATF_SH}" -s ./custom-shell tp helper
 }
 
+atf_test_case profile
+profile_head()
+{
+    atf_set "descr" "Validates that ATF_SH_PROFILE records the phases of" \
+        "a test program"
+}
+profile_body()
+{
+    cat >tp <<EOF
+atf_test_case helper
+helper_body() {
+    atf_check -s eq:0 -o ignore true
+}
+atf_init_test_cases() {
+    atf_add_test_case helper
+}
+EOF
+    ATF_SH_PROFILE="$(pwd)/trace" atf_check -s eq:0 -o match:passed \
+        -e ignore "${ATF_SH}" tp helper
+
+    # The profiler may still be flushing the trace after the shell exits.
+    i=0
+    while [ ${i} -lt 50 ] && ! grep 'resfile end' trace >/dev/null 2>&1; do
+        sleep 0.1
+        i=$((${i} + 1))
+    done
+
+    for phase in 'exec begin' 'exec end' 'library begin' 'library end' \
+        'script begin' 'script end' 'init begin' 'init end' \
+        'head begin helper' 'head end helper' 'body begin helper' \
+        'check begin -s eq:0 -o ignore true' 'check end 0' \
+        'body end helper' 'resfile begin' 'resfile end'
+    do
+        atf_check -s eq:0 -o ignore -e empty \
+            grep "^[0-9]*\.[0-9]\{6\} ${phase}\$" trace
+    done
+}
+
 atf_init_test_cases()
 {
     atf_add_test_case no_args
@@ -155,6 +193,7 @@ atf_init_test_cases()
     atf_add_test_case custom_shell__command_line
     atf_add_test_case custom_shell__shebang
     atf_add_test_case set_e
+    atf_add_test_case profile
 }
 
 # vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
@@ -199,6 +199,16 @@ atf_check_flush_stdout_body()
     done
 }
 
+atf_test_case atf_check_duration
+atf_check_duration_head()
+{
+    atf_set "descr" "Helper test case for the t_atf_check test program"
+}
+atf_check_duration_body()
+{
+    atf_check_duration quick true
+}
+
 # -------------------------------------------------------------------------
 # Helper tests for "t_config".
 # -------------------------------------------------------------------------
@@ -334,6 +344,7 @@ atf_init_test_cases()
     atf_add_test_case atf_check_not_equal_eval_ok
     atf_add_test_case atf_check_not_equal_eval_fail
     atf_add_test_case atf_check_flush_stdout
+    atf_add_test_case atf_check_duration
 
     # Add helper tests for t_config.
     atf_add_test_case config_get
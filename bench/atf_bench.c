@@ -0,0 +1,425 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include "atf-c/check.h"
+
+#include "atf-c/detail/dynstr.h"
+#include "atf-c/detail/fs.h"
+#include "atf-c/detail/list.h"
+#include "atf-c/detail/map.h"
+
+/* Benchmarks of the framework itself.  The ones that spawn programs use
+ * the helpers built next to this program and the atf-check binary given
+ * by the atf_check configuration variable, which the bench target of the
+ * top-level Makefile sets. */
+
+/* ---------------------------------------------------------------------
+ * Auxiliary functions.
+ * --------------------------------------------------------------------- */
+
+#define RE(stm) ATF_REQUIRE(!atf_is_error(stm))
+
+#define UNCONST(a) ((void *)(uintptr_t)(const void *)(a))
+
+static const char *const keys[] = {
+    "descr", "has.cleanup", "require.arch", "require.config",
+    "require.files", "require.machine", "require.memory", "require.progs",
+    "require.user", "timeout", "X-type", "X-perf.counters",
+    "X-profile.alloc", "X-stress.threads", "X-stress.iterations", "ident",
+};
+#define NKEYS (sizeof(keys) / sizeof(keys[0]))
+
+/** Runs a program with its output discarded and requires it to exit
+ * successfully. */
+static void
+run_quietly(const char *const *argv, const char *const *env)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    ATF_REQUIRE(pid != -1);
+    if (pid == 0) {
+        const int fd = open("/dev/null", O_WRONLY);
+
+        if (fd == -1 || dup2(fd, STDOUT_FILENO) == -1 ||
+            dup2(fd, STDERR_FILENO) == -1)
+            _exit(EXIT_FAILURE);
+        if (env != NULL) {
+            for (; *env != NULL; env += 2)
+                setenv(env[0], env[1], 1);
+        }
+        execv(argv[0], UNCONST(argv));
+        _exit(127);
+    }
+
+    ATF_REQUIRE(waitpid(pid, &status, 0) != -1);
+    ATF_REQUIRE_MSG(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS,
+                    "%s did not exit successfully", argv[0]);
+}
+
+static void
+helper_path(const atf_tc_t *tc, const char *name, char *buf,
+            const size_t buflen)
+{
+    const int len = snprintf(buf, buflen, "%s/%s",
+                             atf_tc_get_config_var(tc, "srcdir"), name);
+
+    ATF_REQUIRE(len > 0 && (size_t)len < buflen);
+}
+
+/** Skips the benchmark if the given program cannot be executed, as happens
+ * with the installed tools in a tree that has not been installed yet. */
+static void
+skip_unless_executable(const char *path)
+{
+    if (access(path, X_OK) == -1)
+        atf_tc_skip("Cannot execute %s: %s", path, strerror(errno));
+}
+
+/** Skips the benchmark if the interpreter named in the #! line of the given
+ * script cannot be executed. */
+static void
+skip_unless_interpreter(const char *script)
+{
+    char line[1024];
+    FILE *f;
+
+    f = fopen(script, "r");
+    ATF_REQUIRE_MSG(f != NULL, "Cannot open %s", script);
+    ATF_REQUIRE(fgets(line, sizeof(line), f) != NULL);
+    fclose(f);
+    ATF_REQUIRE(strncmp(line, "#! ", 3) == 0);
+    line[3 + strcspn(line + 3, " \n")] = '\0';
+    skip_unless_executable(line + 3);
+}
+
+/* ---------------------------------------------------------------------
+ * Benchmarks for the internal data types.
+ * --------------------------------------------------------------------- */
+
+ATF_BENCH(map_insert_find);
+ATF_BENCH_HEAD(map_insert_find, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Fills a map with as many properties as "
+                      "a test case usually has and looks them all up");
+}
+ATF_BENCH_BODY(map_insert_find, tc, iters)
+{
+    size_t i, j;
+
+    for (i = 0; i < iters; i++) {
+        atf_map_t map;
+
+        RE(atf_map_init(&map));
+        for (j = 0; j < NKEYS; j++)
+            RE(atf_map_insert(&map, keys[j], UNCONST(keys[j]), false));
+        for (j = 0; j < NKEYS; j++)
+            ATF_REQUIRE(atf_map_find_c(&map, keys[NKEYS - j - 1]).m_entry !=
+                        NULL);
+        atf_map_fini(&map);
+    }
+}
+
+ATF_BENCH(list_append_iterate);
+ATF_BENCH_HEAD(list_append_iterate, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Appends 64 elements to a list and "
+                      "iterates over them");
+}
+ATF_BENCH_BODY(list_append_iterate, tc, iters)
+{
+    size_t i, j;
+
+    for (i = 0; i < iters; i++) {
+        atf_list_t list;
+        atf_list_citer_t iter;
+        size_t total = 0;
+
+        RE(atf_list_init(&list));
+        for (j = 0; j < 64; j++)
+            RE(atf_list_append(&list, UNCONST(keys[j % NKEYS]), false));
+        atf_list_for_each_c(iter, &list)
+            total += strlen(atf_list_citer_data(iter));
+        ATF_REQUIRE(total > 0);
+        atf_list_fini(&list);
+    }
+}
+
+ATF_BENCH(dynstr_append);
+ATF_BENCH_HEAD(dynstr_append, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Builds a string out of 32 formatted "
+                      "appends");
+}
+ATF_BENCH_BODY(dynstr_append, tc, iters)
+{
+    size_t i, j;
+
+    for (i = 0; i < iters; i++) {
+        atf_dynstr_t str;
+
+        RE(atf_dynstr_init(&str));
+        for (j = 0; j < 32; j++)
+            RE(atf_dynstr_append_fmt(&str, "%s=%zu; ", keys[j % NKEYS], j));
+        ATF_REQUIRE(atf_dynstr_length(&str) > 0);
+        atf_dynstr_fini(&str);
+    }
+}
+
+ATF_BENCH(fs_path_normalize);
+ATF_BENCH_HEAD(fs_path_normalize, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Constructs, and thus normalizes, a "
+                      "path with redundant separators and appends to it");
+}
+ATF_BENCH_BODY(fs_path_normalize, tc, iters)
+{
+    size_t i;
+
+    for (i = 0; i < iters; i++) {
+        atf_fs_path_t path;
+
+        RE(atf_fs_path_init_fmt(&path,
+            "//usr//local///tests/%s//atf-c/", "atf")); /* NO_CHECK_STYLE */
+        RE(atf_fs_path_append_fmt(&path,
+            "detail//%s", "fs_test")); /* NO_CHECK_STYLE */
+        ATF_REQUIRE(atf_fs_path_is_absolute(&path));
+        atf_fs_path_fini(&path);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Benchmarks for the startup of test programs.
+ * --------------------------------------------------------------------- */
+
+/* The helpers exit as soon as their body starts, so each iteration covers
+ * the startup of a test program up to the first instruction of a body. */
+
+ATF_BENCH(startup_c);
+ATF_BENCH_HEAD(startup_c, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Runs a C test program up to the body "
+                      "of its test case");
+}
+ATF_BENCH_BODY(startup_c, tc, iters)
+{
+    char prog[1024];
+    size_t i;
+
+    helper_path(tc, "h_startup_c", prog, sizeof(prog));
+    for (i = 0; i < iters; i++) {
+        const char *const argv[] = { prog, "-r", "/dev/null", "startup",
+                                     NULL };
+        run_quietly(argv, NULL);
+    }
+}
+
+ATF_BENCH(startup_cpp);
+ATF_BENCH_HEAD(startup_cpp, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Runs a C++ test program up to the body "
+                      "of its test case");
+}
+ATF_BENCH_BODY(startup_cpp, tc, iters)
+{
+    char prog[1024];
+    size_t i;
+
+    helper_path(tc, "h_startup_cpp", prog, sizeof(prog));
+    for (i = 0; i < iters; i++) {
+        const char *const argv[] = { prog, "-r", "/dev/null", "startup",
+                                     NULL };
+        run_quietly(argv, NULL);
+    }
+}
+
+ATF_BENCH(startup_sh);
+ATF_BENCH_HEAD(startup_sh, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Runs a shell test program up to the "
+                      "body of its test case");
+}
+ATF_BENCH_BODY(startup_sh, tc, iters)
+{
+    char prog[1024];
+    size_t i;
+
+    helper_path(tc, "h_startup_sh", prog, sizeof(prog));
+    skip_unless_interpreter(prog);
+    for (i = 0; i < iters; i++) {
+        const char *const argv[] = { prog, "-r", "/dev/null", "startup",
+                                     NULL };
+        run_quietly(argv, NULL);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Benchmarks for the listing of test cases.
+ * --------------------------------------------------------------------- */
+
+static void
+list_tcs(const atf_tc_t *tc, const char *count, const size_t iters)
+{
+    char prog[1024];
+    size_t i;
+
+    helper_path(tc, "h_list", prog, sizeof(prog));
+    for (i = 0; i < iters; i++) {
+        const char *const argv[] = { prog, "-l", NULL };
+        const char *const env[] = { "H_LIST_COUNT", count, NULL };
+        run_quietly(argv, env);
+    }
+}
+
+#define LIST_BENCH(count) \
+    ATF_BENCH(list_ ## count); \
+    ATF_BENCH_HEAD(list_ ## count, tc) \
+    { \
+        atf_tc_set_md_var(tc, "descr", "Lists a test program with " \
+                          #count " test cases"); \
+    } \
+    ATF_BENCH_BODY(list_ ## count, tc, iters) \
+    { \
+        list_tcs(tc, #count, iters); \
+    }
+
+LIST_BENCH(1)
+LIST_BENCH(10)
+LIST_BENCH(100)
+LIST_BENCH(1000)
+
+/* ---------------------------------------------------------------------
+ * Benchmarks for the execution of checks.
+ * --------------------------------------------------------------------- */
+
+ATF_BENCH(check_exec_array);
+ATF_BENCH_HEAD(check_exec_array, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Runs true(1) through "
+                      "atf_check_exec_array and collects its result");
+}
+ATF_BENCH_BODY(check_exec_array, tc, iters)
+{
+    const char *const argv[] = { "true", NULL };
+    size_t i;
+
+    for (i = 0; i < iters; i++) {
+        atf_check_result_t result;
+
+        RE(atf_check_exec_array(argv, &result));
+        ATF_REQUIRE(atf_check_result_exited(&result));
+        atf_check_result_fini(&result);
+    }
+}
+
+static void
+run_atf_check(const atf_tc_t *tc, const char *const *args, const size_t iters)
+{
+    const char *argv[8];
+    size_t i, n;
+
+    argv[0] = atf_tc_get_config_var(tc, "atf_check");
+    skip_unless_executable(argv[0]);
+    for (n = 1; args[n - 1] != NULL; n++) {
+        ATF_REQUIRE(n < sizeof(argv) / sizeof(argv[0]) - 1);
+        argv[n] = args[n - 1];
+    }
+    argv[n] = NULL;
+
+    for (i = 0; i < iters; i++)
+        run_quietly(argv, NULL);
+}
+
+#define ATF_CHECK_BENCH(name, descr, ...) \
+    ATF_BENCH(atf_check_ ## name); \
+    ATF_BENCH_HEAD(atf_check_ ## name, tc) \
+    { \
+        atf_tc_set_md_var(tc, "descr", "Runs atf-check " descr); \
+        atf_tc_set_md_var(tc, "require.config", "atf_check"); \
+    } \
+    ATF_BENCH_BODY(atf_check_ ## name, tc, iters) \
+    { \
+        const char *const args[] = { __VA_ARGS__, NULL }; \
+        run_atf_check(tc, args, iters); \
+    }
+
+ATF_CHECK_BENCH(status, "checking the exit status only",
+                "-s", "exit:0", "true")
+ATF_CHECK_BENCH(empty, "expecting empty output",
+                "-o", "empty", "-e", "empty", "true")
+ATF_CHECK_BENCH(inline, "comparing the output to an inline string",
+                "-o", "inline:foo\\n", "echo", "foo")
+ATF_CHECK_BENCH(match, "matching the output against a regexp",
+                "-o", "match:^f.o$", "echo", "foo")
+ATF_CHECK_BENCH(save, "saving the output to a file",
+                "-o", "save:/dev/null", "echo", "foo")
+ATF_CHECK_BENCH(shell, "running a shell command",
+                "-x", "true")
+
+/* ---------------------------------------------------------------------
+ * Main.
+ * --------------------------------------------------------------------- */
+
+ATF_TP_ADD_TCS(tp)
+{
+    ATF_TP_ADD_BENCH(tp, map_insert_find);
+    ATF_TP_ADD_BENCH(tp, list_append_iterate);
+    ATF_TP_ADD_BENCH(tp, dynstr_append);
+    ATF_TP_ADD_BENCH(tp, fs_path_normalize);
+
+    ATF_TP_ADD_BENCH(tp, startup_c);
+    ATF_TP_ADD_BENCH(tp, startup_cpp);
+    ATF_TP_ADD_BENCH(tp, startup_sh);
+
+    ATF_TP_ADD_BENCH(tp, list_1);
+    ATF_TP_ADD_BENCH(tp, list_10);
+    ATF_TP_ADD_BENCH(tp, list_100);
+    ATF_TP_ADD_BENCH(tp, list_1000);
+
+    ATF_TP_ADD_BENCH(tp, check_exec_array);
+    ATF_TP_ADD_BENCH(tp, atf_check_status);
+    ATF_TP_ADD_BENCH(tp, atf_check_empty);
+    ATF_TP_ADD_BENCH(tp, atf_check_inline);
+    ATF_TP_ADD_BENCH(tp, atf_check_match);
+    ATF_TP_ADD_BENCH(tp, atf_check_save);
+    ATF_TP_ADD_BENCH(tp, atf_check_shell);
+
+    return atf_no_error();
+}
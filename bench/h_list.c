@@ -0,0 +1,87 @@
+/* Copyright (c) 2014 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+ * CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atf-c.h>
+
+/* A test program with as many test cases as H_LIST_COUNT says, up to
+ * MAX_TCS, to time how listing scales with the size of a program. */
+
+#define MAX_TCS 1000
+
+static atf_tc_t tcs[MAX_TCS];
+static struct atf_tc_pack packs[MAX_TCS];
+static char idents[MAX_TCS][16];
+
+static void
+head(atf_tc_t *tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case");
+    atf_tc_set_md_var(tc, "require.progs", "true");
+}
+
+static void
+body(const atf_tc_t *tc ATF_DEFS_ATTRIBUTE_UNUSED)
+{
+}
+
+ATF_TP_ADD_TCS(tp)
+{
+    const char *value = getenv("H_LIST_COUNT");
+    char **config;
+    long count;
+    long i;
+
+    count = value == NULL ? 1 : strtol(value, NULL, 10);
+    if (count < 1 || count > MAX_TCS)
+        count = 1;
+
+    config = atf_tp_get_config(tp);
+    if (config == NULL)
+        return atf_no_memory_error();
+
+    for (i = 0; i < count; i++) {
+        atf_error_t err;
+
+        snprintf(idents[i], sizeof(idents[i]), "tc%ld", i);
+        packs[i].m_ident = idents[i];
+        packs[i].m_head = head;
+        packs[i].m_body = body;
+
+        err = atf_tc_init_pack(&tcs[i], &packs[i],
+                               (const char *const *)config);
+        if (!atf_is_error(err))
+            err = atf_tp_add_tc(tp, &tcs[i]);
+        if (atf_is_error(err)) {
+            atf_utils_free_charpp(config);
+            return err;
+        }
+    }
+
+    atf_utils_free_charpp(config);
+    return atf_no_error();
+}
@@ -0,0 +1,76 @@
+# Copyright (c) 2014 The NetBSD Foundation, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND
+# CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES,
+# INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+# IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+# GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+# IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+# Runs every benchmark of a test program and prints their results as JSON,
+# one object per line.
+#
+# Usage: run-bench.sh program [test program flags]
+
+Prog_Name=${0##*/}
+
+if [ ${#} -lt 1 ]; then
+    echo "Usage: ${Prog_Name} program [test program flags]" 1>&2
+    exit 1
+fi
+program="${1}"; shift
+case "${program}" in
+    /*) ;;
+    *) program="$(pwd)/${program}" ;;
+esac
+
+tmpdir=$(mktemp -d "${TMPDIR:-/tmp}/atf-bench.XXXXXX") || exit 1
+trap 'rm -rf "${tmpdir}"' EXIT
+
+# Turns the summary line printed by a benchmark into a JSON object.
+num='\([0-9.]*\)'
+to_json="s/^bench: \([^:]*\): ${num} iterations x ${num} runs;"
+to_json="${to_json} per iteration: min ${num} ns, median ${num} ns,"
+to_json="${to_json} p99 ${num} ns; ${num} iterations\/s$/"
+to_json="${to_json}{\"name\": \"\1\", \"iterations\": \2, \"runs\": \3,"
+to_json="${to_json} \"min_ns\": \4, \"median_ns\": \5, \"p99_ns\": \6,"
+to_json="${to_json} \"per_second\": \7}/p"
+
+ret=0
+for tc in $("${program}" "${@}" -l | sed -n 's/^ident: //p'); do
+    ( cd "${tmpdir}" && "${program}" "${@}" -r "${tmpdir}/result" \
+          "${tc}" >"${tmpdir}/output" 2>&1 )
+    result="$(cat "${tmpdir}/result" 2>/dev/null)"
+    case "${result}" in
+        passed)
+            sed -n -e "${to_json}" "${tmpdir}/output"
+            ;;
+        skipped:*)
+            echo "${Prog_Name}: ${tc}: ${result}" 1>&2
+            ;;
+        *)
+            echo "${Prog_Name}: ${tc}: ${result:-no result}" 1>&2
+            ret=1
+            ;;
+    esac
+    rm -f "${tmpdir}/result"
+done
+exit ${ret}
+
+# vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
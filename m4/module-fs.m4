@@ -62,4 +62,8 @@ AC_DEFUN([ATF_MODULE_FS], [
         AC_DEFINE([HAVE_GETCWD_DYN], [1],
                   [Define to 1 if getcwd(NULL, 0) works])
     fi
+
+    AC_CHECK_FUNCS([copy_file_range])
+    AC_CHECK_HEADERS([sys/sendfile.h])
+    AC_CHECK_MEMBERS([struct dirent.d_type], [], [], [[#include <dirent.h>]])
 ])
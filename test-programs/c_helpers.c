@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <signal.h>
@@ -447,6 +448,120 @@ ATF_TC_BODY(result_newlines_skip, tc)
     atf_tc_skip("First line\nSecond line");
 }
 
+#define THREADS_COUNT 16
+#define THREADS_CHECKS 50
+
+static
+void
+run_threads(void *(*func)(void *))
+{
+    pthread_t threads[THREADS_COUNT];
+    int ids[THREADS_COUNT];
+    int i;
+
+    for (i = 0; i < THREADS_COUNT; i++) {
+        ids[i] = i;
+        ATF_REQUIRE(pthread_create(&threads[i], NULL, func, &ids[i]) == 0);
+    }
+    for (i = 0; i < THREADS_COUNT; i++)
+        ATF_REQUIRE(pthread_join(threads[i], NULL) == 0);
+}
+
+static
+void *
+threads_checks(void *arg)
+{
+    const int id = *(const int *)arg;
+    int i;
+
+    for (i = 0; i < THREADS_CHECKS; i++)
+        ATF_CHECK_MSG(false, "Thread %d check %d", id, i);
+    return NULL;
+}
+
+ATF_TC(result_threads_checks);
+ATF_TC_HEAD(result_threads_checks, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_result test "
+                      "program");
+}
+ATF_TC_BODY(result_threads_checks, tc)
+{
+    run_threads(threads_checks);
+}
+
+static
+void *
+threads_fail(void *arg)
+{
+    atf_tc_fail("Thread %d failed", *(const int *)arg);
+}
+
+ATF_TC(result_nonfatal_messages);
+ATF_TC_HEAD(result_nonfatal_messages, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_result test "
+                      "program");
+}
+ATF_TC_BODY(result_nonfatal_messages, tc)
+{
+    int i;
+
+    for (i = 0; i < 300; i++)
+        atf_tc_fail_nonfatal("Message %d", i);
+}
+
+ATF_TC(result_threads_fail);
+ATF_TC_HEAD(result_threads_fail, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_result test "
+                      "program");
+}
+ATF_TC_BODY(result_threads_fail, tc)
+{
+    run_threads(threads_fail);
+    atf_tc_fail("Should not be reached");
+}
+
+ATF_TC(result_stress);
+ATF_TC_HEAD(result_stress, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_result test "
+                      "program");
+    atf_tc_set_md_var(tc, "X-stress.threads", "2");
+}
+ATF_TC_BODY(result_stress, tc)
+{
+    ATF_CHECK_MSG(false, "Stressed");
+}
+
+ATF_TC(result_timeout);
+ATF_TC_HEAD(result_timeout, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper test case for the t_result test "
+                      "program");
+    atf_tc_set_md_var(tc, "timeout", "0.2");
+}
+ATF_TC_BODY(result_timeout, tc)
+{
+    sleep(5);
+}
+
+ATF_BENCH(bench_sum);
+ATF_BENCH_HEAD(bench_sum, tc)
+{
+    atf_tc_set_md_var(tc, "descr", "Helper benchmark for the t_result test "
+                      "program");
+}
+ATF_BENCH_BODY(bench_sum, tc, iters)
+{
+    volatile size_t sum = 0;
+    size_t i;
+
+    for (i = 0; i < iters; i++)
+        sum += i;
+}
+
 /* ---------------------------------------------------------------------
  * Main.
  * --------------------------------------------------------------------- */
@@ -498,6 +613,12 @@ ATF_TP_ADD_TCS(tp)
     ATF_TP_ADD_TC(tp, result_skip);
     ATF_TP_ADD_TC(tp, result_newlines_fail);
     ATF_TP_ADD_TC(tp, result_newlines_skip);
+    ATF_TP_ADD_TC(tp, result_threads_checks);
+    ATF_TP_ADD_TC(tp, result_nonfatal_messages);
+    ATF_TP_ADD_TC(tp, result_threads_fail);
+    ATF_TP_ADD_TC(tp, result_stress);
+    ATF_TP_ADD_TC(tp, result_timeout);
+    ATF_TP_ADD_BENCH(tp, bench_sum);
 
     return atf_no_error();
 }
@@ -31,6 +31,10 @@ extern "C" {
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <numeric>
+#include <sstream>
+#include <vector>
 
 #include <atf-c++.hpp>
 
@@ -307,6 +311,54 @@ ATF_TEST_CASE_BODY(result_exception)
     throw std::runtime_error("This is unhandled");
 }
 
+ATF_TEST_CASE(result_nonfatal_messages);
+ATF_TEST_CASE_HEAD(result_nonfatal_messages)
+{
+    set_md_var("descr", "Helper test case for the t_result test program");
+}
+ATF_TEST_CASE_BODY(result_nonfatal_messages)
+{
+    for (int i = 0; i < 300; i++) {
+        std::ostringstream message;
+        message << "Message " << i;
+        fail_nonfatal(message.str());
+    }
+}
+
+ATF_TEST_CASE(result_stress);
+ATF_TEST_CASE_HEAD(result_stress)
+{
+    set_md_var("X-stress.threads", "2");
+}
+ATF_TEST_CASE_BODY(result_stress)
+{
+    fail_nonfatal("Stressed");
+}
+
+ATF_TEST_CASE(result_timeout);
+ATF_TEST_CASE_HEAD(result_timeout)
+{
+    set_md_var("timeout", "0.2");
+}
+ATF_TEST_CASE_BODY(result_timeout)
+{
+    ::sleep(5);
+}
+
+ATF_BENCHMARK_TEMPLATE(bench_sum, Container);
+ATF_BENCHMARK_TEMPLATE_HEAD(bench_sum, Container)
+{
+    this->set_md_var("descr", "Helper benchmark for the t_result test "
+                     "program");
+}
+ATF_BENCHMARK_TEMPLATE_BODY(bench_sum, Container, iters)
+{
+    const Container values(100, 1);
+    for (std::size_t i = 0; i < iters; i++)
+        atf::tests::do_not_optimize(
+            std::accumulate(values.begin(), values.end(), 0));
+}
+
 // ------------------------------------------------------------------------
 // Main.
 // ------------------------------------------------------------------------
@@ -352,4 +404,9 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, result_newlines_fail);
     ATF_ADD_TEST_CASE(tcs, result_newlines_skip);
     ATF_ADD_TEST_CASE(tcs, result_exception);
+    ATF_ADD_TEST_CASE(tcs, result_nonfatal_messages);
+    ATF_ADD_TEST_CASE(tcs, result_stress);
+    ATF_ADD_TEST_CASE(tcs, result_timeout);
+    ATF_ADD_BENCHMARK_TEMPLATE(tcs, bench_sum, vector, std::vector< int >);
+    ATF_ADD_BENCHMARK_TEMPLATE(tcs, bench_sum, list, std::list< int >);
 }
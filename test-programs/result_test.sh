@@ -120,7 +120,265 @@ result_exception_body()
     for h in $(get_helpers cpp_helpers); do
         atf_check -s signal -o not-match:'failed: .*This is unhandled' \
             -e ignore "${h}" -s "${srcdir}" result_exception
+        atf_check -s signal -o not-match:'failed: .*This is unhandled' \
+            -e ignore "${h}" -s "${srcdir}" -v stress.threads=2 \
+            result_exception
+    done
+}
+
+atf_test_case result_threads
+result_threads_head()
+{
+    atf_set "descr" "Tests that failures raised from several threads are" \
+                    "all accounted for and reported only once"
+}
+result_threads_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers c_helpers); do
+        atf_check -s eq:1 -e save:stderr "${h}" -s "${srcdir}" \
+            -r resfile -v max_reported_failures=0 result_threads_checks
+        atf_check -o match:"^failed: 800 checks failed; see output" cat resfile
+        atf_check -o inline:"800\n" grep -c "Check failed: .*Thread" stderr
+
+        atf_check -s eq:1 -e ignore "${h}" -s "${srcdir}" \
+            -r resfile result_threads_fail
+        atf_check -o match:"^failed: Thread [0-9]+ failed$" cat resfile
+        atf_check -o inline:"1\n" grep -c . resfile
+    done
+}
+
+atf_test_case result_max_reported
+result_max_reported_head()
+{
+    atf_set "descr" "Tests that repeated check failures are only printed up" \
+                    "to a limit but are still counted"
+}
+result_max_reported_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers c_helpers); do
+        atf_check -s eq:1 -e save:stderr "${h}" -s "${srcdir}" \
+            -r resfile result_threads_checks
+        atf_check -o match:"^failed: 800 checks failed; see output" cat resfile
+        atf_check -o inline:"100\n" grep -c "Check failed: .*Thread" stderr
+        atf_check -o match:"^\*\*\* 700 more check failures at .*:[0-9]+ were" \
+            cat stderr
+
+        atf_check -s eq:1 -e save:stderr "${h}" -s "${srcdir}" \
+            -r resfile -v max_reported_failures=10 result_threads_checks
+        atf_check -o match:"^failed: 800 checks failed; see output" cat resfile
+        atf_check -o inline:"10\n" grep -c "Check failed: .*Thread" stderr
+        atf_check -o match:"^\*\*\* 790 more check failures at .*:[0-9]+ were" \
+            cat stderr
+
+        atf_check -s eq:1 -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v max_reported_failures=-1 result_threads_checks
+        atf_check -o match:"Invalid value '-1' for max_reported_failures" \
+            cat resfile
+    done
+
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:1 -e save:stderr "${h}" -s "${srcdir}" \
+            -r resfile result_nonfatal_messages
+        atf_check -o match:"^failed: 300 checks failed; see output" cat resfile
+        atf_check -o inline:"100\n" grep -c "Check failed: Message" stderr
+        atf_check -o match:"^\*\*\* 200 more check failures without a" \
+            cat stderr
+    done
+}
+
+atf_test_case result_stress
+result_stress_head()
+{
+    atf_set "descr" "Tests that the stress mode runs the body from several" \
+                    "threads and aggregates their failures"
+}
+result_stress_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:1 -e ignore "${h}" -s "${srcdir}" \
+            -r resfile result_stress
+        atf_check -o match:"^failed: 2 checks failed" cat resfile
+
+        atf_check -s eq:1 -e save:stderr "${h}" -s "${srcdir}" \
+            -r resfile -v stress.threads=4 -v stress.iterations=25 \
+            result_stress
+        atf_check -o match:"^failed: 100 checks failed" cat resfile
+        atf_check -o inline:"100\n" grep -c "Check failed: .*Stressed" stderr
+
+        atf_check -s eq:1 -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v stress.threads=0 result_stress
+        atf_check -o match:"Invalid value '0' for stress.threads" cat resfile
+    done
+}
+
+atf_test_case result_bench
+result_bench_head()
+{
+    atf_set "descr" "Tests that benchmarks are listed as such and report" \
+                    "their timings"
+}
+result_bench_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for pair in c_helpers:bench_sum cpp_helpers:bench_sum_vector \
+                cpp_helpers:bench_sum_list; do
+        h="${srcdir}/${pair%%:*}"
+        bm="${pair#*:}"
+
+        atf_check -s eq:0 -o save:list -e ignore "${h}" -s "${srcdir}" -l
+        atf_check -o match:"^X-type: benchmark$" \
+            sed -n "/^ident: ${bm}\$/,/^\$/p" list
+
+        atf_check -s eq:0 -o save:stdout -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v bench.time_ms=1 -v bench.runs=5 "${bm}"
+        atf_check -o inline:"passed\n" cat resfile
+        atf_check -o match:"^bench: ${bm}: [0-9]+ iterations x 5 runs;" \
+            cat stdout
+    done
+
+    atf_check -s eq:0 -o save:list -e ignore "${srcdir}/c_helpers" \
+        -s "${srcdir}" -l
+    atf_check -s eq:1 -o ignore -e ignore sh -c \
+        "sed -n '/^ident: result_pass\$/,/^\$/p' list | grep X-type"
+}
+
+atf_test_case result_counters
+result_counters_head()
+{
+    atf_set "descr" "Tests that test cases print the requested counters" \
+                    "before their result"
+}
+result_counters_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers c_helpers cpp_helpers); do
+        atf_check -s eq:0 -o save:stdout -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v perf.counters=task-clock,page-faults,cycles \
+            result_pass
+        atf_check -o inline:"passed\n" cat resfile
+        atf_check -o match:"^counters: task-clock [0-9]+ ns( \(rusage\))?, " \
+            -o match:"page-faults [0-9]+( \(rusage\))?, " \
+            -o match:"cycles ([0-9]+|unavailable)$" cat stdout
+
+        atf_check -s eq:1 -o save:stdout -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v perf.counters=context-switches result_fail
+        atf_check -o match:"^failed: " cat resfile
+        atf_check -o match:"^counters: context-switches [0-9]+" cat stdout
+
+        atf_check -s eq:1 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -v perf.counters=bogus result_pass
+        atf_check -o match:"Invalid value 'bogus' for perf.counters" \
+            cat resfile
+    done
+}
+
+atf_test_case result_repeat
+result_repeat_head()
+{
+    atf_set "descr" "Tests that -n and -d run a test case repeatedly and" \
+                    "report the distribution of its run times"
+}
+result_repeat_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers); do
+        atf_check -s eq:0 -o save:stdout -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -n 3 result_pass
+        atf_check -o inline:"passed\n" cat resfile
+        atf_check \
+            -o match:"^repeat: result_pass: 3 runs in [0-9.]+ s: 3 passed$" \
+            -o match:"^repeat: result_pass: wall time: min [0-9.]+ ms, " \
+            -o match:"^repeat: result_pass: cpu time: min [0-9.]+ ms, " \
+            cat stdout
+
+        atf_check -s eq:1 -o save:stdout -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -d 0.1 result_fail
+        atf_check -o match:"^failed: " cat resfile
+        atf_check -o match:"runs in [0-9.]+ s: [0-9]+ failed$" cat stdout
+
+        atf_check -s eq:1 -o ignore -e match:"Invalid number of runs" \
+            "${h}" -s "${srcdir}" -n 0 result_pass
+    done
+
+    for h in $(get_helpers c_helpers sh_helpers); do
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -v tmpfile="$(pwd)/tmpfile" -v cleanup=yes -n 2 cleanup_pass
+        test ! -f tmpfile || atf_fail "The cleanup did not run"
+
+        atf_check -s eq:1 -o ignore -e match:"Cannot repeat the cleanup" \
+            "${h}" -s "${srcdir}" -n 2 cleanup_pass:cleanup
+    done
+}
+
+atf_test_case result_watchdog
+result_watchdog_head()
+{
+    atf_set "descr" "Tests that -t enforces the timeout of the test case"
+}
+result_watchdog_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    for h in $(get_helpers); do
+        atf_check -s eq:1 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -t 1 result_timeout
+        atf_check -o match:"^failed: Test case timed out after [0-9.]+ s" \
+            -o match:"its timeout is 0.2 s$" cat resfile
+
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -t 1 expect_timeout_and_hang
+        atf_check -o inline:"expected_timeout: Will overrun\n" cat resfile
+
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -r resfile -t 1 result_pass
+        atf_check -o inline:"passed\n" cat resfile
+
+        atf_check -s eq:1 -o ignore -e match:"Cannot enforce timeouts" \
+            "${h}" -s "${srcdir}" -t 1 -n 2 result_pass
+        atf_check -s eq:1 -o ignore -e match:"Invalid grace period" \
+            "${h}" -s "${srcdir}" -t 0 result_pass
+    done
+
+    for h in $(get_helpers c_helpers sh_helpers); do
+        atf_check -s eq:0 -o ignore -e ignore "${h}" -s "${srcdir}" \
+            -v tmpfile="$(pwd)/tmpfile" -v cleanup=yes -t 1 cleanup_pass
+        test ! -f tmpfile || atf_fail "The cleanup did not run"
+    done
+}
+
+atf_test_case result_trace
+result_trace_head()
+{
+    atf_set "descr" "Tests that ATF_TRACE records the phases of a test" \
+                    "program"
+}
+result_trace_body()
+{
+    srcdir="$(atf_get_srcdir)"
+    h="${srcdir}/c_helpers"
+    trace="$(pwd)/trace.json"
+
+    atf_check -s eq:0 -o ignore -e ignore env ATF_TRACE="${trace}" \
+        "${h}" -s "${srcdir}" -r resfile result_pass
+    atf_check -s eq:0 -o ignore -e ignore env ATF_TRACE="${trace}" \
+        "${h}" -s "${srcdir}" -v cleanup=false cleanup_pass:cleanup
+
+    atf_check -o inline:"[\n" head -n 1 trace.json
+    atf_check -o match:'"ph":"M",.*"args":\{"name":"c_helpers"\}' \
+        cat trace.json
+    for phase in config register head body results cleanup; do
+        for ph in B E; do
+            atf_check -o ignore grep -F \
+                "\"name\":\"${phase}\",\"cat\":\"atf\",\"ph\":\"${ph}\"" \
+                trace.json
+        done
     done
+    atf_check -o ignore grep -F '"args":{"detail":"result_pass"}' trace.json
+    atf_check -o ignore grep -F '"args":{"detail":"passed"}' trace.json
+    atf_check -o inline:"$(grep -c '"ph":"B"' trace.json)\n" \
+        grep -c '"ph":"E"' trace.json
 }
 
 atf_init_test_cases()
@@ -130,6 +388,14 @@ atf_init_test_cases()
     atf_add_test_case result_to_file
     atf_add_test_case result_to_file_fail
     atf_add_test_case result_exception
+    atf_add_test_case result_threads
+    atf_add_test_case result_max_reported
+    atf_add_test_case result_stress
+    atf_add_test_case result_bench
+    atf_add_test_case result_counters
+    atf_add_test_case result_repeat
+    atf_add_test_case result_watchdog
+    atf_add_test_case result_trace
 }
 
 # vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4
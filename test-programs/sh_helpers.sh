@@ -336,6 +336,16 @@ result_skip_body()
     atf_skip "Skipped reason"
 }
 
+atf_test_case result_timeout
+result_timeout_head()
+{
+    atf_set "timeout" "0.2"
+}
+result_timeout_body()
+{
+    sleep 5
+}
+
 # -------------------------------------------------------------------------
 # Main.
 # -------------------------------------------------------------------------
@@ -385,6 +395,7 @@ atf_init_test_cases()
     atf_add_test_case result_pass
     atf_add_test_case result_fail
     atf_add_test_case result_skip
+    atf_add_test_case result_timeout
 }
 
 # vim: syntax=sh:expandtab:shiftwidth=4:softtabstop=4